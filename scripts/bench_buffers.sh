@@ -0,0 +1,77 @@
+#!/bin/bash
+# =============================================================================
+# Buffer count sweep
+# Runs the encoder once per setting of memory.decoder_extra_surfaces,
+# memory.converter_buffers and memory.appsink_buffers (the others at their
+# configured values) and reports estimated memory, fps, transit latency
+# and lost frames. Pick the smallest count per stage that loses nothing.
+#
+#   scripts/bench_buffers.sh [config.yaml] [seconds per run]
+# =============================================================================
+
+set -e
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+
+CONFIG="${1:-${PROJECT_DIR}/config.yaml}"
+DURATION="${2:-30}"
+ENCODER="${PROJECT_DIR}/build/rtsp_encoder"
+
+DECODER_EXTRA="0 1 2 4"
+CONVERTER="2 3 4 6"
+APPSINK="1 2 3 5"
+
+if [ ! -f "$ENCODER" ]; then
+    echo "ERROR: Encoder not found. Build first:"
+    echo "  cd build && cmake .. && make -j\$(nproc)"
+    exit 1
+fi
+if ! grep -q "^memory:" "$CONFIG"; then
+    echo "ERROR: $CONFIG has no memory: section"
+    exit 1
+fi
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+# Config copy with one memory.<key> overridden (budget off so every point runs)
+make_config() {
+    local key=$1 value=$2 out=$3
+    sed -e "/^memory:/,/^[^ #]/{/^  ${key}:/d;/^  budget_mb:/d}" \
+        -e "s/^memory:.*/memory:\n  ${key}: ${value}\n  budget_mb: 0/" \
+        "$CONFIG" > "$out"
+}
+
+# Averages over the run's [STATS] lines, skipping the first (warm-up)
+run_point() {
+    local key=$1 value=$2
+    local cfg="${WORK}/${key}_${value}.yaml" log="${WORK}/${key}_${value}.log"
+    make_config "$key" "$value" "$cfg"
+    timeout -s INT "$DURATION" "$ENCODER" -c "$cfg" > "$log" 2>&1 || true
+
+    local mem fps transit max lost
+    mem=$(grep -o "Buffers: .*(~[0-9]* MB" "$log" | grep -o "~[0-9]*" | tr -d '~' | head -1)
+    fps=$(grep -o "fps=[0-9.]*" "$log" | tail -n +2 | cut -d= -f2 |
+          awk '{s+=$1; n++} END {if (n) printf "%.1f", s/n; else print "-"}')
+    transit=$(grep -o "buffers: transit=[0-9.]*" "$log" | tail -n +2 | cut -d= -f2 |
+              awk '{s+=$1; n++} END {if (n) printf "%.1f", s/n; else print "-"}')
+    max=$(grep -o "transit=[0-9.]*ms (max [0-9.]*" "$log" | tail -n +2 | awk '{print $3}' |
+          sort -g | tail -1)
+    lost=$(grep -o "lost=[0-9]*" "$log" | tail -1 | cut -d= -f2)
+    printf "  %-24s %5s %8s %7s %12s %10s %6s\n" \
+        "$key" "$value" "${mem:--}" "$fps" "$transit" "${max:--}" "${lost:-0}"
+}
+
+echo "=== Buffer sweep (${DURATION}s per point) ==="
+echo "  Config: $CONFIG"
+echo ""
+printf "  %-24s %5s %8s %7s %12s %10s %6s\n" \
+    "setting" "count" "mem_MB" "fps" "transit_ms" "max_ms" "lost"
+
+for v in $DECODER_EXTRA; do run_point decoder_extra_surfaces "$v"; done
+for v in $CONVERTER;     do run_point converter_buffers "$v"; done
+for v in $APPSINK;       do run_point appsink_buffers "$v"; done
+
+echo ""
+echo "=== Done ==="
+echo "  Logs are discarded; rerun a point with the same config to inspect it."
@@ -0,0 +1,118 @@
+#include "admission.hpp"
+#include <algorithm>
+#include <cmath>
+
+/// Bytes over which the base layer's share is measured; both counters are
+/// halved past it, so the share follows scene changes within seconds.
+static constexpr uint64_t kShareWindowBytes = 4u << 20;
+
+/// Below this the share is not trusted and a reduced session reserves in full.
+static constexpr uint64_t kShareMinBytes = 256u << 10;
+
+const char* egress_class_name(EgressClass cls) {
+    switch (cls) {
+    case EgressClass::Priority: return "priority";
+    case EgressClass::Full:     return "full";
+    case EgressClass::Reduced:  return "reduced";
+    }
+    return "?";
+}
+
+AdmissionControl::Decision AdmissionControl::admit(const void* client, const std::string& ip) {
+    const AppConfig& cfg = config_.get();
+    const AdmissionConfig& ac = cfg.admission;
+    int64_t full = ac.reserve_kbps > 0 ? ac.reserve_kbps : (int64_t)cfg.encoder.max_bitrate_kbps;
+    int64_t reduced = (int64_t)std::ceil(full * base_share());
+    bool priority = std::find(ac.priority_clients.begin(), ac.priority_clients.end(), ip) !=
+                    ac.priority_clients.end();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Decision d;
+    auto it = grants_.find(client);
+    if (it != grants_.end()) {
+        d.admitted = true;
+        d.cls = it->second.cls;
+        d.kbps = it->second.kbps;
+        d.reserved = reserved_locked();
+        return d;
+    }
+
+    int64_t used = reserved_locked();
+    bool priority_present = std::any_of(grants_.begin(), grants_.end(),
+        [](const std::pair<const void* const, Grant>& g) { return g.second.cls == EgressClass::Priority; });
+    int64_t held = (!priority_present && !ac.priority_clients.empty()) ? full : 0;
+
+    if (priority) {
+        d = {true, EgressClass::Priority, full, 0};
+    } else if (!ac.enabled || used + held + full <= ac.budget_kbps) {
+        d = {true, EgressClass::Full, full, 0};
+    } else if (ac.over_budget == "downgrade" && used + held + reduced <= ac.budget_kbps) {
+        d = {true, EgressClass::Reduced, reduced, 0};
+    }
+
+    if (d.admitted) {
+        grants_[client] = {d.cls, d.kbps};
+        d.first = true;
+        stats_.on_admitted(d.cls);
+    } else {
+        stats_.on_rejected();
+    }
+    d.reserved = reserved_locked();
+    publish_locked();
+    return d;
+}
+
+bool AdmissionControl::lookup(const void* client, EgressClass& cls) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = grants_.find(client);
+    if (it == grants_.end()) return false;
+    cls = it->second.cls;
+    return true;
+}
+
+bool AdmissionControl::release(const void* client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!grants_.erase(client)) return false;
+    publish_locked();
+    return true;
+}
+
+void AdmissionControl::on_access_unit(int tid, size_t bytes) {
+    uint64_t all = all_bytes_.load(std::memory_order_relaxed) + bytes;
+    uint64_t base = base_bytes_.load(std::memory_order_relaxed) + (tid == 0 ? bytes : 0);
+    if (all > kShareWindowBytes) {
+        all /= 2;
+        base /= 2;
+    }
+    base_bytes_.store(base, std::memory_order_relaxed);
+    all_bytes_.store(all, std::memory_order_relaxed);
+}
+
+void AdmissionControl::reset_layer_share() {
+    base_bytes_.store(0, std::memory_order_relaxed);
+    all_bytes_.store(0, std::memory_order_relaxed);
+}
+
+/// Fraction of the encoded bytes in the base layer; 1 until measured.
+double AdmissionControl::base_share() const {
+    uint64_t all = all_bytes_.load(std::memory_order_relaxed);
+    if (all < kShareMinBytes) return 1.0;
+    return std::min(1.0, (double)base_bytes_.load(std::memory_order_relaxed) / all);
+}
+
+int64_t AdmissionControl::reserved_locked() const {
+    int64_t total = 0;
+    for (const auto& g : grants_) total += g.second.kbps;
+    return total;
+}
+
+void AdmissionControl::publish_locked() const {
+    int sessions[3] = {};
+    int64_t kbps[3] = {};
+    for (const auto& g : grants_) {
+        sessions[(int)g.second.cls]++;
+        kbps[(int)g.second.cls] += g.second.kbps;
+    }
+    const AdmissionConfig& ac = config_->admission;
+    stats_.on_egress_reserved(sessions, kbps, ac.enabled ? ac.budget_kbps : 0);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "config.hpp"
+#include "stats.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+
+/// Egress admission control.
+///
+/// Every RTSP session sends its own copy of the stream up the 5G link, so
+/// the number of sessions is what the uplink budget has to cap. Each
+/// session reserves bandwidth on its first SETUP against
+/// `admission.budget_kbps`: a full-rate session `reserve_kbps`, one cut to
+/// the base temporal layer the base layer's measured share of the encoded
+/// bytes (I/P frames carry most of them). Sessions from
+/// `priority_clients` (go2rtc, which feeds every WebRTC viewer) are always
+/// admitted at full rate, and while none is connected one full reservation
+/// is held back for it, so a burst of direct viewers cannot lock it out.
+/// Past the budget a new session is refused (453 Not Enough Bandwidth) or,
+/// with `over_budget: downgrade`, admitted at the base layer if that fits.
+/// Reservations are released when the client closes.
+
+const char* egress_class_name(EgressClass cls);
+
+class AdmissionControl {
+public:
+    AdmissionControl(const ConfigStore& config, Stats& stats) : config_(config), stats_(stats) {}
+
+    struct Decision {
+        bool admitted = false;
+        EgressClass cls = EgressClass::Full;
+        int64_t kbps = 0;          // reserved for this session
+        int64_t reserved = 0;      // all sessions, after this one
+        bool first = false;        // this call made the grant
+    };
+
+    /// First SETUP of `client` (from `ip`); later calls return the same
+    /// grant. Client threads.
+    Decision admit(const void* client, const std::string& ip);
+
+    /// Class granted to `client`; false if it has none.
+    bool lookup(const void* client, EgressClass& cls) const;
+
+    /// The client closed: give back its reservation. False if it held none.
+    bool release(const void* client);
+
+    /// Encoded access unit of temporal layer `tid`, for the base layer's
+    /// byte share. Appsink streaming thread.
+    void on_access_unit(int tid, size_t bytes);
+
+    /// Layering changed: forget the measured share.
+    void reset_layer_share();
+
+private:
+    struct Grant {
+        EgressClass cls;
+        int64_t kbps;
+    };
+
+    const ConfigStore& config_;
+    Stats& stats_;
+    mutable std::mutex mutex_;
+    std::map<const void*, Grant> grants_;
+    std::atomic<uint64_t> base_bytes_{0};   // written by the appsink thread only
+    std::atomic<uint64_t> all_bytes_{0};
+
+    double base_share() const;
+    int64_t reserved_locked() const;
+    void publish_locked() const;
+};
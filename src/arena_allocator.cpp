@@ -0,0 +1,286 @@
+#include "arena_allocator.hpp"
+#include <gst/gst.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <new>
+
+static constexpr size_t kChunkBytes = 2 * 1024 * 1024;   // one huge page
+static constexpr size_t kMinClassBytes = 128;            // fits a sub-memory header
+static constexpr int kClasses = 15;                      // 128 B .. 2 MB
+static constexpr size_t kBlockAlign = 64;
+
+/// One memory. An owning block starts with this header and the data
+/// follows; a shared (sub-)memory is a header-only block pointing into
+/// its parent's data.
+struct ArenaMemory {
+    GstMemory mem;
+    uint8_t* data;     // start of the maxsize region
+    int cls;           // size class of the block holding this header, -1 = heap
+};
+
+static constexpr size_t kHeaderBytes = (sizeof(ArenaMemory) + kBlockAlign - 1) & ~(kBlockAlign - 1);
+static_assert(sizeof(ArenaMemory) <= kMinClassBytes, "sub-memory header must fit the smallest class");
+
+// ============================================================================
+//  Arena: chunks, size classes, free lists
+// ============================================================================
+
+namespace {
+
+struct FreeList {
+    std::mutex mutex;
+    void* head = nullptr;
+};
+
+class Arena {
+public:
+    void configure(size_t cap_bytes, size_t max_block, bool hugepages, Stats* stats) {
+        cap_ = cap_bytes;
+        hugepages_ = hugepages;
+        stats_ = stats;
+        max_class_ = std::min(class_of(max_block), kClasses - 1);
+    }
+
+    int max_class() const { return max_class_; }
+    Stats* stats() const { return stats_; }
+
+    static size_t class_bytes(int cls) { return kMinClassBytes << cls; }
+
+    static int class_of(size_t bytes) {
+        int cls = 0;
+        while (cls < kClasses - 1 && class_bytes(cls) < bytes) cls++;
+        return class_bytes(cls) >= bytes ? cls : kClasses;
+    }
+
+    /// A block of class `cls`, or nullptr once the cap is reached.
+    void* take(int cls) {
+        FreeList& fl = free_[cls];
+        {
+            std::lock_guard<std::mutex> lock(fl.mutex);
+            if (fl.head) {
+                void* block = fl.head;
+                fl.head = *static_cast<void**>(block);
+                return block;
+            }
+        }
+        return carve(class_bytes(cls));
+    }
+
+    void give(int cls, void* block) {
+        FreeList& fl = free_[cls];
+        std::lock_guard<std::mutex> lock(fl.mutex);
+        *static_cast<void**>(block) = fl.head;
+        fl.head = block;
+    }
+
+private:
+    size_t cap_ = 0;
+    bool hugepages_ = false;
+    Stats* stats_ = nullptr;
+    int max_class_ = 0;
+    FreeList free_[kClasses];
+
+    std::mutex chunk_mutex_;
+    uint8_t* chunk_ = nullptr;
+    size_t chunk_used_ = kChunkBytes;
+    size_t reserved_ = 0;
+    bool hugepage_warned_ = false;
+
+    // First fit into the current chunk; the tail of a chunk too short for
+    // the request is left unused (at most one block per chunk)
+    void* carve(size_t bytes) {
+        std::lock_guard<std::mutex> lock(chunk_mutex_);
+        if (chunk_used_ + bytes > kChunkBytes) {
+            if (reserved_ + kChunkBytes > cap_) return nullptr;
+            uint8_t* chunk = map_chunk();
+            if (!chunk) return nullptr;
+            chunk_ = chunk;
+            chunk_used_ = 0;
+            reserved_ += kChunkBytes;
+            if (stats_) stats_->on_arena_reserved(reserved_, cap_);
+        }
+        void* block = chunk_ + chunk_used_;
+        chunk_used_ += bytes;
+        return block;
+    }
+
+    uint8_t* map_chunk() {
+        void* p = MAP_FAILED;
+        if (hugepages_) {
+            p = mmap(nullptr, kChunkBytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p == MAP_FAILED && !hugepage_warned_) {
+                hugepage_warned_ = true;
+                std::cerr << "[ALLOC] No reserved huge pages (vm.nr_hugepages), using THP" << std::endl;
+            }
+        }
+        if (p == MAP_FAILED) {
+            // 2 MB aligned, so transparent huge pages can back it
+            size_t span = kChunkBytes * 2;
+            void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) return nullptr;
+            uintptr_t base = reinterpret_cast<uintptr_t>(raw);
+            uintptr_t aligned = (base + kChunkBytes - 1) & ~(uintptr_t)(kChunkBytes - 1);
+            if (aligned > base) munmap(raw, aligned - base);
+            uintptr_t end = base + span;
+            if (end > aligned + kChunkBytes) munmap(reinterpret_cast<void*>(aligned + kChunkBytes),
+                                                    end - aligned - kChunkBytes);
+            p = reinterpret_cast<void*>(aligned);
+            if (hugepages_) madvise(p, kChunkBytes, MADV_HUGEPAGE);
+        }
+        return static_cast<uint8_t*>(p);
+    }
+};
+
+Arena g_arena;
+GstAllocator* g_sysmem = nullptr;
+
+int64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+}  // namespace
+
+// ============================================================================
+//  GstAllocator subclass
+// ============================================================================
+
+struct ArenaAllocator {
+    GstAllocator parent;
+};
+
+struct ArenaAllocatorClass {
+    GstAllocatorClass parent_class;
+};
+
+G_DEFINE_TYPE(ArenaAllocator, arena_allocator, GST_TYPE_ALLOCATOR)
+
+/// Header for a memory whose data lives elsewhere (share).
+static ArenaMemory* new_header() {
+    void* block = g_arena.take(0);
+    if (!block) return new ArenaMemory{{}, nullptr, -1};
+    ArenaMemory* am = static_cast<ArenaMemory*>(block);
+    am->cls = 0;
+    return am;
+}
+
+static GstMemory* arena_alloc(GstAllocator* allocator, gsize size, GstAllocationParams* params) {
+    int64_t t0 = mono_ns();
+    gsize maxsize = params->prefix + size + params->padding;
+    int cls = params->align < kBlockAlign ? Arena::class_of(kHeaderBytes + maxsize) : kClasses;
+    void* block = cls <= g_arena.max_class() ? g_arena.take(cls) : nullptr;
+
+    if (!block) {
+        GstMemory* mem = gst_allocator_alloc(g_sysmem, size, params);
+        if (g_arena.stats()) g_arena.stats()->on_alloc(mono_ns() - t0, false);
+        return mem;
+    }
+
+    ArenaMemory* am = static_cast<ArenaMemory*>(block);
+    am->data = static_cast<uint8_t*>(block) + kHeaderBytes;
+    am->cls = cls;
+    gst_memory_init(GST_MEMORY_CAST(am), params->flags, allocator, nullptr,
+                    maxsize, params->align, params->prefix, size);
+    if (params->prefix && (params->flags & GST_MEMORY_FLAG_ZERO_PREFIXED)) {
+        memset(am->data, 0, params->prefix);
+    }
+    if (params->padding && (params->flags & GST_MEMORY_FLAG_ZERO_PADDED)) {
+        memset(am->data + params->prefix + size, 0, params->padding);
+    }
+    if (g_arena.stats()) g_arena.stats()->on_alloc(mono_ns() - t0, true);
+    return GST_MEMORY_CAST(am);
+}
+
+static void arena_free(GstAllocator*, GstMemory* mem) {
+    ArenaMemory* am = reinterpret_cast<ArenaMemory*>(mem);
+    if (am->cls < 0) delete am;
+    else g_arena.give(am->cls, am);
+}
+
+static gpointer arena_mem_map(GstMemory* mem, gsize, GstMapFlags) {
+    return reinterpret_cast<ArenaMemory*>(mem)->data;
+}
+
+static void arena_mem_unmap(GstMemory*) {}
+
+static GstMemory* arena_mem_share(GstMemory* mem, gssize offset, gssize size) {
+    ArenaMemory* am = reinterpret_cast<ArenaMemory*>(mem);
+    GstMemory* parent = mem->parent ? mem->parent : mem;
+    if (size == -1) size = mem->size > (gsize)offset ? mem->size - offset : 0;
+
+    ArenaMemory* sub = new_header();
+    sub->data = am->data;
+    // Shared memory is always read-only
+    gst_memory_init(GST_MEMORY_CAST(sub),
+                    (GstMemoryFlags)(GST_MINI_OBJECT_FLAGS(parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY),
+                    mem->allocator, parent, mem->maxsize, mem->align, mem->offset + offset, size);
+    return GST_MEMORY_CAST(sub);
+}
+
+static GstMemory* arena_mem_copy(GstMemory* mem, gssize offset, gssize size) {
+    ArenaMemory* am = reinterpret_cast<ArenaMemory*>(mem);
+    if (size == -1) size = mem->size > (gsize)offset ? mem->size - offset : 0;
+    GstAllocationParams params;
+    gst_allocation_params_init(&params);
+    params.align = mem->align;
+    GstMemory* copy = gst_allocator_alloc(mem->allocator, size, &params);
+    GstMapInfo map;
+    if (copy && gst_memory_map(copy, &map, GST_MAP_WRITE)) {
+        memcpy(map.data, am->data + mem->offset + offset, size);
+        gst_memory_unmap(copy, &map);
+    }
+    return copy;
+}
+
+static gboolean arena_mem_is_span(GstMemory* mem1, GstMemory* mem2, gsize* offset) {
+    ArenaMemory* a = reinterpret_cast<ArenaMemory*>(mem1);
+    ArenaMemory* b = reinterpret_cast<ArenaMemory*>(mem2);
+    if (offset) *offset = mem1->offset - mem1->parent->offset;
+    return a->data + mem1->offset + mem1->size == b->data + mem2->offset;
+}
+
+static void arena_allocator_class_init(ArenaAllocatorClass* klass) {
+    GstAllocatorClass* ac = GST_ALLOCATOR_CLASS(klass);
+    ac->alloc = arena_alloc;
+    ac->free = arena_free;
+}
+
+static void arena_allocator_init(ArenaAllocator* self) {
+    GstAllocator* alloc = GST_ALLOCATOR_CAST(self);
+    alloc->mem_type = "ArenaMemory";
+    alloc->mem_map = arena_mem_map;
+    alloc->mem_unmap = arena_mem_unmap;
+    alloc->mem_share = arena_mem_share;
+    alloc->mem_copy = arena_mem_copy;
+    alloc->mem_is_span = arena_mem_is_span;
+}
+
+// ============================================================================
+
+void arena_allocator_install(const AppConfig& config, Stats& stats) {
+    if (!config.memory.arena) return;
+
+    // Cap and largest block from the bitrate and GOP length (see estimate_memory)
+    MemoryEstimate m = estimate_memory(config);
+    size_t cap = m.arena;
+    size_t max_block = m.max_au;
+
+    g_arena.configure(cap, kHeaderBytes + max_block, config.memory.hugepages, &stats);
+    g_sysmem = gst_allocator_find(GST_ALLOCATOR_SYSMEM);
+
+    GstAllocator* arena = GST_ALLOCATOR_CAST(g_object_new(arena_allocator_get_type(), nullptr));
+    gst_object_ref_sink(arena);
+    gst_allocator_register("ArenaMemory", GST_ALLOCATOR_CAST(gst_object_ref(arena)));
+    gst_allocator_set_default(arena);   // takes the ref
+
+    std::cout << "[ALLOC] Arena: up to " << cap / (1024 * 1024) << " MB, blocks up to "
+              << Arena::class_bytes(g_arena.max_class()) / 1024 << " KB"
+              << (config.memory.hugepages ? ", huge pages" : "") << std::endl;
+}
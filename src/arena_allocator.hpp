@@ -0,0 +1,22 @@
+#pragma once
+
+#include "config.hpp"
+#include "stats.hpp"
+
+/// Pooled allocator for system-memory GstMemory.
+///
+/// Installed as GStreamer's default allocator, so every plain buffer
+/// allocation in the process comes from it: encoded access units, RTP
+/// packets and their sub-buffers (rtph264pay shares FU-A payload regions),
+/// depayloaded input. Blocks come in power-of-two size classes carved from
+/// 2 MB chunks and go back to a per-class free list when released, never to
+/// malloc, so a long run neither fragments the heap nor calls malloc per
+/// frame once the classes it uses have warmed up. Requests above the
+/// largest class (raw video frames), with stricter alignment, or beyond the
+/// arena cap go to the system allocator and are counted as mallocs.
+///
+/// The largest class and the cap are sized from the bitrate and the longest
+/// GOP the fan-out may hold (`memory.arena_mb` overrides the cap).
+
+/// Before any element allocates (right after gst_init). Process lifetime.
+void arena_allocator_install(const AppConfig& config, Stats& stats);
@@ -0,0 +1,48 @@
+#include "au_meta.hpp"
+#include <new>
+
+GType au_meta_api_get_type() {
+    static const gchar* tags[] = {nullptr};
+    static GType type = gst_meta_api_type_register("AuMetaAPI", tags);
+    return type;
+}
+
+static gboolean au_meta_init(GstMeta* meta, gpointer, GstBuffer*) {
+    new (&reinterpret_cast<AuMeta*>(meta)->info) std::shared_ptr<const AccessUnitInfo>();
+    return TRUE;
+}
+
+static void au_meta_free(GstMeta* meta, GstBuffer*) {
+    using InfoPtr = std::shared_ptr<const AccessUnitInfo>;
+    reinterpret_cast<AuMeta*>(meta)->info.~InfoPtr();
+}
+
+// Whole-buffer copies keep the scan; a region no longer matches the offsets
+static gboolean au_meta_transform(GstBuffer* dest, GstMeta* meta, GstBuffer*, GQuark type, gpointer data) {
+    if (!GST_META_TRANSFORM_IS_COPY(type)) return FALSE;
+    GstMetaTransformCopy* copy = static_cast<GstMetaTransformCopy*>(data);
+    AuMeta* am = reinterpret_cast<AuMeta*>(meta);
+    if (copy->region || !am->info) return TRUE;
+    AuMeta* dm = reinterpret_cast<AuMeta*>(gst_buffer_add_meta(dest, au_meta_get_info(), nullptr));
+    if (dm) dm->info = am->info;
+    return TRUE;
+}
+
+const GstMetaInfo* au_meta_get_info() {
+    static const GstMetaInfo* info = gst_meta_register(
+        au_meta_api_get_type(), "AuMeta", sizeof(AuMeta),
+        au_meta_init, au_meta_free, au_meta_transform);
+    return info;
+}
+
+const AccessUnitInfo* buffer_add_au_info(GstBuffer* buf, AccessUnitInfo&& info) {
+    AuMeta* am = reinterpret_cast<AuMeta*>(gst_buffer_add_meta(buf, au_meta_get_info(), nullptr));
+    if (!am) return nullptr;
+    am->info = std::make_shared<const AccessUnitInfo>(std::move(info));
+    return am->info.get();
+}
+
+const AccessUnitInfo* buffer_get_au_info(GstBuffer* buf) {
+    AuMeta* am = reinterpret_cast<AuMeta*>(gst_buffer_get_meta(buf, au_meta_api_get_type()));
+    return am ? am->info.get() : nullptr;
+}
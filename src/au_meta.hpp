@@ -0,0 +1,29 @@
+#pragma once
+
+#include "h264.hpp"
+#include <gst/gst.h>
+#include <memory>
+
+/// Scan result of an encoded access unit, carried on its buffer.
+///
+/// The encoder output is scanned once (h264_scan_access_unit) at the
+/// appsink; QP readout, temporal-layer tagging and the keyframe flag all
+/// read the meta instead of finding start codes again. It survives
+/// gst_buffer_copy (splicing, the feeders' per-client copy) but not
+/// sub-buffers or the split-mode ring, whose readers fall back to a scan.
+/// Copies share the scan by reference count: a per-client copy costs no
+/// allocation beyond the buffer's own.
+
+struct AuMeta {
+    GstMeta meta;
+    std::shared_ptr<const AccessUnitInfo> info;   // constructed in place by au_meta_init
+};
+
+GType au_meta_api_get_type();
+const GstMetaInfo* au_meta_get_info();
+
+/// Attach `info` to a writable buffer; returns the attached copy.
+const AccessUnitInfo* buffer_add_au_info(GstBuffer* buf, AccessUnitInfo&& info);
+
+/// The scan result carried by `buf`, or nullptr.
+const AccessUnitInfo* buffer_get_au_info(GstBuffer* buf);
@@ -1,9 +1,67 @@
 #include "config.hpp"
+#include "nal_filter.hpp"
+#include "thermal_governor.hpp"
 #include <yaml-cpp/yaml.h>
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <fstream>
 
+static void parse_thread_role(const YAML::Node& n, ThreadRoleConfig& role) {
+    if (!n) return;
+    if (n["cpus"])     role.cpus = n["cpus"].as<std::string>();
+    if (n["policy"])   role.policy = n["policy"].as<std::string>();
+    if (n["priority"]) role.priority = n["priority"].as<int>();
+}
+
+static void parse_queue(const YAML::Node& n, QueueConfig& q) {
+    if (!n) return;
+    if (n["enabled"])     q.enabled = n["enabled"].as<bool>();
+    if (n["max_buffers"]) q.max_buffers = n["max_buffers"].as<int>();
+    if (n["max_time_ms"]) q.max_time_ms = n["max_time_ms"].as<int>();
+    if (n["leaky"])       q.leaky = n["leaky"].as<std::string>();
+}
+
+bool parse_cpu_list(const std::string& spec, std::vector<int>& cpus) {
+    cpus.clear();
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+        std::string item = spec.substr(pos, end - pos);
+        size_t dash = item.find('-');
+        try {
+            size_t used = 0;
+            int first = std::stoi(item, &used);
+            int last = first;
+            if (dash != std::string::npos) {
+                if (used != dash) return false;
+                last = std::stoi(item.substr(dash + 1), &used);
+                if (used != item.size() - dash - 1) return false;
+            } else if (used != item.size()) {
+                return false;
+            }
+            if (first < 0 || last < first || last > 1023) return false;
+            for (int c = first; c <= last; c++) cpus.push_back(c);
+        } catch (const std::exception&) {
+            return false;
+        }
+        pos = end + 1;
+    }
+    return !cpus.empty();
+}
+
+uint32_t OutputConfig::strip_mask() const {
+    uint32_t mask = 0;
+    for (const auto& name : strip_nals) {
+        for (uint8_t t = 0; t < 32; t++) {
+            const char* n = h264_nal_type_name(t);
+            if (n && name == n && (kStrippableNals & nal_bit(t))) mask |= nal_bit(t);
+        }
+    }
+    return mask;
+}
+
 AppConfig load_config(const std::string& path) {
     AppConfig cfg;
 
@@ -48,6 +106,10 @@ AppConfig load_config(const std::string& path) {
             auto n = root["output"];
             if (n["port"]) cfg.output.port = n["port"].as<int>();
             if (n["path"]) cfg.output.path = n["path"].as<std::string>();
+            if (n["workers"]) cfg.output.workers = n["workers"].as<int>();
+            if (n["param_sets"]) cfg.output.param_sets = n["param_sets"].as<std::string>();
+            if (n["strip_nals"]) cfg.output.strip_nals = n["strip_nals"].as<std::vector<std::string>>();
+            if (n["filler_headroom"]) cfg.output.filler_headroom = n["filler_headroom"].as<bool>();
         }
 
         // Stats section
@@ -62,6 +124,145 @@ AppConfig load_config(const std::string& path) {
             auto n = root["resilience"];
             if (n["watchdog_timeout_s"])    cfg.resilience.watchdog_timeout_s = n["watchdog_timeout_s"].as<int>();
             if (n["max_pipeline_restarts"]) cfg.resilience.max_pipeline_restarts = n["max_pipeline_restarts"].as<int>();
+            if (n["stall_gap_multiplier"])  cfg.resilience.stall_gap_multiplier = n["stall_gap_multiplier"].as<double>();
+            if (n["stall_min_ms"])          cfg.resilience.stall_min_ms = n["stall_min_ms"].as<int>();
+            if (n["stall_restart_ms"])      cfg.resilience.stall_restart_ms = n["stall_restart_ms"].as<int>();
+            if (n["degraded_after_ms"])     cfg.resilience.degraded_after_ms = n["degraded_after_ms"].as<int>();
+        }
+
+        // Mosaic section
+        if (root["mosaic"]) {
+            auto n = root["mosaic"];
+            if (n["enabled"])    cfg.mosaic.enabled = n["enabled"].as<bool>();
+            if (n["sources"])    cfg.mosaic.sources = n["sources"].as<std::vector<std::string>>();
+            if (n["columns"])    cfg.mosaic.columns = n["columns"].as<int>();
+            if (n["latency_ms"]) cfg.mosaic.latency_ms = n["latency_ms"].as<int>();
+            if (n["tiles"]) {
+                for (const auto& t : n["tiles"]) {
+                    MosaicTile tile;
+                    if (t["x"])      tile.x = t["x"].as<int>();
+                    if (t["y"])      tile.y = t["y"].as<int>();
+                    if (t["width"])  tile.width = t["width"].as<int>();
+                    if (t["height"]) tile.height = t["height"].as<int>();
+                    cfg.mosaic.tiles.push_back(tile);
+                }
+            }
+        }
+
+        // Denoise section
+        if (root["denoise"]) {
+            auto n = root["denoise"];
+            if (n["enabled"])          cfg.denoise.enabled = n["enabled"].as<bool>();
+            if (n["strength"])         cfg.denoise.strength = n["strength"].as<int>();
+            if (n["motion_threshold"]) cfg.denoise.motion_threshold = n["motion_threshold"].as<int>();
+            if (n["threads"])          cfg.denoise.threads = n["threads"].as<int>();
+            if (n["budget_ms"])        cfg.denoise.budget_ms = n["budget_ms"].as<double>();
+            if (n["ab_interval_s"])    cfg.denoise.ab_interval_s = n["ab_interval_s"].as<int>();
+        }
+
+        // GOP controller section
+        if (root["gop"]) {
+            auto n = root["gop"];
+            if (n["adaptive"])            cfg.gop.adaptive = n["adaptive"].as<bool>();
+            if (n["min_frames"])          cfg.gop.min_frames = n["min_frames"].as<int>();
+            if (n["max_frames"])          cfg.gop.max_frames = n["max_frames"].as<int>();
+            if (n["loss_threshold_pct"])  cfg.gop.loss_threshold_pct = n["loss_threshold_pct"].as<double>();
+            if (n["pli_min_interval_ms"]) cfg.gop.pli_min_interval_ms = n["pli_min_interval_ms"].as<int>();
+        }
+
+        // Loss recovery section
+        if (root["recovery"]) {
+            auto n = root["recovery"];
+            if (n["mode"])                    cfg.recovery.mode = n["mode"].as<std::string>();
+            if (n["refresh_frames"])          cfg.recovery.refresh_frames = n["refresh_frames"].as<int>();
+            if (n["emulate_loss_interval_s"]) cfg.recovery.emulate_loss_interval_s = n["emulate_loss_interval_s"].as<int>();
+        }
+
+        // Temporal layering section
+        if (root["svc"]) {
+            auto n = root["svc"];
+            if (n["temporal_layers"]) cfg.svc.temporal_layers = n["temporal_layers"].as<int>();
+            if (n["backlog_high_ms"]) cfg.svc.backlog_high_ms = n["backlog_high_ms"].as<int>();
+            if (n["loss_high_pct"])   cfg.svc.loss_high_pct = n["loss_high_pct"].as<double>();
+            if (n["raise_after_s"])   cfg.svc.raise_after_s = n["raise_after_s"].as<int>();
+        }
+
+        if (root["isolation"]) {
+            auto n = root["isolation"];
+            if (n["mode"])             cfg.isolation.mode = n["mode"].as<std::string>();
+            if (n["ring_kb"])          cfg.isolation.ring_kb = n["ring_kb"].as<int>();
+            if (n["respawn_delay_ms"]) cfg.isolation.respawn_delay_ms = n["respawn_delay_ms"].as<int>();
+        }
+
+        if (root["upgrade"]) {
+            auto n = root["upgrade"];
+            if (n["socket"])  cfg.upgrade.socket = n["socket"].as<std::string>();
+            if (n["drain_s"]) cfg.upgrade.drain_s = n["drain_s"].as<int>();
+        }
+
+        if (root["admission"]) {
+            auto n = root["admission"];
+            if (n["enabled"])          cfg.admission.enabled = n["enabled"].as<bool>();
+            if (n["budget_kbps"])      cfg.admission.budget_kbps = n["budget_kbps"].as<int>();
+            if (n["reserve_kbps"])     cfg.admission.reserve_kbps = n["reserve_kbps"].as<int>();
+            if (n["over_budget"])      cfg.admission.over_budget = n["over_budget"].as<std::string>();
+            if (n["priority_clients"]) {
+                cfg.admission.priority_clients = n["priority_clients"].as<std::vector<std::string>>();
+            }
+        }
+
+        if (root["idle"]) {
+            auto n = root["idle"];
+            if (n["enabled"])           cfg.idle.enabled = n["enabled"].as<bool>();
+            if (n["pause_s"])           cfg.idle.pause_s = n["pause_s"].as<int>();
+            if (n["teardown_s"])        cfg.idle.teardown_s = n["teardown_s"].as<int>();
+            if (n["source_gop_frames"]) cfg.idle.source_gop_frames = n["source_gop_frames"].as<int>();
+            if (n["power_voltage"])     cfg.idle.power_voltage = n["power_voltage"].as<std::string>();
+            if (n["power_current"])     cfg.idle.power_current = n["power_current"].as<std::string>();
+        }
+
+        if (root["thermal"]) {
+            auto n = root["thermal"];
+            if (n["enabled"])          cfg.thermal.enabled = n["enabled"].as<bool>();
+            if (n["zones"])            cfg.thermal.zones = n["zones"].as<std::vector<std::string>>();
+            if (n["cpu_freq_cap"])     cfg.thermal.cpu_freq_cap = n["cpu_freq_cap"].as<std::string>();
+            if (n["gpu_freq_cap"])     cfg.thermal.gpu_freq_cap = n["gpu_freq_cap"].as<std::string>();
+            if (n["throttle_c"])       cfg.thermal.throttle_c = n["throttle_c"].as<double>();
+            if (n["down_headroom_c"])  cfg.thermal.down_headroom_c = n["down_headroom_c"].as<double>();
+            if (n["up_headroom_c"])    cfg.thermal.up_headroom_c = n["up_headroom_c"].as<double>();
+            if (n["step_down_s"])      cfg.thermal.step_down_s = n["step_down_s"].as<int>();
+            if (n["step_up_s"])        cfg.thermal.step_up_s = n["step_up_s"].as<int>();
+            if (n["steps"])            cfg.thermal.steps = n["steps"].as<std::vector<std::string>>();
+            if (n["resolution_scale"]) cfg.thermal.resolution_scale = n["resolution_scale"].as<double>();
+        }
+
+        if (root["memory"]) {
+            auto n = root["memory"];
+            if (n["arena"])     cfg.memory.arena = n["arena"].as<bool>();
+            if (n["arena_mb"])  cfg.memory.arena_mb = n["arena_mb"].as<int>();
+            if (n["hugepages"]) cfg.memory.hugepages = n["hugepages"].as<bool>();
+            if (n["budget_mb"]) cfg.memory.budget_mb = n["budget_mb"].as<int>();
+            if (n["decoder_extra_surfaces"]) cfg.memory.decoder_extra_surfaces = n["decoder_extra_surfaces"].as<int>();
+            if (n["converter_buffers"])      cfg.memory.converter_buffers = n["converter_buffers"].as<int>();
+            if (n["appsink_buffers"])        cfg.memory.appsink_buffers = n["appsink_buffers"].as<int>();
+        }
+
+        // Stage boundary queues
+        if (root["queues"]) {
+            auto n = root["queues"];
+            parse_queue(n["decode"],  cfg.queues.decode);
+            parse_queue(n["convert"], cfg.queues.convert);
+            parse_queue(n["encode"],  cfg.queues.encode);
+            parse_queue(n["output"],  cfg.queues.output);
+        }
+
+        // Thread placement section
+        if (root["threads"]) {
+            auto n = root["threads"];
+            parse_thread_role(n["source"],    cfg.threads.source);
+            parse_thread_role(n["streaming"], cfg.threads.streaming);
+            parse_thread_role(n["serving"],   cfg.threads.serving);
+            parse_thread_role(n["monitor"],   cfg.threads.monitor);
         }
 
     } catch (const YAML::Exception& e) {
@@ -96,6 +297,226 @@ void validate_config(const AppConfig& cfg) {
     if (cfg.output.port < 1 || cfg.output.port > 65535) {
         throw std::runtime_error("[CONFIG] Output port must be 1-65535");
     }
+    if (cfg.output.workers < 0 || cfg.output.workers > 16) {
+        throw std::runtime_error("[CONFIG] output.workers must be 0-16");
+    }
+    if (cfg.output.param_sets != "on_join" && cfg.output.param_sets != "every_idr") {
+        throw std::runtime_error("[CONFIG] output.param_sets must be on_join or every_idr");
+    }
+    for (const auto& name : cfg.output.strip_nals) {
+        if (name != "aud" && name != "sei" && name != "filler") {
+            throw std::runtime_error("[CONFIG] output.strip_nals: unknown NAL type '" + name +
+                                     "' (aud, sei or filler)");
+        }
+    }
+    if (cfg.output.filler_headroom &&
+        (cfg.encoder.control_rate != "cbr" || !(cfg.output.strip_mask() & nal_bit(NAL_FILLER)))) {
+        throw std::runtime_error("[CONFIG] output.filler_headroom needs encoder.control_rate: cbr "
+                                 "and filler in output.strip_nals");
+    }
+    if (cfg.gop.adaptive) {
+        if (cfg.gop.min_frames < 1 || cfg.gop.max_frames < cfg.gop.min_frames) {
+            throw std::runtime_error("[CONFIG] GOP needs 1 <= min_frames <= max_frames");
+        }
+        if (cfg.gop.loss_threshold_pct < 0.0 || cfg.gop.pli_min_interval_ms < 0) {
+            throw std::runtime_error("[CONFIG] GOP loss threshold / PLI interval cannot be negative");
+        }
+    }
+    if (cfg.recovery.mode != "idr" && cfg.recovery.mode != "intra_refresh" && cfg.recovery.mode != "auto") {
+        throw std::runtime_error("[CONFIG] Recovery mode must be 'idr', 'intra_refresh' or 'auto'");
+    }
+    if (cfg.recovery.refresh_frames < 2) {
+        throw std::runtime_error("[CONFIG] Recovery refresh_frames must be >= 2");
+    }
+    if (cfg.resilience.stall_gap_multiplier < 1.5) {
+        throw std::runtime_error("[CONFIG] stall_gap_multiplier must be >= 1.5");
+    }
+    if (cfg.resilience.stall_min_ms < 10 || cfg.resilience.stall_restart_ms <= cfg.resilience.stall_min_ms) {
+        throw std::runtime_error("[CONFIG] Need 10 <= stall_min_ms < stall_restart_ms");
+    }
+    if (cfg.resilience.degraded_after_ms < cfg.resilience.stall_min_ms ||
+        cfg.resilience.degraded_after_ms >= cfg.resilience.watchdog_timeout_s * 1000) {
+        throw std::runtime_error("[CONFIG] Need stall_min_ms <= degraded_after_ms < watchdog_timeout_s");
+    }
+    if (cfg.svc.temporal_layers < 1 || cfg.svc.temporal_layers > 3) {
+        throw std::runtime_error("[CONFIG] SVC temporal_layers must be 1-3");
+    }
+    if (cfg.svc.temporal_layers > 1 && cfg.encoder.profile == "baseline") {
+        throw std::runtime_error("[CONFIG] SVC temporal layers need B-frames: use profile main or high");
+    }
+    if (cfg.isolation.mode != "single" && cfg.isolation.mode != "split") {
+        throw std::runtime_error("[CONFIG] Isolation mode must be single or split");
+    }
+    if (cfg.isolation.ring_kb < 512) {
+        throw std::runtime_error("[CONFIG] Isolation ring_kb must be >= 512 (several IDRs)");
+    }
+    if (cfg.isolation.respawn_delay_ms < 0) {
+        throw std::runtime_error("[CONFIG] Isolation respawn_delay_ms must be >= 0");
+    }
+    if (cfg.upgrade.socket.size() >= 108) {
+        throw std::runtime_error("[CONFIG] Upgrade socket path must be < 108 characters");
+    }
+    if (cfg.admission.enabled) {
+        if (cfg.admission.budget_kbps < 1 || cfg.admission.reserve_kbps < 0) {
+            throw std::runtime_error("[CONFIG] admission needs budget_kbps >= 1 and reserve_kbps >= 0");
+        }
+        if (cfg.admission.over_budget != "reject" && cfg.admission.over_budget != "downgrade") {
+            throw std::runtime_error("[CONFIG] admission.over_budget must be 'reject' or 'downgrade'");
+        }
+        // A downgraded session gets its own media with the upper layers cut
+        if (cfg.admission.over_budget == "downgrade" && cfg.svc.temporal_layers < 2) {
+            throw std::runtime_error("[CONFIG] admission.over_budget: downgrade needs svc.temporal_layers >= 2");
+        }
+    }
+    if (cfg.idle.enabled) {
+        if (cfg.idle.pause_s < 1 || cfg.idle.teardown_s < 0) {
+            throw std::runtime_error("[CONFIG] idle needs pause_s >= 1 and teardown_s >= 0");
+        }
+        if (cfg.idle.source_gop_frames < 0 || cfg.idle.source_gop_frames > 600) {
+            throw std::runtime_error("[CONFIG] idle.source_gop_frames must be 0 to 600");
+        }
+        // The worker cannot see the clients, and the server has no decoder to pause
+        if (cfg.isolation.mode != "single") {
+            throw std::runtime_error("[CONFIG] idle needs isolation.mode: single");
+        }
+    }
+    if (cfg.idle.power_voltage.empty() != cfg.idle.power_current.empty()) {
+        throw std::runtime_error("[CONFIG] idle.power_voltage and power_current go together");
+    }
+    if (cfg.thermal.enabled) {
+        const ThermalConfig& t = cfg.thermal;
+        if (t.throttle_c < 40.0 || t.throttle_c > 125.0) {
+            throw std::runtime_error("[CONFIG] thermal.throttle_c must be 40 to 125");
+        }
+        // The band between the two is the hysteresis
+        if (t.down_headroom_c < 0.0 || t.up_headroom_c <= t.down_headroom_c) {
+            throw std::runtime_error("[CONFIG] thermal needs 0 <= down_headroom_c < up_headroom_c");
+        }
+        if (t.step_down_s < 1 || t.step_up_s < 1) {
+            throw std::runtime_error("[CONFIG] thermal step_down_s and step_up_s must be >= 1");
+        }
+        if (t.steps.empty() || t.steps.size() > 8) {
+            throw std::runtime_error("[CONFIG] thermal.steps needs 1 to 8 entries");
+        }
+        for (const auto& s : t.steps) {
+            if (s != "resolution" && s != "fps" && s != "preset") {
+                throw std::runtime_error("[CONFIG] thermal.steps: unknown step '" + s +
+                                         "' (resolution, fps, preset)");
+            }
+        }
+        // A preset step with no faster preset left would be a level that changes nothing
+        long preset_steps = std::count(t.steps.begin(), t.steps.end(), std::string("preset"));
+        if (preset_steps > preset_speed_rank(cfg.encoder.preset)) {
+            throw std::runtime_error("[CONFIG] thermal.steps has " + std::to_string(preset_steps) +
+                                     " preset step(s), but encoder.preset " + cfg.encoder.preset + " has " +
+                                     std::to_string(preset_speed_rank(cfg.encoder.preset)) + " faster preset(s)");
+        }
+        if (t.resolution_scale < 0.25 || t.resolution_scale > 0.95) {
+            throw std::runtime_error("[CONFIG] thermal.resolution_scale must be 0.25 to 0.95");
+        }
+    }
+    if (cfg.upgrade.drain_s < 0) {
+        throw std::runtime_error("[CONFIG] Upgrade drain_s must be >= 0");
+    }
+    if (cfg.memory.arena_mb < 0 || cfg.memory.arena_mb > 1024) {
+        throw std::runtime_error("[CONFIG] Memory arena_mb must be 0 (auto) to 1024");
+    }
+    if (cfg.memory.decoder_extra_surfaces < 0 || cfg.memory.decoder_extra_surfaces > 24) {
+        throw std::runtime_error("[CONFIG] Memory decoder_extra_surfaces must be 0-24");
+    }
+    if (cfg.memory.converter_buffers < 2 || cfg.memory.converter_buffers > 16) {
+        throw std::runtime_error("[CONFIG] Memory converter_buffers must be 2-16");
+    }
+    if (cfg.memory.appsink_buffers < 1 || cfg.memory.appsink_buffers > 30) {
+        throw std::runtime_error("[CONFIG] Memory appsink_buffers must be 1-30");
+    }
+    const std::pair<const char*, const QueueConfig*> queues[] = {
+        {"decode", &cfg.queues.decode}, {"convert", &cfg.queues.convert},
+        {"encode", &cfg.queues.encode}, {"output", &cfg.queues.output}};
+    for (const auto& q : queues) {
+        if (q.second->max_buffers < 1 || q.second->max_buffers > 100 || q.second->max_time_ms < 0) {
+            throw std::runtime_error(std::string("[CONFIG] queues.") + q.first + " needs max_buffers 1-100, max_time_ms >= 0");
+        }
+        if (q.second->leaky != "no" && q.second->leaky != "upstream" && q.second->leaky != "downstream") {
+            throw std::runtime_error(std::string("[CONFIG] queues.") + q.first + ".leaky must be 'no', 'upstream' or 'downstream'");
+        }
+    }
+    // Those two hold encoded H.264: a dropped AU breaks every frame that
+    // references it, until the next IDR
+    if (cfg.queues.decode.leaky != "no" || cfg.queues.output.leaky != "no") {
+        throw std::runtime_error("[CONFIG] queues.decode/output hold encoded frames and must not be leaky");
+    }
+    const std::pair<const char*, const ThreadRoleConfig*> roles[] = {
+        {"source", &cfg.threads.source}, {"streaming", &cfg.threads.streaming},
+        {"serving", &cfg.threads.serving}, {"monitor", &cfg.threads.monitor}};
+    for (const auto& r : roles) {
+        const ThreadRoleConfig& rc = *r.second;
+        std::vector<int> cpus;
+        if (!rc.cpus.empty() && !parse_cpu_list(rc.cpus, cpus)) {
+            throw std::runtime_error(std::string("[CONFIG] threads.") + r.first + ".cpus must be a list like '4-7' or '2,3'");
+        }
+        if (rc.policy != "inherit" && rc.policy != "other" && rc.policy != "fifo") {
+            throw std::runtime_error(std::string("[CONFIG] threads.") + r.first + ".policy must be 'inherit', 'other' or 'fifo'");
+        }
+        if (rc.policy == "fifo" && (rc.priority < 1 || rc.priority > 99)) {
+            throw std::runtime_error(std::string("[CONFIG] threads.") + r.first + ".priority must be 1-99 with policy fifo");
+        }
+        if (rc.policy == "other" && (rc.priority < -20 || rc.priority > 19)) {
+            throw std::runtime_error(std::string("[CONFIG] threads.") + r.first + ".priority (nice) must be -20..19 with policy other");
+        }
+    }
+    if (cfg.memory.budget_mb < 0) {
+        throw std::runtime_error("[CONFIG] Memory budget_mb must be >= 0");
+    }
+    if (cfg.memory.budget_mb > 0) {
+        MemoryEstimate m = estimate_memory(cfg);
+        uint64_t mb = 1024 * 1024;
+        if (m.total() > (uint64_t)cfg.memory.budget_mb * mb) {
+            throw std::runtime_error("[CONFIG] Buffers need ~" + std::to_string(m.total() / mb) +
+                " MB (decoder " + std::to_string(m.decoder / mb) + ", converter " + std::to_string(m.converter / mb) +
+                ", encoder " + std::to_string(m.encoder / mb) + ", appsink " + std::to_string(m.appsink / mb) +
+                ", arena " + std::to_string(m.arena / mb) + "), over memory.budget_mb " +
+                std::to_string(cfg.memory.budget_mb));
+        }
+    }
+    if (cfg.denoise.enabled) {
+        if (cfg.denoise.strength < 0 || cfg.denoise.strength > 100) {
+            throw std::runtime_error("[CONFIG] Denoise strength must be 0-100");
+        }
+        if (cfg.denoise.motion_threshold < 1 || cfg.denoise.motion_threshold > 127) {
+            throw std::runtime_error("[CONFIG] Denoise motion threshold must be 1-127");
+        }
+        if (cfg.denoise.threads < 1 || cfg.denoise.threads > 16) {
+            throw std::runtime_error("[CONFIG] Denoise threads must be 1-16");
+        }
+        if (cfg.denoise.budget_ms <= 0.0) {
+            throw std::runtime_error("[CONFIG] Denoise budget must be > 0 ms");
+        }
+        if (cfg.encoder.width == 0 || cfg.encoder.height == 0) {
+            throw std::runtime_error("[CONFIG] Denoise needs an explicit encoder width/height");
+        }
+    }
+    if (cfg.mosaic.enabled) {
+        if (cfg.encoder.width == 0 || cfg.encoder.height == 0) {
+            throw std::runtime_error("[CONFIG] Mosaic needs an explicit encoder width/height");
+        }
+        if (cfg.mosaic.columns < 1) {
+            throw std::runtime_error("[CONFIG] Mosaic columns must be >= 1");
+        }
+        if (cfg.mosaic.latency_ms < 0) {
+            throw std::runtime_error("[CONFIG] Mosaic latency cannot be negative");
+        }
+        size_t inputs = 1 + cfg.mosaic.sources.size();
+        if (!cfg.mosaic.tiles.empty() && cfg.mosaic.tiles.size() != inputs) {
+            throw std::runtime_error("[CONFIG] Mosaic needs one tile per input (rtsp.url + sources)");
+        }
+        for (const auto& t : cfg.mosaic.tiles) {
+            if (t.x < 0 || t.y < 0 || t.width < 1 || t.height < 1 ||
+                t.x + t.width > cfg.encoder.width || t.y + t.height > cfg.encoder.height) {
+                throw std::runtime_error("[CONFIG] Mosaic tile outside the output frame");
+            }
+        }
+    }
 }
 
 void print_config(const AppConfig& cfg) {
@@ -112,10 +533,117 @@ void print_config(const AppConfig& cfg) {
     std::cout << "  Rate Control: " << cfg.encoder.control_rate << std::endl;
     std::cout << "  Preset:       " << cfg.encoder.preset << std::endl;
     std::cout << "  Profile:      " << cfg.encoder.profile << std::endl;
-    std::cout << "  IDR Interval: " << cfg.encoder.idr_interval << " frames" << std::endl;
+    std::cout << "  IDR Interval: " << cfg.encoder.idr_interval << " frames";
+    if (cfg.gop.adaptive) {
+        std::cout << " (adaptive " << cfg.gop.min_frames << "-" << cfg.gop.max_frames << ")";
+    }
+    std::cout << std::endl;
     std::cout << "  RTSP Output:  rtsp://localhost:" << cfg.output.port 
-              << cfg.output.path << std::endl;
-    std::cout << "  Watchdog:     " << cfg.resilience.watchdog_timeout_s << "s" << std::endl;
+              << cfg.output.path << " (" << cfg.output.workers << " client threads)" << std::endl;
+    std::cout << "  Param sets:   " << (cfg.output.param_sets == "on_join"
+                                        ? "SPS/PPS on join and on change" : "SPS/PPS on every IDR")
+              << std::endl;
+    if (!cfg.output.strip_nals.empty()) {
+        std::cout << "  Strip NALs:   ";
+        for (size_t i = 0; i < cfg.output.strip_nals.size(); i++) {
+            std::cout << (i ? ", " : "") << cfg.output.strip_nals[i];
+        }
+        if (cfg.output.filler_headroom) std::cout << " (filler → encoder headroom)";
+        std::cout << std::endl;
+    }
+    std::cout << "  Watchdog:     " << cfg.resilience.watchdog_timeout_s << "s (stall after "
+              << cfg.resilience.stall_gap_multiplier << "x frame gap, restart after "
+              << cfg.resilience.stall_restart_ms << " ms, degraded after "
+              << cfg.resilience.degraded_after_ms << " ms)" << std::endl;
+    std::cout << "  Recovery:     " << cfg.recovery.mode;
+    if (cfg.recovery.mode != "idr") std::cout << " (sweep " << cfg.recovery.refresh_frames << " frames)";
+    std::cout << std::endl;
+    if (cfg.svc.temporal_layers > 1) {
+        std::cout << "  SVC:          " << cfg.svc.temporal_layers << " temporal layers (base "
+                  << cfg.encoder.framerate / (1 << (cfg.svc.temporal_layers - 1)) << " fps)" << std::endl;
+    }
+    if (cfg.isolation.mode == "split") {
+        std::cout << "  Isolation:    encoder in worker process (" << cfg.isolation.ring_kb
+                  << " KB ring)" << std::endl;
+    }
+    if (!cfg.upgrade.socket.empty()) {
+        std::cout << "  Upgrade:      " << cfg.upgrade.socket << " (drain " << cfg.upgrade.drain_s
+                  << " s)" << std::endl;
+    }
+    if (cfg.admission.enabled) {
+        int reserve = cfg.admission.reserve_kbps ? cfg.admission.reserve_kbps : (int)cfg.encoder.max_bitrate_kbps;
+        std::cout << "  Admission:    " << cfg.admission.budget_kbps << " kbps egress, " << reserve
+                  << " kbps per session, then " << cfg.admission.over_budget;
+        if (!cfg.admission.priority_clients.empty()) {
+            std::cout << " (priority:";
+            for (const auto& ip : cfg.admission.priority_clients) std::cout << " " << ip;
+            std::cout << ")";
+        }
+        std::cout << std::endl;
+    }
+    if (cfg.idle.enabled) {
+        std::cout << "  Idle:         pause decode after " << cfg.idle.pause_s << " s without clients";
+        if (cfg.idle.teardown_s > 0) std::cout << ", tear down after " << cfg.idle.teardown_s << " s more";
+        std::cout << " (source GOP cache " << cfg.idle.source_gop_frames << " frames)" << std::endl;
+    }
+    if (cfg.thermal.enabled) {
+        std::cout << "  Thermal:      step down at " << cfg.thermal.throttle_c - cfg.thermal.down_headroom_c
+                  << " C, up below " << cfg.thermal.throttle_c - cfg.thermal.up_headroom_c << " C:";
+        for (const auto& s : cfg.thermal.steps) std::cout << " " << s;
+        std::cout << std::endl;
+    }
+    if (cfg.memory.arena) {
+        std::cout << "  Memory:       arena ";
+        if (cfg.memory.arena_mb > 0) std::cout << cfg.memory.arena_mb << " MB";
+        else std::cout << "auto";
+        if (cfg.memory.hugepages) std::cout << ", huge pages";
+        std::cout << std::endl;
+    }
+    {
+        MemoryEstimate m = estimate_memory(cfg);
+        std::cout << "  Buffers:      decoder +" << cfg.memory.decoder_extra_surfaces
+                  << ", conv " << cfg.memory.converter_buffers
+                  << ", appsink " << cfg.memory.appsink_buffers
+                  << " (~" << m.total() / (1024 * 1024) << " MB";
+        if (cfg.memory.budget_mb > 0) std::cout << " of " << cfg.memory.budget_mb << " MB budget";
+        std::cout << ")" << std::endl;
+    }
+    {
+        const std::pair<const char*, const ThreadRoleConfig*> roles[] = {
+            {"source", &cfg.threads.source}, {"streaming", &cfg.threads.streaming},
+            {"serving", &cfg.threads.serving}, {"monitor", &cfg.threads.monitor}};
+        std::string placed;
+        for (const auto& r : roles) {
+            const ThreadRoleConfig& rc = *r.second;
+            if (rc.cpus.empty() && rc.policy == "inherit") continue;
+            if (!placed.empty()) placed += ", ";
+            placed += r.first;
+            if (!rc.cpus.empty()) placed += " cpus " + rc.cpus;
+            if (rc.policy != "inherit") placed += " " + rc.policy + "/" + std::to_string(rc.priority);
+        }
+        if (!placed.empty()) std::cout << "  Threads:      " << placed << std::endl;
+    }
+    {
+        const std::pair<const char*, const QueueConfig*> queues[] = {
+            {"decode", &cfg.queues.decode}, {"convert", &cfg.queues.convert},
+            {"encode", &cfg.queues.encode}, {"output", &cfg.queues.output}};
+        std::string list;
+        for (const auto& q : queues) {
+            if (!q.second->enabled) continue;
+            if (!list.empty()) list += ", ";
+            list += std::string(q.first) + " " + std::to_string(q.second->max_buffers);
+            if (q.second->leaky != "no") list += " (leaky " + q.second->leaky + ")";
+        }
+        if (!list.empty()) std::cout << "  Queues:       " << list << std::endl;
+    }
+    if (cfg.denoise.enabled) {
+        std::cout << "  Denoise:      strength " << cfg.denoise.strength
+                  << ", budget " << cfg.denoise.budget_ms << " ms" << std::endl;
+    }
+    if (cfg.mosaic.enabled) {
+        std::cout << "  Mosaic:       " << (1 + cfg.mosaic.sources.size()) << " inputs, "
+                  << (cfg.mosaic.tiles.empty() ? "grid" : "custom") << " layout" << std::endl;
+    }
     std::cout << "========================================" << std::endl;
 }
 
@@ -130,3 +658,175 @@ void print_config_stderr(const AppConfig& cfg) {
     std::cerr << "  Preset:     " << cfg.encoder.preset << std::endl;
     std::cerr << "  Profile:    " << cfg.encoder.profile << std::endl;
 }
+
+// ============================================================================
+//  Memory estimate
+// ============================================================================
+
+/// Surfaces the L4T H.264 decoder allocates before num-extra-surfaces
+/// (reference frames + the one being decoded + display), typical streams.
+static constexpr int kDecoderBaseSurfaces = 10;
+/// NVENC bitstream (capture) buffers; the driver's count, not settable.
+static constexpr int kEncoderCaptureBuffers = 6;
+/// Auto arena cap beyond what the GOP itself needs: depayloaded input, RTP
+/// packets in flight, per-client queues.
+static constexpr uint64_t kArenaSlackBytes = 8ull * 1024 * 1024;
+static constexpr uint64_t kArenaChunkBytes = 2ull * 1024 * 1024;
+
+MemoryEstimate estimate_memory(const AppConfig& cfg) {
+    MemoryEstimate m;
+    uint64_t surface = (uint64_t)cfg.encoder.width * cfg.encoder.height * 3 / 2;   // NV12
+    uint64_t cameras = cfg.mosaic.enabled ? 1 + cfg.mosaic.sources.size() : 1;
+
+    // An IDR is typically up to ~8 average frames at the peak rate
+    uint64_t frame_bytes = (uint64_t)cfg.encoder.max_bitrate_kbps * 125 / std::max(1, cfg.encoder.framerate);
+    m.max_au = std::min<uint64_t>(kArenaChunkBytes, std::max<uint64_t>(64 * 1024, frame_bytes * 8));
+
+    m.decoder = cameras * (kDecoderBaseSurfaces + cfg.memory.decoder_extra_surfaces) * surface;
+    m.converter = (uint64_t)cfg.memory.converter_buffers * surface * (cfg.denoise.enabled ? 2 : 1);
+    m.encoder = kEncoderCaptureBuffers * m.max_au;
+    m.appsink = (uint64_t)cfg.memory.appsink_buffers * m.max_au;
+
+    // The fan-out may hold a whole GOP (upgrade hand-off), twice over across a GOP boundary
+    if (cfg.memory.arena) {
+        int gop_frames = cfg.gop.adaptive ? cfg.gop.max_frames : cfg.encoder.idr_interval;
+        m.arena = cfg.memory.arena_mb > 0 ? (uint64_t)cfg.memory.arena_mb * 1024 * 1024
+                                          : frame_bytes * gop_frames * 2 + kArenaSlackBytes;
+        m.arena = (m.arena + kArenaChunkBytes - 1) & ~(kArenaChunkBytes - 1);
+    }
+    return m;
+}
+
+// ============================================================================
+//  Hot reload
+// ============================================================================
+
+/// Retired snapshots outlive any reader by far (readers hold one per callback).
+static constexpr int kSnapshotGraceS = 10;
+
+ConfigChange diff_config(const AppConfig& a, const AppConfig& b, std::string& what) {
+    ConfigChange level = ConfigChange::None;
+    what.clear();
+    auto note = [&](bool changed, const char* field, ConfigChange l) {
+        if (!changed) return;
+        if (!what.empty()) what += ", ";
+        what += field;
+        level = std::max(level, l);
+    };
+    auto tiles_differ = [](const std::vector<MosaicTile>& x, const std::vector<MosaicTile>& y) {
+        if (x.size() != y.size()) return true;
+        for (size_t i = 0; i < x.size(); i++) {
+            if (x[i].x != y[i].x || x[i].y != y[i].y ||
+                x[i].width != y[i].width || x[i].height != y[i].height) return true;
+        }
+        return false;
+    };
+
+    const auto S = ConfigChange::Structural;
+    const auto R = ConfigChange::Renegotiate;
+    const auto L = ConfigChange::Live;
+
+    note(a.rtsp.url != b.rtsp.url, "rtsp.url", S);
+    note(a.rtsp.transport != b.rtsp.transport, "rtsp.transport", S);
+    note(a.rtsp.latency_ms != b.rtsp.latency_ms, "rtsp.latency_ms", S);
+    note(a.rtsp.reconnect_delay_s != b.rtsp.reconnect_delay_s, "rtsp.reconnect_delay_s", L);
+    note(a.output.port != b.output.port, "output.port", S);
+    note(a.output.path != b.output.path, "output.path", S);
+    note(a.output.workers != b.output.workers, "output.workers", L);
+    note(a.output.param_sets != b.output.param_sets, "output.param_sets", L);
+    note(a.output.strip_nals != b.output.strip_nals, "output.strip_nals", L);
+    note(a.output.filler_headroom != b.output.filler_headroom, "output.filler_headroom", L);
+
+    // Mosaic caps carry the canvas size and rate; single-source caps don't
+    ConfigChange geometry = a.mosaic.enabled ? S : R;
+    note(a.encoder.width != b.encoder.width, "encoder.width", geometry);
+    note(a.encoder.height != b.encoder.height, "encoder.height", geometry);
+    // Single source: the camera sets the rate and the encoder caps carry
+    // none, so only a rebuild picks up the new value everywhere
+    note(a.encoder.framerate != b.encoder.framerate, "encoder.framerate", S);
+    note(a.encoder.idr_interval != b.encoder.idr_interval, "encoder.idr_interval", a.gop.adaptive ? L : R);
+    note(a.encoder.target_bitrate_kbps != b.encoder.target_bitrate_kbps, "encoder.target_bitrate_kbps", L);
+    note(a.encoder.max_bitrate_kbps != b.encoder.max_bitrate_kbps, "encoder.max_bitrate_kbps", L);
+    note(a.encoder.preset != b.encoder.preset, "encoder.preset", S);
+    note(a.encoder.profile != b.encoder.profile, "encoder.profile", S);
+    note(a.encoder.control_rate != b.encoder.control_rate, "encoder.control_rate", S);
+
+    note(a.stats.enabled != b.stats.enabled || a.stats.interval_s != b.stats.interval_s, "stats", L);
+    note(a.resilience.watchdog_timeout_s != b.resilience.watchdog_timeout_s ||
+         a.resilience.max_pipeline_restarts != b.resilience.max_pipeline_restarts ||
+         a.resilience.stall_gap_multiplier != b.resilience.stall_gap_multiplier ||
+         a.resilience.stall_min_ms != b.resilience.stall_min_ms ||
+         a.resilience.stall_restart_ms != b.resilience.stall_restart_ms ||
+         a.resilience.degraded_after_ms != b.resilience.degraded_after_ms, "resilience", L);
+
+    note(a.mosaic.enabled != b.mosaic.enabled || a.mosaic.sources != b.mosaic.sources ||
+         a.mosaic.columns != b.mosaic.columns || a.mosaic.latency_ms != b.mosaic.latency_ms ||
+         tiles_differ(a.mosaic.tiles, b.mosaic.tiles), "mosaic", S);
+
+    note(a.denoise.enabled != b.denoise.enabled || a.denoise.threads != b.denoise.threads,
+         "denoise.enabled/threads", S);
+    note(a.denoise.strength != b.denoise.strength ||
+         a.denoise.motion_threshold != b.denoise.motion_threshold ||
+         a.denoise.budget_ms != b.denoise.budget_ms ||
+         a.denoise.ab_interval_s != b.denoise.ab_interval_s, "denoise", L);
+
+    note(a.gop.adaptive != b.gop.adaptive, "gop.adaptive", S);
+    note(a.gop.min_frames != b.gop.min_frames || a.gop.max_frames != b.gop.max_frames ||
+         a.gop.loss_threshold_pct != b.gop.loss_threshold_pct ||
+         a.gop.pli_min_interval_ms != b.gop.pli_min_interval_ms, "gop", L);
+
+    note(a.recovery.mode != b.recovery.mode || a.recovery.refresh_frames != b.recovery.refresh_frames,
+         "recovery.mode/refresh_frames", S);
+    note(a.recovery.emulate_loss_interval_s != b.recovery.emulate_loss_interval_s,
+         "recovery.emulate_loss_interval_s", L);
+
+    note(a.svc.temporal_layers != b.svc.temporal_layers, "svc.temporal_layers", S);
+    note(a.svc.backlog_high_ms != b.svc.backlog_high_ms || a.svc.loss_high_pct != b.svc.loss_high_pct ||
+         a.svc.raise_after_s != b.svc.raise_after_s, "svc", L);
+
+    // The process layout is fixed at startup (see Pipeline::reload)
+    note(a.isolation.mode != b.isolation.mode || a.isolation.ring_kb != b.isolation.ring_kb,
+         "isolation.mode/ring_kb", S);
+    note(a.isolation.respawn_delay_ms != b.isolation.respawn_delay_ms, "isolation.respawn_delay_ms", L);
+    note(a.upgrade.socket != b.upgrade.socket || a.upgrade.drain_s != b.upgrade.drain_s, "upgrade", L);
+    // The allocator is installed once, before any pipeline exists
+    note(a.memory.arena != b.memory.arena || a.memory.arena_mb != b.memory.arena_mb ||
+         a.memory.hugepages != b.memory.hugepages || a.memory.budget_mb != b.memory.budget_mb, "memory", L);
+    note(a.admission.enabled != b.admission.enabled || a.admission.budget_kbps != b.admission.budget_kbps ||
+         a.admission.reserve_kbps != b.admission.reserve_kbps || a.admission.over_budget != b.admission.over_budget ||
+         a.admission.priority_clients != b.admission.priority_clients, "admission", L);
+    note(a.idle.enabled != b.idle.enabled || a.idle.pause_s != b.idle.pause_s ||
+         a.idle.teardown_s != b.idle.teardown_s || a.idle.source_gop_frames != b.idle.source_gop_frames ||
+         a.idle.power_voltage != b.idle.power_voltage || a.idle.power_current != b.idle.power_current, "idle", L);
+    note(!a.thermal.same_as(b.thermal), "thermal", L);
+    note(!a.threads.same_as(b.threads), "threads", L);
+    auto queue_changed = [](const QueueConfig& x, const QueueConfig& y) {
+        return x.enabled != y.enabled || x.max_buffers != y.max_buffers ||
+               x.max_time_ms != y.max_time_ms || x.leaky != y.leaky;
+    };
+    note(queue_changed(a.queues.decode, b.queues.decode) || queue_changed(a.queues.convert, b.queues.convert) ||
+         queue_changed(a.queues.encode, b.queues.encode) || queue_changed(a.queues.output, b.queues.output),
+         "queues", S);
+    note(a.memory.decoder_extra_surfaces != b.memory.decoder_extra_surfaces ||
+         a.memory.converter_buffers != b.memory.converter_buffers ||
+         a.memory.appsink_buffers != b.memory.appsink_buffers, "memory buffer counts", S);
+
+    return level;
+}
+
+ConfigStore::ConfigStore(const AppConfig& initial)
+    : owned_(std::make_unique<const AppConfig>(initial)) {
+    current_.store(owned_.get(), std::memory_order_release);
+}
+
+void ConfigStore::publish(const AppConfig& next) {
+    auto now = Clock::now();
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [now](const Retired& r) {
+        return now - r.since > std::chrono::seconds(kSnapshotGraceS);
+    }), retired_.end());
+
+    auto fresh = std::make_unique<const AppConfig>(next);
+    current_.store(fresh.get(), std::memory_order_release);
+    retired_.push_back({std::move(owned_), now});
+    owned_ = std::move(fresh);
+}
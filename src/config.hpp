@@ -1,6 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <vector>
 #include <cstdint>
 
 /// Configuration structures for the RTSP re-encoder
@@ -28,6 +32,13 @@ struct EncoderConfig {
 struct OutputConfig {
     int port = 8554;
     std::string path = "/stream";
+    int workers = 2;                      // RTSP client threads (0 = all on the server thread)
+    std::string param_sets = "on_join";   // "on_join" (cached, out of band) or "every_idr"
+    std::vector<std::string> strip_nals;  // NAL types dropped on the way out: "aud", "sei", "filler"
+    bool filler_headroom = false;         // give stripped CBR filler back to the encoder as bitrate
+
+    /// strip_nals as a bit per H.264 NAL type (see nal_filter.hpp).
+    uint32_t strip_mask() const;
 };
 
 struct StatsConfig {
@@ -38,6 +49,160 @@ struct StatsConfig {
 struct ResilienceConfig {
     int watchdog_timeout_s = 10;
     int max_pipeline_restarts = 0;  // 0 = unlimited
+    double stall_gap_multiplier = 4.0;  // stall after k × the EWMA inter-frame gap
+    int stall_min_ms = 100;             // floor for that deadline
+    int stall_restart_ms = 1500;        // still stalled this long → restart
+    int degraded_after_ms = 2000;       // no frames this long → Playing reported as Degraded
+};
+
+struct MosaicTile {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+struct MosaicConfig {
+    bool enabled = false;
+    std::vector<std::string> sources;  // extra cameras; rtsp.url is always input 0
+    int columns = 2;                    // grid layout when no explicit tiles
+    int latency_ms = 40;                // max wait for a late input before reusing its last frame
+    std::vector<MosaicTile> tiles;      // explicit layout, one per input (overrides grid)
+};
+
+struct DenoiseConfig {
+    bool enabled = false;
+    int strength = 50;           // 0-100: how much of the previous frame is kept on static pixels
+    int motion_threshold = 12;   // luma/chroma delta treated as motion (filter backs off)
+    int threads = 2;             // CPU worker threads for the kernel
+    double budget_ms = 4.0;      // per-frame cost budget; bypass for 1s after 3 overruns
+    int ab_interval_s = 0;       // >0: alternate on/off every N s to compare QP at equal bitrate
+};
+
+struct GopConfig {
+    bool adaptive = false;           // controller owns IDR timing; encoder.idr_interval is the start value
+    int min_frames = 15;             // floor under loss
+    int max_frames = 300;            // ceiling on a clean link (10 s at 30 fps)
+    double loss_threshold_pct = 1.0; // RTCP fraction lost above this shrinks the GOP
+    int pli_min_interval_ms = 500;   // rate limit for PLI-triggered IDRs
+};
+
+struct RecoveryConfig {
+    std::string mode = "idr";         // idr | intra_refresh | auto (intra_refresh if the encoder has it)
+    int refresh_frames = 30;          // intra-refresh sweep length in frames
+    int emulate_loss_interval_s = 0;  // >0: inject a synthetic loss event every N s and measure recovery
+};
+
+struct SvcConfig {
+    int temporal_layers = 1;        // 1 = off; 2 → base layer at fps/2, 3 → fps/4
+    int backlog_high_ms = 150;      // client send backlog that sheds a layer
+    double loss_high_pct = 3.0;     // client-reported loss that sheds a layer
+    int raise_after_s = 3;          // clean seconds before a layer is added back
+};
+
+struct IsolationConfig {
+    std::string mode = "single";    // single | split (encoder in a supervised worker process)
+    int ring_kb = 4096;             // shared-memory ring between worker and server
+    int respawn_delay_ms = 500;     // worker exit → respawn
+};
+
+struct UpgradeConfig {
+    std::string socket;             // hand-off to a new binary ("" = off)
+    int drain_s = 5;                // after handing over: serve existing clients this long, then close them
+};
+
+/// Egress admission control (see admission.hpp): every session reserves
+/// uplink bandwidth against an aggregate budget.
+struct AdmissionConfig {
+    bool enabled = false;
+    int budget_kbps = 0;              // aggregate egress for all sessions
+    int reserve_kbps = 0;             // per full-rate session; 0 = encoder.max_bitrate_kbps
+    std::string over_budget = "reject";   // reject | downgrade (base temporal layer only)
+    std::vector<std::string> priority_clients = {"127.0.0.1", "::1"};   // go2rtc: always admitted
+};
+
+/// On-demand encoding: with no RTSP clients for `pause_s`, stop decoding
+/// (the camera stays connected); after `teardown_s` more, close it too.
+struct IdleConfig {
+    bool enabled = false;
+    int pause_s = 10;               // no clients this long → decode paused
+    int teardown_s = 0;             // paused this long → encoder pipeline torn down (0 = never)
+    int source_gop_frames = 120;    // camera GOP kept while paused, replayed on resume (0 = wait for its next IDR)
+    std::string power_voltage;      // board input rail, mV (sysfs, glob allowed; "" = no power readout)
+    std::string power_current;      // same rail, mA
+};
+
+/// Thermal governor (see thermal_governor.hpp): sheds encoder load ahead
+/// of SoC throttling. Paths are sysfs files; fixtures can stand in.
+struct ThermalConfig {
+    bool enabled = false;
+    std::vector<std::string> zones = {"/sys/class/thermal/thermal_zone*/temp"};   // m°C, hottest counts (globs allowed)
+    std::string cpu_freq_cap = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq";   // clock allowed now
+    std::string gpu_freq_cap;       // devfreq max_freq ("" = not read)
+    double throttle_c = 95.0;       // where the SoC starts throttling
+    double down_headroom_c = 8.0;   // step down at this headroom or less (or on a capped clock)
+    double up_headroom_c = 15.0;    // step up after step_up_s at this headroom or more
+    int step_down_s = 10;           // at most one step down per interval
+    int step_up_s = 60;
+    std::vector<std::string> steps = {"resolution", "fps"};   // applied in order, cumulatively
+    double resolution_scale = 0.75; // per `resolution` step
+
+    bool same_as(const ThermalConfig& o) const {
+        return enabled == o.enabled && zones == o.zones && cpu_freq_cap == o.cpu_freq_cap &&
+               gpu_freq_cap == o.gpu_freq_cap &&
+               throttle_c == o.throttle_c && down_headroom_c == o.down_headroom_c &&
+               up_headroom_c == o.up_headroom_c && step_down_s == o.step_down_s && step_up_s == o.step_up_s &&
+               steps == o.steps && resolution_scale == o.resolution_scale;
+    }
+};
+
+struct MemoryConfig {
+    bool arena = true;              // pooled allocator for system-memory buffers (encoded AUs, RTP packets)
+    int arena_mb = 0;               // arena cap; 0 = sized from bitrate and GOP length
+    bool hugepages = false;         // back the arena with 2 MB huge pages (THP if none are reserved)
+    int budget_mb = 0;              // cap on the buffer estimate below; 0 = report only
+    int decoder_extra_surfaces = 1; // nvv4l2decoder num-extra-surfaces (beyond the driver's DPB minimum)
+    int converter_buffers = 4;      // nvvidconv output-buffers
+    int appsink_buffers = 3;        // appsink max-buffers (encoded AUs waiting for the fan-out)
+};
+
+/// One optional `queue` between pipeline stages: a thread boundary, so the
+/// stages on either side run concurrently and back-pressure stops there.
+struct QueueConfig {
+    bool enabled = false;
+    int max_buffers = 4;
+    int max_time_ms = 0;              // 0 = bounded by max_buffers only
+    std::string leaky = "no";         // no (block upstream) | upstream (drop new) | downstream (drop old)
+};
+
+struct QueuesConfig {
+    QueueConfig decode;    // h264parse → decoder (per camera)
+    QueueConfig convert;   // decoder / compositor → nvvidconv (holds decoder surfaces)
+    QueueConfig encode;    // nvvidconv → encoder (holds converter buffers)
+    QueueConfig output;    // encoder → appsink (encoded AUs)
+};
+
+/// Placement of one class of threads (see thread_roles.hpp).
+struct ThreadRoleConfig {
+    std::string cpus;                 // affinity, e.g. "4-7" or "2,3"; "" = leave alone
+    std::string policy = "inherit";   // inherit | other | fifo
+    int priority = 0;                 // fifo: 1-99; other: nice -20..19
+
+    bool same_as(const ThreadRoleConfig& o) const {
+        return cpus == o.cpus && policy == o.policy && priority == o.priority;
+    }
+};
+
+struct ThreadsConfig {
+    ThreadRoleConfig source;      // rtspsrc and its jitterbuffer/UDP threads
+    ThreadRoleConfig streaming;   // decode → encode → appsink streaming threads
+    ThreadRoleConfig serving;     // feeder threads, per-client media threads, split-mode ring reader
+    ThreadRoleConfig monitor;     // stats thread
+
+    bool same_as(const ThreadsConfig& o) const {
+        return source.same_as(o.source) && streaming.same_as(o.streaming) &&
+               serving.same_as(o.serving) && monitor.same_as(o.monitor);
+    }
 };
 
 struct AppConfig {
@@ -46,8 +211,39 @@ struct AppConfig {
     OutputConfig output;
     StatsConfig stats;
     ResilienceConfig resilience;
+    MosaicConfig mosaic;
+    DenoiseConfig denoise;
+    GopConfig gop;
+    RecoveryConfig recovery;
+    SvcConfig svc;
+    IsolationConfig isolation;
+    UpgradeConfig upgrade;
+    AdmissionConfig admission;
+    IdleConfig idle;
+    ThermalConfig thermal;
+    MemoryConfig memory;
+    ThreadsConfig threads;
+    QueuesConfig queues;
+};
+
+/// Buffer memory a configuration implies, by stage (bytes). Surfaces are
+/// counted at the encoder resolution; a larger camera stream needs more.
+struct MemoryEstimate {
+    uint64_t decoder = 0;     // NVMM decode surfaces, every camera
+    uint64_t converter = 0;   // nvvidconv output pool (plus the denoise stage's)
+    uint64_t encoder = 0;     // NVENC bitstream buffers (driver-sized, not configurable)
+    uint64_t appsink = 0;
+    uint64_t arena = 0;       // pooled allocator cap (arena_allocator.hpp)
+    uint64_t max_au = 0;      // largest expected access unit (an IDR at the peak rate)
+
+    uint64_t total() const { return decoder + converter + encoder + appsink + arena; }
 };
 
+MemoryEstimate estimate_memory(const AppConfig& cfg);
+
+/// CPU numbers in a list like "0,2,4-7"; false if malformed.
+bool parse_cpu_list(const std::string& spec, std::vector<int>& cpus);
+
 /// Load configuration from YAML file.
 /// Falls back to defaults for any missing fields.
 AppConfig load_config(const std::string& path);
@@ -60,3 +256,46 @@ void print_config(const AppConfig& cfg);
 
 /// Print configuration to stderr (for exec mode where stdout = video data).
 void print_config_stderr(const AppConfig& cfg);
+
+/// How much of the running pipeline a config change disturbs.
+enum class ConfigChange {
+    None,
+    Live,         // read through the snapshot / runtime properties
+    Renegotiate,  // in-place caps or encoder property change
+    Structural,   // pipeline swap (spliced under connected clients)
+};
+
+/// Classify `next` against `running`; `what` lists the changed fields.
+ConfigChange diff_config(const AppConfig& running, const AppConfig& next, std::string& what);
+
+/// RCU-style holder of the running configuration.
+///
+/// Readers on any thread dereference the current immutable snapshot with a
+/// single acquire load — no locks. The writer (main loop only) publishes a
+/// whole new snapshot; retired ones are freed only after a grace period,
+/// so readers must not keep a reference across a blocking wait.
+class ConfigStore {
+public:
+    explicit ConfigStore(const AppConfig& initial);
+
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+    const AppConfig* operator->() const { return current_.load(std::memory_order_acquire); }
+    const AppConfig& get() const { return *current_.load(std::memory_order_acquire); }
+
+    /// Main loop only.
+    void publish(const AppConfig& next);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Retired {
+        std::unique_ptr<const AppConfig> config;
+        Clock::time_point since;
+    };
+
+    std::atomic<const AppConfig*> current_;
+    std::unique_ptr<const AppConfig> owned_;
+    std::vector<Retired> retired_;
+};
@@ -0,0 +1,237 @@
+#include "connect_bench.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr int kTimeoutS = 10;
+
+namespace {
+
+enum Phase { kConnect, kOptions, kDescribe, kSetup, kPlay, kFirstRtp, kPhases };
+const char* kPhaseNames[kPhases] = {"connect", "OPTIONS", "DESCRIBE", "SETUP", "PLAY", "first RTP"};
+
+struct Result {
+    double ms[kPhases] = {};   // since the start of the TCP connect
+    bool ok = false;
+    std::string error;
+};
+
+struct Response {
+    int status = 0;
+    std::string headers;
+    std::string body;
+};
+
+/// Value of header `name` (case-insensitive), or "".
+std::string header(const std::string& headers, const std::string& name) {
+    std::string lower = headers;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    std::string key = "\r\n" + name + ":";
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    size_t at = lower.find(key);
+    if (at == std::string::npos) return "";
+    size_t start = headers.find_first_not_of(' ', at + key.size());
+    size_t end = headers.find("\r\n", start);
+    return headers.substr(start, end - start);
+}
+
+class Connection {
+public:
+    ~Connection() { if (fd_ >= 0) close(fd_); }
+
+    bool open(int port) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0) return false;
+        timeval tv{kTimeoutS, 0};
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+
+    bool request(const std::string& method, const std::string& url, const std::string& extra, Response& r) {
+        std::string req = method + " " + url + " RTSP/1.0\r\nCSeq: " + std::to_string(++cseq_) +
+                          "\r\nUser-Agent: rtsp_encoder-bench\r\n" + extra + "\r\n";
+        if (send(fd_, req.data(), req.size(), MSG_NOSIGNAL) != (ssize_t)req.size()) return false;
+        return read_response(r);
+    }
+
+    /// First interleaved ($) frame after PLAY.
+    bool wait_rtp() {
+        for (;;) {
+            if (!buf_.empty() && buf_[0] == '$') return true;
+            if (!buf_.empty()) {
+                // A stray response (e.g. keep-alive): skip it
+                Response r;
+                if (!read_response(r)) return false;
+                continue;
+            }
+            if (!fill()) return false;
+        }
+    }
+
+private:
+    int fd_ = -1;
+    int cseq_ = 0;
+    std::string buf_;
+
+    bool fill() {
+        char tmp[4096];
+        ssize_t n = recv(fd_, tmp, sizeof(tmp), 0);
+        if (n <= 0) return false;
+        buf_.append(tmp, n);
+        return true;
+    }
+
+    bool read_response(Response& r) {
+        size_t end;
+        while ((end = buf_.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) return false;
+        }
+        r.headers = buf_.substr(0, end + 2);
+        buf_.erase(0, end + 4);
+        if (sscanf(r.headers.c_str(), "RTSP/1.0 %d", &r.status) != 1) return false;
+        std::string length = header(r.headers, "Content-Length");
+        size_t body = length.empty() ? 0 : std::stoul(length);
+        while (buf_.size() < body) {
+            if (!fill()) return false;
+        }
+        r.body = buf_.substr(0, body);
+        buf_.erase(0, body);
+        return true;
+    }
+};
+
+/// Control URL of the first media in the SDP, resolved against `base`.
+std::string control_url(const std::string& sdp, const std::string& base) {
+    size_t media = sdp.find("m=video");
+    size_t at = sdp.find("a=control:", media == std::string::npos ? 0 : media);
+    if (at == std::string::npos) return base;
+    size_t start = at + 10;
+    std::string control = sdp.substr(start, sdp.find_first_of("\r\n", start) - start);
+    if (control.rfind("rtsp://", 0) == 0) return control;
+    if (control == "*") return base;
+    return base + (base.back() == '/' ? "" : "/") + control;
+}
+
+Result run_client(int port, const std::string& url) {
+    using Clock = std::chrono::steady_clock;
+    Result res;
+    auto t0 = Clock::now();
+    auto mark = [&](Phase p) {
+        res.ms[p] = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    };
+    auto fail = [&](const std::string& what) { res.error = what; return res; };
+
+    Connection c;
+    if (!c.open(port)) return fail("connect: " + std::string(strerror(errno)));
+    mark(kConnect);
+
+    Response r;
+    if (!c.request("OPTIONS", url, "", r) || r.status != 200) return fail("OPTIONS");
+    mark(kOptions);
+    if (!c.request("DESCRIBE", url, "Accept: application/sdp\r\n", r) || r.status != 200) return fail("DESCRIBE");
+    mark(kDescribe);
+    std::string base = header(r.headers, "Content-Base");
+    std::string track = control_url(r.body, base.empty() ? url : base);
+    if (!c.request("SETUP", track, "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n", r) || r.status != 200) {
+        return fail("SETUP");
+    }
+    mark(kSetup);
+    std::string session = header(r.headers, "Session");
+    session = session.substr(0, session.find(';'));
+    if (!c.request("PLAY", url, "Session: " + session + "\r\nRange: npt=0.000-\r\n", r) || r.status != 200) {
+        return fail("PLAY");
+    }
+    mark(kPlay);
+    if (!c.wait_rtp()) return fail("no RTP");
+    mark(kFirstRtp);
+    res.ok = true;
+    return res;
+}
+
+/// `n` clients released at once.
+std::vector<Result> run_round(int port, const std::string& url, int n) {
+    std::vector<Result> results(n);
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool go = false;
+    for (int i = 0; i < n; i++) {
+        threads.emplace_back([&, i]() {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return go; });
+            }
+            results[i] = run_client(port, url);
+        });
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        go = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads) t.join();
+    return results;
+}
+
+void report(const char* label, const std::vector<Result>& results) {
+    int failed = 0;
+    for (const Result& r : results) {
+        if (!r.ok) {
+            failed++;
+            std::cerr << "[BENCH]   client failed at " << r.error << std::endl;
+        }
+    }
+    std::cout << "[BENCH] " << label << " (" << results.size() - failed << "/" << results.size() << " ok)" << std::endl;
+    for (int p = kOptions; p < kPhases; p++) {
+        std::vector<double> ms;
+        for (const Result& r : results) if (r.ok) ms.push_back(r.ms[p]);
+        if (ms.empty()) continue;
+        std::sort(ms.begin(), ms.end());
+        auto pct = [&](double q) { return ms[std::min(ms.size() - 1, (size_t)(q * ms.size()))]; };
+        std::cout << "[BENCH]   " << std::left << std::setw(10) << kPhaseNames[p] << std::right
+                  << std::fixed << std::setprecision(1)
+                  << " p50=" << std::setw(7) << pct(0.50) << "ms"
+                  << " p95=" << std::setw(7) << pct(0.95) << "ms"
+                  << " max=" << std::setw(7) << ms.back() << "ms" << std::endl;
+    }
+}
+
+}  // namespace
+
+int run_connect_bench(const AppConfig& config, int clients) {
+    int port = config.output.port;
+    std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + config.output.path;
+    std::cout << "[BENCH] " << url << ", server with " << config.output.workers
+              << " client thread(s) per config" << std::endl;
+
+    std::vector<Result> single = run_round(port, url, 1);
+    if (!single[0].ok) {
+        std::cerr << "[BENCH] Cannot play " << url << " (" << single[0].error << "); is it running?" << std::endl;
+        return 1;
+    }
+    report("1 client", single);
+    std::vector<Result> burst = run_round(port, url, clients);
+    std::string label = std::to_string(clients) + " concurrent clients";
+    report(label.c_str(), burst);
+    return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "config.hpp"
+
+/// `--bench-connect N`: RTSP connect latency of the running instance
+/// (localhost, `output.port`/`path` of the config), one client alone and
+/// then N clients connecting at the same moment.
+///
+/// Each client does what go2rtc does: OPTIONS, DESCRIBE, SETUP (TCP
+/// interleaved) and PLAY, then waits for its first RTP packet. Per phase
+/// the report gives p50 / p95 / max from the TCP connect, so a burst that
+/// queues behind a single server thread shows up as a wide spread. Compare
+/// runs with different `output.workers` (reload with SIGHUP in between).
+int run_connect_bench(const AppConfig& config, int clients);
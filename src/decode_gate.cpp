@@ -0,0 +1,70 @@
+#include "decode_gate.hpp"
+
+DecodeGate::~DecodeGate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clear_locked();
+}
+
+void DecodeGate::attach(GstPad* pad, const std::shared_ptr<DecodeGate>& gate) {
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, DecodeGate::on_buffer,
+        new std::shared_ptr<DecodeGate>(gate),
+        [](gpointer p) { delete static_cast<std::shared_ptr<DecodeGate>*>(p); });
+}
+
+void DecodeGate::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clear_locked();
+    dropped_.store(0);
+    mode_.store(Mode::Drop);
+}
+
+void DecodeGate::open() {
+    Mode expected = Mode::Drop;
+    mode_.compare_exchange_strong(expected, Mode::Resume);
+}
+
+void DecodeGate::clear_locked() {
+    for (GstBuffer* b : gop_) gst_buffer_unref(b);
+    gop_.clear();
+}
+
+// Streaming thread (parser src pad)
+GstPadProbeReturn DecodeGate::on_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer data) {
+    DecodeGate* self = static_cast<std::shared_ptr<DecodeGate>*>(data)->get();
+    Mode mode = self->mode_.load();
+    if (mode == Mode::Pass) return GST_PAD_PROBE_OK;
+
+    GstBuffer* buf = GST_PAD_PROBE_INFO_BUFFER(info);
+    bool keyframe = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    std::unique_lock<std::mutex> lock(self->mutex_);
+
+    if (mode == Mode::Drop) {
+        if (keyframe) self->clear_locked();
+        if (!self->gop_.empty() || keyframe) {
+            // A GOP longer than the cache is no use: wait for the next IDR
+            if (self->gop_.size() < self->max_frames_) self->gop_.push_back(gst_buffer_ref(buf));
+            else self->clear_locked();
+        }
+        self->dropped_.fetch_add(1, std::memory_order_relaxed);
+        return GST_PAD_PROBE_DROP;
+    }
+
+    // Resume: an IDR needs nothing before it; a delta frame needs the cache
+    if (keyframe) self->clear_locked();
+    else if (self->gop_.empty()) return GST_PAD_PROBE_DROP;
+    std::vector<GstBuffer*> gop;
+    gop.swap(self->gop_);
+    self->mode_.store(Mode::Pass);
+    lock.unlock();
+
+    // Pushed from here on the same thread, ahead of `buf`; the probe passes them
+    self->replayed_.store(gop.size());
+    bool flowing = true;
+    for (GstBuffer* b : gop) {
+        if (!flowing) { gst_buffer_unref(b); continue; }
+        b = gst_buffer_make_writable(b);
+        GST_BUFFER_FLAG_SET(b, GST_BUFFER_FLAG_DECODE_ONLY);
+        flowing = gst_pad_push(pad, b) == GST_FLOW_OK;
+    }
+    return GST_PAD_PROBE_OK;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// Pauses decoding of one source chain without disconnecting the camera.
+///
+/// Sits on the input parser's src pad (h264parse → decoder). Closed, it
+/// drops every access unit before it reaches the decoder, so the decoder,
+/// converter and NVENC get no work, but keeps the camera's current GOP (from
+/// its last IDR, at most `max_frames`). Opened, the next access unit first
+/// pushes the cached GOP flagged DECODE_ONLY: the decoder rebuilds its
+/// reference state from it without output, and the first frame it shows is
+/// the current one instead of the camera's next IDR, up to a camera GOP
+/// later. With nothing cached (or `max_frames` 0) it waits for that IDR.
+
+class DecodeGate {
+public:
+    explicit DecodeGate(size_t max_frames) : max_frames_(max_frames) {}
+    ~DecodeGate();
+
+    DecodeGate(const DecodeGate&) = delete;
+    DecodeGate& operator=(const DecodeGate&) = delete;
+
+    /// Install on `pad`; the probe holds a reference to the gate.
+    static void attach(GstPad* pad, const std::shared_ptr<DecodeGate>& gate);
+
+    /// Any thread.
+    void close();
+    void open();
+    bool is_open() const { return mode_.load() == Mode::Pass; }
+
+    /// Access units dropped while closed, and replayed on the last open.
+    uint64_t dropped() const { return dropped_.load(); }
+    size_t replayed() const { return replayed_.load(); }
+
+private:
+    enum class Mode { Pass, Drop, Resume };
+
+    const size_t max_frames_;
+    std::atomic<Mode> mode_{Mode::Pass};
+    std::mutex mutex_;
+    std::vector<GstBuffer*> gop_;   // guarded by mutex_; first one is an IDR
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<size_t> replayed_{0};
+
+    void clear_locked();
+    static GstPadProbeReturn on_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+};
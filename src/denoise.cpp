@@ -0,0 +1,192 @@
+#include "denoise.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// 8 × int16 lanes: one NEON q-register / one SSE2 xmm register
+typedef int16_t v8s16 __attribute__((vector_size(16)));
+typedef uint8_t v8u8 __attribute__((vector_size(8)));
+typedef int32_t v8s32 __attribute__((vector_size(32)));
+
+/// Rows per thread-pool work item — big enough to amortise dispatch.
+static constexpr int kBandRows = 32;
+
+Denoiser::Denoiser(const ConfigStore& config, Stats& stats)
+    : config_(config), stats_(stats), pool_(config->denoise.threads) {
+    gst_video_info_init(&info_);
+}
+
+void Denoiser::attach(GstPad* pad) {
+    have_info_ = false;
+    have_prev_ = false;
+    frames_ = 0;
+    consecutive_overruns_ = 0;
+    bypass_frames_ = 0;
+    gst_pad_add_probe(pad,
+        (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+        on_probe, this, NULL);
+    std::cout << "[DENOISE] Enabled: strength " << config_->denoise.strength
+              << ", motion threshold " << config_->denoise.motion_threshold
+              << ", " << pool_.size() << " threads, budget "
+              << config_->denoise.budget_ms << " ms/frame" << std::endl;
+}
+
+GstPadProbeReturn Denoiser::on_probe(GstPad*, GstPadProbeInfo* info, gpointer data) {
+    Denoiser* self = static_cast<Denoiser*>(data);
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent* ev = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(ev) == GST_EVENT_CAPS) {
+            GstCaps* caps = nullptr;
+            gst_event_parse_caps(ev, &caps);
+            self->have_info_ = caps && gst_video_info_from_caps(&self->info_, caps);
+            self->have_prev_ = false;
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer* buf = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    GST_PAD_PROBE_INFO_DATA(info) = buf;
+    self->process(buf);
+    return GST_PAD_PROBE_OK;
+}
+
+void Denoiser::process(GstBuffer* buf) {
+    const DenoiseConfig& dc = config_->denoise;
+    frames_++;
+
+    // A/B mode: alternate filtered/unfiltered phases so the encoder's QP can be
+    // compared at the same bitrate on the same scene
+    bool want = true;
+    if (dc.ab_interval_s > 0) {
+        uint64_t phase_frames = (uint64_t)dc.ab_interval_s * config_->encoder.framerate;
+        want = ((frames_ / phase_frames) % 2) == 0;
+    }
+    if (bypass_frames_ > 0) {
+        bypass_frames_--;
+        want = false;
+    }
+    if (!want || !have_info_) {
+        if (active_.exchange(false)) have_prev_ = false;
+        return;
+    }
+    active_.store(true);
+
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &info_, buf, GST_MAP_READWRITE)) return;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    int w = GST_VIDEO_FRAME_WIDTH(&frame);
+    int h = GST_VIDEO_FRAME_HEIGHT(&frame);
+    uint8_t* y  = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0));
+    uint8_t* uv = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 1));
+    int y_stride  = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
+    int uv_stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 1);
+    size_t y_size = (size_t)w * h;
+    int uv_rows = (h + 1) / 2;
+
+    if (!have_prev_ || prev_.size() != y_size + (size_t)w * uv_rows) {
+        // Seed the recursion with this frame; nothing to filter yet
+        prev_.resize(y_size + (size_t)w * uv_rows);
+        for (int r = 0; r < h; r++)       memcpy(&prev_[(size_t)r * w], y + (size_t)r * y_stride, w);
+        for (int r = 0; r < uv_rows; r++) memcpy(&prev_[y_size + (size_t)r * w], uv + (size_t)r * uv_stride, w);
+        have_prev_ = true;
+        gst_video_frame_unmap(&frame);
+        return;
+    }
+
+    // Luma bands then chroma bands, all in one parallel_for
+    int y_bands = (h + kBandRows - 1) / kBandRows;
+    int uv_bands = (uv_rows + kBandRows - 1) / kBandRows;
+    std::vector<uint64_t> sse(y_bands + uv_bands, 0);
+    pool_.parallel_for(y_bands + uv_bands, [&](int band) {
+        if (band < y_bands) {
+            int r0 = band * kBandRows;
+            sse[band] = filter_rows(y, y_stride, prev_.data(), w, r0, std::min(h, r0 + kBandRows));
+        } else {
+            int r0 = (band - y_bands) * kBandRows;
+            filter_rows(uv, uv_stride, prev_.data() + y_size, w, r0, std::min(uv_rows, r0 + kBandRows));
+        }
+    });
+    gst_video_frame_unmap(&frame);
+
+    auto cost_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t y_sse = 0;
+    for (int i = 0; i < y_bands; i++) y_sse += sse[i];
+    double mse = static_cast<double>(y_sse) / y_size;
+    double delta_psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+
+    bool over = cost_us > static_cast<int64_t>(dc.budget_ms * 1000.0);
+    stats_.on_denoise_frame(cost_us, over, delta_psnr);
+
+    consecutive_overruns_ = over ? consecutive_overruns_ + 1 : 0;
+    if (consecutive_overruns_ >= 3) {
+        std::cerr << "[DENOISE] Over budget (" << cost_us / 1000.0 << " ms > "
+                  << dc.budget_ms << " ms), bypassing for 1s" << std::endl;
+        bypass_frames_ = config_->encoder.framerate;
+        consecutive_overruns_ = 0;
+    }
+}
+
+uint64_t Denoiser::filter_rows(uint8_t* plane, int stride, uint8_t* prev, int width,
+                               int row0, int row1) const {
+    const DenoiseConfig& dc = config_->denoise;
+    // Weights in 1/128 units: k_lo for static pixels, k_mid near the motion
+    // threshold, 128 (take the current pixel) above twice the threshold
+    const int16_t k_lo  = static_cast<int16_t>(128 - dc.strength * 112 / 100);
+    const int16_t k_mid = static_cast<int16_t>((k_lo + 128) / 2);
+    const int16_t thr   = static_cast<int16_t>(dc.motion_threshold);
+    const int16_t thr2  = static_cast<int16_t>(dc.motion_threshold * 2);
+
+    const v8s16 vk_lo  = {k_lo, k_lo, k_lo, k_lo, k_lo, k_lo, k_lo, k_lo};
+    const v8s16 vk_mid = {k_mid, k_mid, k_mid, k_mid, k_mid, k_mid, k_mid, k_mid};
+    const v8s16 vk_one = {128, 128, 128, 128, 128, 128, 128, 128};
+    const v8s16 vthr   = {thr, thr, thr, thr, thr, thr, thr, thr};
+    const v8s16 vthr2  = {thr2, thr2, thr2, thr2, thr2, thr2, thr2, thr2};
+    const v8s16 vround = {64, 64, 64, 64, 64, 64, 64, 64};
+
+    uint64_t sse = 0;
+    for (int r = row0; r < row1; r++) {
+        uint8_t* cur = plane + (size_t)r * stride;
+        uint8_t* prv = prev + (size_t)r * width;
+        v8s32 acc = {0, 0, 0, 0, 0, 0, 0, 0};
+        int x = 0;
+
+        for (; x + 8 <= width; x += 8) {
+            v8u8 c8, p8;
+            memcpy(&c8, cur + x, 8);
+            memcpy(&p8, prv + x, 8);
+            v8s16 c = __builtin_convertvector(c8, v8s16);
+            v8s16 p = __builtin_convertvector(p8, v8s16);
+
+            v8s16 d  = c - p;
+            v8s16 ad = d < 0 ? -d : d;
+            v8s16 k  = ad < vthr ? vk_lo : (ad < vthr2 ? vk_mid : vk_one);
+            v8s16 o  = p + ((d * k + vround) >> 7);   // |d·k| ≤ 255·128 fits int16
+
+            v8s16 e = o - c;
+            v8s32 e32 = __builtin_convertvector(e, v8s32);
+            acc += e32 * e32;
+
+            v8u8 o8 = __builtin_convertvector(o, v8u8);
+            memcpy(cur + x, &o8, 8);
+            memcpy(prv + x, &o8, 8);
+        }
+        for (int i = 0; i < 8; i++) sse += static_cast<uint64_t>(acc[i]);
+
+        for (; x < width; x++) {
+            int c = cur[x], p = prv[x];
+            int d = c - p;
+            int ad = d < 0 ? -d : d;
+            int k = ad < thr ? k_lo : (ad < thr2 ? k_mid : 128);
+            int o = p + ((d * k + 64) >> 7);
+            sse += static_cast<uint64_t>((o - c) * (o - c));
+            cur[x] = prv[x] = static_cast<uint8_t>(o);
+        }
+    }
+    return sse;
+}
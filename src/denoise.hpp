@@ -0,0 +1,62 @@
+#pragma once
+
+#include "config.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/// Pre-encode temporal denoise (motion-adaptive recursive filter).
+///
+///   nvvidconv → NV12 (system memory) → [denoise probe] → nvvidconv → NVMM → nvv4l2h264enc
+///
+/// Jetson's VIC/NVENC expose no temporal noise filter for decoded RTSP
+/// input, so this runs on the CPU: out = prev + (cur − prev)·k, where k
+/// drops toward 1 (no filtering) as |cur − prev| grows, so motion isn't
+/// smeared. Rows are split across a ThreadPool; the inner loop uses GCC
+/// vector extensions (NEON on the Orin, SSE2 on x86).
+///
+/// If the kernel exceeds `denoise.budget_ms` on consecutive frames, the
+/// stage bypasses itself for one second instead of stalling the encoder.
+
+class Denoiser {
+public:
+    Denoiser(const ConfigStore& config, Stats& stats);
+
+    Denoiser(const Denoiser&) = delete;
+    Denoiser& operator=(const Denoiser&) = delete;
+
+    /// Install the filter as a probe on `pad` (must carry system-memory NV12).
+    void attach(GstPad* pad);
+
+    /// True while frames are being filtered (false during A/B "off" phases and bypass).
+    bool active() const { return active_.load(); }
+
+private:
+    const ConfigStore& config_;
+    Stats& stats_;
+    ThreadPool pool_;
+
+    GstVideoInfo info_;
+    bool have_info_ = false;
+    std::vector<uint8_t> prev_;   // previous filtered frame, Y then UV, tightly packed
+    bool have_prev_ = false;
+
+    uint64_t frames_ = 0;
+    int consecutive_overruns_ = 0;
+    int bypass_frames_ = 0;
+    std::atomic<bool> active_{false};
+
+    void process(GstBuffer* buf);
+
+    /// Filter rows [row0, row1) of one plane in place. Returns the squared
+    /// error between filtered and input samples (for the delta-PSNR stat).
+    uint64_t filter_rows(uint8_t* plane, int stride, uint8_t* prev, int width,
+                         int row0, int row1) const;
+
+    static GstPadProbeReturn on_probe(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+};
@@ -1,4 +1,5 @@
 #include "encoder.hpp"
+#include <gst/video/video.h>
 #include <iostream>
 
 // nvv4l2h264enc preset values (Jetson specific)
@@ -64,7 +65,10 @@ void Encoder::configure(GstElement* encoder_element,
                         const std::string& preset,
                         const std::string& profile,
                         const std::string& control_rate) {
-    encoder_ = encoder_element;
+    {
+        std::lock_guard<std::mutex> lock(element_mutex_);
+        encoder_ = encoder_element;
+    }
     target_bitrate_kbps_ = target_bitrate_kbps;
     max_bitrate_kbps_ = max_bitrate_kbps;
 
@@ -81,6 +85,7 @@ void Encoder::configure(GstElement* encoder_element,
         "preset-level",   preset_to_enum(preset),
         "profile",        profile_to_enum(profile),
         "idrinterval",    idr_interval,
+        "iframeinterval", idr_interval,   // no extra non-IDR I-frames between IDRs
         "insert-sps-pps", TRUE,
         "maxperf-enable", TRUE,    // Maximize encoder clock for lowest latency
         NULL);
@@ -118,3 +123,56 @@ void Encoder::set_bitrate(uint32_t target_kbps, uint32_t max_kbps) {
     std::cout << "[ENCODER] Bitrate updated: " << target_kbps << " / " 
               << max_kbps << " kbps" << std::endl;
 }
+
+bool Encoder::set_intra_refresh(int frames) {
+    std::lock_guard<std::mutex> lock(element_mutex_);
+    if (!encoder_) return false;
+    // Spelling differs between L4T releases
+    for (const char* prop : {"SliceIntraRefreshInterval", "slice-intra-refresh-interval"}) {
+        if (g_object_class_find_property(G_OBJECT_GET_CLASS(encoder_), prop)) {
+            g_object_set(G_OBJECT(encoder_), prop, (guint)frames, NULL);
+            std::cout << "[ENCODER] Intra refresh: one sweep every " << frames << " frames" << std::endl;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Encoder::set_b_frames(int count) {
+    std::lock_guard<std::mutex> lock(element_mutex_);
+    if (!encoder_) return false;
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(encoder_), "num-B-Frames")) return false;
+    g_object_set(G_OBJECT(encoder_), "num-B-Frames", (guint)count, NULL);
+    std::cout << "[ENCODER] " << count << " B-frame(s) per P-frame" << std::endl;
+    return true;
+}
+
+bool Encoder::set_idr_interval(int frames) {
+    std::lock_guard<std::mutex> lock(element_mutex_);
+    if (!encoder_) return false;
+    GParamSpec* spec = g_object_class_find_property(G_OBJECT_GET_CLASS(encoder_), "idrinterval");
+    if (!spec || !(spec->flags & GST_PARAM_MUTABLE_PLAYING)) return false;
+    g_object_set(G_OBJECT(encoder_), "idrinterval", frames, "iframeinterval", frames, NULL);
+    std::cout << "[ENCODER] IDR interval updated: " << frames << " frames" << std::endl;
+    return true;
+}
+
+void Encoder::release() {
+    std::lock_guard<std::mutex> lock(element_mutex_);
+    encoder_ = nullptr;
+}
+
+void Encoder::force_idr() {
+    GstElement* enc = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(element_mutex_);
+        if (encoder_) enc = GST_ELEMENT(gst_object_ref(encoder_));
+    }
+    if (!enc) return;
+    GstPad* src = gst_element_get_static_pad(enc, "src");
+    gst_object_unref(enc);
+    if (!src) return;
+    gst_pad_send_event(src, gst_video_event_new_upstream_force_key_unit(
+        GST_CLOCK_TIME_NONE, TRUE, 0));
+    gst_object_unref(src);
+}
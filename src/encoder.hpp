@@ -3,6 +3,7 @@
 #include <gst/gst.h>
 #include <string>
 #include <cstdint>
+#include <mutex>
 
 /// Manages the NVENC hardware encoder element configuration.
 /// Provides runtime bitrate adjustment without pipeline restart.
@@ -25,12 +26,34 @@ public:
     /// Change bitrate at runtime (no pipeline restart needed).
     void set_bitrate(uint32_t target_kbps, uint32_t max_kbps);
 
+    /// Enable cyclic intra refresh (one sweep every `frames`).
+    /// Returns false if this encoder build has no intra-refresh control.
+    /// Must be called before the pipeline transitions to PLAYING.
+    bool set_intra_refresh(int frames);
+
+    /// Insert `count` non-reference B-frames between reference frames.
+    /// Returns false if this encoder build has no B-frame control.
+    /// Must be called before the pipeline transitions to PLAYING.
+    bool set_b_frames(int count);
+
+    /// Change the IDR interval while PLAYING. Returns false if the encoder
+    /// only accepts it before streaming starts.
+    bool set_idr_interval(int frames);
+
+    /// Forget the element (its pipeline is being torn down).
+    void release();
+
+    /// Ask the encoder for an IDR on the next frame it produces.
+    /// Safe from any thread (upstream force-key-unit event).
+    void force_idr();
+
     /// Get current configured bitrate.
     uint32_t get_target_bitrate_kbps() const { return target_bitrate_kbps_; }
     uint32_t get_max_bitrate_kbps() const { return max_bitrate_kbps_; }
 
 private:
     GstElement* encoder_ = nullptr;
+    std::mutex element_mutex_;   // guards encoder_ against teardown from other threads
     uint32_t target_bitrate_kbps_ = 0;
     uint32_t max_bitrate_kbps_ = 0;
 
@@ -0,0 +1,175 @@
+#include "fanout.hpp"
+#include <algorithm>
+#include <chrono>
+
+/// Access units a subscriber may hold before its feeder is considered stuck
+/// (about 1 s at 30 fps); overflow drops to the next IDR.
+static constexpr size_t kMaxQueuedFrames = 30;
+
+/// Longest GOP kept for an upgrade hand-off (10 s at 30 fps).
+static constexpr size_t kMaxGopFrames = 300;
+
+// ============================================================================
+//  FanOutSubscriber
+// ============================================================================
+
+FanOutSubscriber::FanOutSubscriber(const ConfigStore& config, int id)
+    : id_(id), selector_(config) {}
+
+FanOutSubscriber::~FanOutSubscriber() {
+    for (GstSample* s : queue_) gst_sample_unref(s);
+}
+
+GstSample* FanOutSubscriber::pop(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                 [this] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) return nullptr;
+    GstSample* s = queue_.front();
+    queue_.pop_front();
+    return s;
+}
+
+void FanOutSubscriber::on_backlog(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    selector_.on_backlog(bytes);
+}
+
+void FanOutSubscriber::on_loss_report(double fraction_lost) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    selector_.on_loss_report(fraction_lost);
+}
+
+int FanOutSubscriber::max_layer() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::min(selector_.max_layer(), layer_cap_);
+}
+
+void FanOutSubscriber::cap_layers(int max_layer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    layer_cap_ = max_layer;
+}
+
+uint64_t FanOutSubscriber::thinned() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return thinned_;
+}
+
+uint64_t FanOutSubscriber::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+void FanOutSubscriber::offer(GstSample* sample, int temporal_id, bool keyframe) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) return;
+        if (keyframe) need_keyframe_ = false;
+        if (need_keyframe_) { dropped_++; return; }
+        if (temporal_id > std::min(selector_.max_layer(), layer_cap_)) { thinned_++; return; }
+        if (queue_.size() >= kMaxQueuedFrames) {
+            // Dropping a reference frame breaks decode until the next IDR anyway
+            for (GstSample* s : queue_) gst_sample_unref(s);
+            dropped_ += queue_.size() + 1;
+            queue_.clear();
+            need_keyframe_ = true;
+            return;
+        }
+        queue_.push_back(gst_sample_ref(sample));
+    }
+    cv_.notify_one();
+}
+
+void FanOutSubscriber::prime(const std::vector<GstSample*>& gop) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Past the queue cap on purpose: the feeder drains the burst at once
+        for (GstSample* s : gop) queue_.push_back(gst_sample_ref(s));
+        need_keyframe_ = true;
+    }
+    cv_.notify_one();
+}
+
+void FanOutSubscriber::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
+
+// ============================================================================
+//  FanOut
+// ============================================================================
+
+FanOut::~FanOut() {
+    close_all();
+    std::lock_guard<std::mutex> lock(mutex_);
+    clear_gop();
+    for (GstSample* s : bridge_) gst_sample_unref(s);
+    bridge_.clear();
+}
+
+std::shared_ptr<FanOutSubscriber> FanOut::subscribe() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sub = std::make_shared<FanOutSubscriber>(config_, next_id_++);
+    if (!bridge_.empty()) sub->prime(bridge_);
+    subs_.push_back(sub);
+    return sub;
+}
+
+void FanOut::unsubscribe(const std::shared_ptr<FanOutSubscriber>& sub) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subs_.erase(std::remove(subs_.begin(), subs_.end(), sub), subs_.end());
+    sub->close();
+}
+
+void FanOut::publish(GstSample* sample, int temporal_id, bool keyframe) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (keyframe) {
+        clear_gop();
+        gop_valid_ = true;
+        for (GstSample* s : bridge_) gst_sample_unref(s);
+        bridge_.clear();
+    }
+    if (gop_valid_) {
+        if (gop_.size() < kMaxGopFrames) {
+            gop_.push_back(gst_sample_ref(sample));
+        } else {
+            clear_gop();
+        }
+    }
+    for (auto& sub : subs_) sub->offer(sample, temporal_id, keyframe);
+}
+
+void FanOut::close_all() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& sub : subs_) sub->close();
+    subs_.clear();
+}
+
+std::vector<GstSample*> FanOut::current_gop() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<GstSample*> gop;
+    gop.reserve(gop_.size());
+    for (GstSample* s : gop_) gop.push_back(gst_sample_ref(s));
+    return gop;
+}
+
+void FanOut::adopt_gop(std::vector<GstSample*> gop) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (GstSample* s : bridge_) gst_sample_unref(s);
+    bridge_.clear();
+    if (gop_valid_) {
+        // Our own encoder already got there
+        for (GstSample* s : gop) gst_sample_unref(s);
+        return;
+    }
+    bridge_ = std::move(gop);
+}
+
+void FanOut::clear_gop() {
+    for (GstSample* s : gop_) gst_sample_unref(s);
+    gop_.clear();
+    gop_valid_ = false;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "config.hpp"
+#include "svc.hpp"
+
+#include <gst/gst.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// One encoded stream → every serving media.
+///
+/// The appsink's streaming thread publishes each access unit once; each
+/// media's feeder thread owns a subscriber with its own queue and its own
+/// temporal-layer cut (see svc.hpp), so a slow or lossy client is thinned
+/// to a lower frame rate without affecting the others.
+///
+/// The fan-out also holds the current GOP (access units since the last
+/// IDR) so it can be handed to a successor binary on upgrade; there it is
+/// adopted as a bridge that primes new subscribers until the local
+/// encoder's first IDR (see upgrade.hpp).
+
+class FanOutSubscriber {
+public:
+    FanOutSubscriber(const ConfigStore& config, int id);
+    ~FanOutSubscriber();
+
+    FanOutSubscriber(const FanOutSubscriber&) = delete;
+    FanOutSubscriber& operator=(const FanOutSubscriber&) = delete;
+
+    int id() const { return id_; }
+
+    /// Next access unit to send (caller owns the ref), or nullptr after
+    /// `timeout_ms` / once closed.
+    GstSample* pop(int timeout_ms);
+
+    /// Feeder: bytes still queued in this client's appsrc.
+    void on_backlog(uint64_t bytes);
+
+    /// RTCP: receiver-report fraction lost from this client.
+    void on_loss_report(double fraction_lost);
+
+    int max_layer() const;
+
+    /// Never forward layers above `max_layer` (admission downgrade),
+    /// whatever the client's conditions allow.
+    void cap_layers(int max_layer);
+
+    /// Frames not forwarded because of the layer cut / queue overflow.
+    uint64_t thinned() const;
+    uint64_t dropped() const;
+
+private:
+    friend class FanOut;
+
+    /// Publisher side. Takes its own ref on `sample` if queued.
+    void offer(GstSample* sample, int temporal_id, bool keyframe);
+    /// Queue a bridge GOP ahead of the live stream, which then resumes on its next IDR.
+    void prime(const std::vector<GstSample*>& gop);
+    void close();
+
+    int id_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<GstSample*> queue_;
+    LayerSelector selector_;
+    bool need_keyframe_ = false;   // after an overflow, resume on the next IDR
+    int layer_cap_ = 255;
+    bool closed_ = false;
+    uint64_t thinned_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+class FanOut {
+public:
+    explicit FanOut(const ConfigStore& config) : config_(config) {}
+    ~FanOut();
+
+    std::shared_ptr<FanOutSubscriber> subscribe();
+    void unsubscribe(const std::shared_ptr<FanOutSubscriber>& sub);
+
+    /// Streaming thread: hand one access unit to every subscriber.
+    void publish(GstSample* sample, int temporal_id, bool keyframe);
+
+    /// Wake and detach every subscriber (pipeline stopping).
+    void close_all();
+
+    /// Access units since the last IDR (new refs, caller unrefs); empty
+    /// when none was seen yet or the GOP outgrew what is kept.
+    std::vector<GstSample*> current_gop() const;
+
+    /// Upgrade: a predecessor's last GOP. Takes the refs. Subscribers that
+    /// arrive before the first local IDR start with it.
+    void adopt_gop(std::vector<GstSample*> gop);
+
+private:
+    const ConfigStore& config_;
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<FanOutSubscriber>> subs_;
+    std::vector<GstSample*> gop_;       // since the last IDR
+    bool gop_valid_ = false;            // gop_ starts with an IDR
+    std::vector<GstSample*> bridge_;    // adopted; dropped on the first local IDR
+    int next_id_ = 1;
+
+    void clear_gop();
+};
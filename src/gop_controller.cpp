@@ -0,0 +1,130 @@
+#include "gop_controller.hpp"
+#include <algorithm>
+#include <cmath>
+
+/// Frames to wait for a requested IDR before asking again
+/// (covers conv/enc pipeline depth).
+static constexpr uint32_t kRequestTimeoutFrames = 15;
+
+GopController::GopController(const ConfigStore& config) : config_(config) {
+    reset();
+}
+
+void GopController::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gop_ = std::clamp(static_cast<double>(config_->encoder.idr_interval),
+                      static_cast<double>(config_->gop.min_frames),
+                      static_cast<double>(config_->gop.max_frames));
+    frames_since_idr_ = 0;
+    idr_requested_ = false;
+    frames_since_request_ = 0;
+    pli_pending_ = false;
+    last_pli_to_idr_ms_ = -1;
+}
+
+void GopController::set_refresh_recovery(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    refresh_recovery_ = enabled;
+}
+
+bool GopController::request_idr_locked(Clock::time_point now) {
+    if (idr_requested_) return false;
+    idr_requested_ = true;
+    frames_since_request_ = 0;
+    last_forced_ = now;
+    return true;
+}
+
+bool GopController::on_frame(bool keyframe) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+
+    if (keyframe) {
+        frames_since_idr_ = 0;
+        idr_requested_ = false;
+        if (pli_pending_) {
+            last_pli_to_idr_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+                now - first_pending_pli_).count();
+            pli_pending_ = false;
+        } else {
+            last_pli_to_idr_ms_ = -1;
+        }
+        return false;
+    }
+
+    frames_since_idr_++;
+    if (idr_requested_ && ++frames_since_request_ > kRequestTimeoutFrames) {
+        idr_requested_ = false;  // lost in the encoder; allow another request
+    }
+    if (frames_since_idr_ + 1 >= static_cast<uint32_t>(gop_)) {
+        return request_idr_locked(now);
+    }
+    return false;
+}
+
+void GopController::on_loss_report(double fraction_lost) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loss_sample_ = std::max(loss_sample_, fraction_lost);
+    loss_seen_ = true;
+}
+
+bool GopController::on_pli() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    plis_this_tick_++;
+    if (!pli_pending_) {
+        pli_pending_ = true;
+        first_pending_pli_ = now;
+    }
+    if (refresh_recovery_) return false;
+    auto since = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_forced_).count();
+    if (since < config_->gop.pli_min_interval_ms) return false;
+    return request_idr_locked(now);
+}
+
+bool GopController::on_client_play() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return request_idr_locked(Clock::now());
+}
+
+void GopController::tick(int clients) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const GopConfig& gc = config_->gop;
+
+    if (loss_seen_) loss_ewma_ = 0.7 * loss_ewma_ + 0.3 * loss_sample_;
+    pli_rate_ = 0.7 * pli_rate_ + 0.3 * plis_this_tick_;
+    loss_sample_ = 0.0;
+    loss_seen_ = false;
+
+    // Every extra viewer shares the cost of a long wait for a recovery point
+    double ceiling = gc.max_frames / std::sqrt(static_cast<double>(std::max(clients, 1)));
+    ceiling = std::max(ceiling, static_cast<double>(gc.min_frames));
+
+    bool lossy = !refresh_recovery_ &&
+                 (loss_ewma_ * 100.0 > gc.loss_threshold_pct || plis_this_tick_ > 0);
+    gop_ = lossy ? gop_ * 0.5 : gop_ * 1.1;
+    gop_ = std::clamp(gop_, static_cast<double>(gc.min_frames), ceiling);
+    plis_this_tick_ = 0;
+}
+
+int GopController::gop_frames() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(gop_);
+}
+
+double GopController::loss_ewma() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return loss_ewma_;
+}
+
+double GopController::pli_rate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pli_rate_;
+}
+
+int64_t GopController::take_pli_to_idr_ms() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t v = last_pli_to_idr_ms_;
+    last_pli_to_idr_ms_ = -1;
+    return v;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+/// Loss-adaptive GOP length.
+///
+/// The encoder's own IDR cadence is pushed out of the way and this
+/// controller decides when an IDR is due:
+///   - clean link (RTCP loss below threshold, no PLIs): the GOP grows by
+///     ~10% per second up to `gop.max_frames` (fewer needless IDRs);
+///   - loss or PLIs: the GOP halves, down to `gop.min_frames` (recovery
+///     points come sooner);
+///   - more viewers shrink the ceiling — a long GOP hurts every one of them.
+/// A PLI or a client pressing PLAY forces an IDR immediately (rate limited),
+/// so a long GOP never leaves a new or damaged viewer waiting for one.
+///
+/// Thread-safe: frames arrive on the streaming thread, feedback on the RTCP
+/// thread, ticks on the main loop.
+
+class GopController {
+public:
+    explicit GopController(const ConfigStore& config);
+
+    /// Restart from the configured `encoder.idr_interval` (new encoder).
+    void reset();
+
+    /// The encoder heals loss by intra refresh: PLIs no longer force IDRs
+    /// and the GOP stays at its ceiling (IDRs only serve joining clients).
+    void set_refresh_recovery(bool enabled);
+
+    /// Per encoded frame. Returns true if an IDR should be requested now.
+    bool on_frame(bool keyframe);
+
+    /// Receiver-report fraction lost (0.0-1.0) for our stream.
+    void on_loss_report(double fraction_lost);
+
+    /// Picture loss indication / FIR from a client.
+    /// Returns true if an IDR should be requested now.
+    bool on_pli();
+
+    /// A client started playing. Returns true if an IDR should be requested now.
+    bool on_client_play();
+
+    /// Once per second: fold feedback into the GOP length.
+    void tick(int clients);
+
+    int gop_frames() const;
+    double loss_ewma() const;
+    double pli_rate() const;
+
+    /// Time from the oldest unanswered PLI to the IDR that answered it (ms),
+    /// or -1 if this keyframe answered none. Call after on_frame() for keyframes.
+    int64_t take_pli_to_idr_ms();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const ConfigStore& config_;
+    mutable std::mutex mutex_;
+
+    double gop_ = 30.0;
+    bool refresh_recovery_ = false;
+    uint32_t frames_since_idr_ = 0;
+    bool idr_requested_ = false;
+    uint32_t frames_since_request_ = 0;
+
+    double loss_ewma_ = 0.0;
+    double loss_sample_ = 0.0;
+    bool loss_seen_ = false;
+    uint32_t plis_this_tick_ = 0;
+    double pli_rate_ = 0.0;
+
+    Clock::time_point last_forced_{};
+    Clock::time_point first_pending_pli_{};
+    bool pli_pending_ = false;
+    int64_t last_pli_to_idr_ms_ = -1;
+
+    bool request_idr_locked(Clock::time_point now);
+};
@@ -0,0 +1,395 @@
+#include "h264.hpp"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const char* h264_nal_type_name(uint8_t type) {
+    switch (type) {
+    case NAL_SLICE:  return "slice";
+    case NAL_IDR:    return "idr";
+    case NAL_SEI:    return "sei";
+    case NAL_SPS:    return "sps";
+    case NAL_PPS:    return "pps";
+    case NAL_AUD:    return "aud";
+    case NAL_FILLER: return "filler";
+    }
+    return nullptr;
+}
+
+// ============================================================================
+//  Annex-B scanning
+// ============================================================================
+
+/// First index >= i holding a zero byte, or `size`. Most of a slice has
+/// no zero bytes (emulation prevention breaks up runs), so whole vectors
+/// are skipped.
+static size_t next_zero(const uint8_t* data, size_t i, size_t size) {
+#if defined(__aarch64__)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    while (i + 16 <= size) {
+        if (vmaxvq_u8(vceqq_u8(vld1q_u8(data + i), zero))) break;
+        i += 16;
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= size) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), zero));
+        if (mask) return i + __builtin_ctz(mask);
+        i += 16;
+    }
+#endif
+    while (i < size && data[i] != 0) i++;
+    return i;
+}
+
+/// Index of the next 00 00 01 at or after i, or `size`.
+static size_t next_start_code(const uint8_t* data, size_t i, size_t size) {
+    for (;;) {
+        i = next_zero(data, i, size);
+        if (i + 2 >= size) return size;
+        if (data[i + 1] != 0) { i += 2; continue; }
+        if (data[i + 2] == 1) return i;
+        i++;
+    }
+}
+
+void h264_split_nals(const uint8_t* data, size_t size, std::vector<NalUnit>& nals) {
+    nals.clear();
+    size_t i = next_start_code(data, 0, size);
+    while (i < size) {
+        size_t start = i + 3;
+        size_t next = next_start_code(data, start, size);
+        if (start < size) {
+            size_t end = next;
+            if (next < size) {
+                while (end > start && data[end - 1] == 0) end--;  // trailing_zero_8bits / 4-byte start code
+            }
+            NalUnit n;
+            n.offset = start;
+            n.size = end - start;
+            n.type = data[start] & 0x1F;
+            n.ref_idc = (data[start] >> 5) & 0x03;
+            nals.push_back(n);
+        }
+        i = next;
+    }
+}
+
+std::vector<NalUnit> h264_split_nals(const uint8_t* data, size_t size) {
+    std::vector<NalUnit> nals;
+    h264_split_nals(data, size, nals);
+    return nals;
+}
+
+// ============================================================================
+//  RBSP bit reader (skips emulation prevention bytes on the fly)
+// ============================================================================
+
+namespace {
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool ok() const { return !overrun_; }
+
+    uint32_t u(int n) {
+        uint32_t v = 0;
+        for (int i = 0; i < n; i++) v = (v << 1) | bit();
+        return v;
+    }
+
+    uint32_t ue() {
+        int zeros = 0;
+        while (bit() == 0) {
+            if (++zeros > 31 || overrun_) { overrun_ = true; return 0; }
+        }
+        return ((1u << zeros) - 1) + u(zeros);
+    }
+
+    int32_t se() {
+        uint32_t k = ue();
+        return (k & 1) ? static_cast<int32_t>((k + 1) / 2) : -static_cast<int32_t>(k / 2);
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t byte_ = 0;
+    int bit_ = 0;
+    int zero_run_ = 0;
+    bool overrun_ = false;
+
+    uint32_t bit() {
+        if (bit_ == 0) {
+            // 0x00 0x00 0x03 → drop the 0x03
+            if (zero_run_ >= 2 && byte_ < size_ && data_[byte_] == 0x03) {
+                byte_++;
+                zero_run_ = 0;
+            }
+        }
+        if (byte_ >= size_) { overrun_ = true; return 0; }
+        uint32_t v = (data_[byte_] >> (7 - bit_)) & 1;
+        if (++bit_ == 8) {
+            zero_run_ = data_[byte_] == 0 ? zero_run_ + 1 : 0;
+            bit_ = 0;
+            byte_++;
+        }
+        return v;
+    }
+};
+
+void skip_scaling_list(BitReader& br, int size) {
+    int last = 8, next = 8;
+    for (int j = 0; j < size; j++) {
+        if (next != 0) next = (last + br.se() + 256) % 256;
+        last = (next == 0) ? last : next;
+    }
+}
+
+}  // namespace
+
+// ============================================================================
+//  Parameter sets
+// ============================================================================
+
+bool H264SliceParser::parse_sps(const uint8_t* rbsp, size_t size) {
+    BitReader br(rbsp, size);
+    Sps s;
+    s.profile_idc = br.u(8);
+    br.u(16);  // constraint flags + level_idc
+    uint32_t id = br.ue();
+    if (id >= 32) return false;
+
+    switch (s.profile_idc) {
+        case 100: case 110: case 122: case 244: case 44:
+        case 83: case 86: case 118: case 128: case 138: case 139: case 134: case 135: {
+            s.chroma_format_idc = br.ue();
+            if (s.chroma_format_idc == 3) s.separate_colour_plane = br.u(1);
+            br.ue(); br.ue();   // bit depths
+            br.u(1);            // qpprime_y_zero_transform_bypass
+            if (br.u(1)) {      // seq_scaling_matrix_present
+                int lists = (s.chroma_format_idc != 3) ? 8 : 12;
+                for (int i = 0; i < lists; i++) {
+                    if (br.u(1)) skip_scaling_list(br, i < 6 ? 16 : 64);
+                }
+            }
+            break;
+        }
+        default: break;
+    }
+
+    s.log2_max_frame_num = br.ue() + 4;
+    s.poc_type = br.ue();
+    if (s.poc_type == 0) {
+        s.log2_max_poc_lsb = br.ue() + 4;
+    } else if (s.poc_type == 1) {
+        s.delta_pic_order_always_zero = br.u(1);
+        br.se(); br.se();
+        uint32_t n = br.ue();
+        for (uint32_t i = 0; i < n && br.ok(); i++) br.se();
+    }
+    br.ue();  // max_num_ref_frames
+    br.u(1);  // gaps_in_frame_num_value_allowed
+    int w_mbs = br.ue() + 1;
+    int h_map = br.ue() + 1;
+    s.frame_mbs_only = br.u(1);
+    if (!s.frame_mbs_only) br.u(1);  // mb_adaptive_frame_field
+    br.u(1);  // direct_8x8_inference
+
+    int crop_l = 0, crop_r = 0, crop_t = 0, crop_b = 0;
+    if (br.u(1)) {
+        crop_l = br.ue(); crop_r = br.ue(); crop_t = br.ue(); crop_b = br.ue();
+    }
+    if (!br.ok()) return false;
+
+    int sub_w = (s.chroma_format_idc == 1 || s.chroma_format_idc == 2) ? 2 : 1;
+    int sub_h = (s.chroma_format_idc == 1) ? 2 : 1;
+    int frame_h_mbs = (2 - s.frame_mbs_only) * h_map;
+    width_  = w_mbs * 16 - sub_w * (crop_l + crop_r);
+    height_ = frame_h_mbs * 16 - sub_h * (2 - s.frame_mbs_only) * (crop_t + crop_b);
+
+    s.valid = true;
+    sps_[id] = s;
+    return true;
+}
+
+bool H264SliceParser::parse_pps(const uint8_t* rbsp, size_t size) {
+    BitReader br(rbsp, size);
+    Pps p;
+    uint32_t id = br.ue();
+    p.sps_id = br.ue();
+    if (id >= 256 || p.sps_id >= 32) return false;
+    p.entropy_coding = br.u(1);
+    p.bottom_field_pic_order_in_frame_present = br.u(1);
+    if (br.ue() != 0) return false;  // slice groups (FMO) — never produced by NVENC
+    p.num_ref_idx_l0_default = br.ue() + 1;
+    p.num_ref_idx_l1_default = br.ue() + 1;
+    p.weighted_pred = br.u(1);
+    p.weighted_bipred_idc = br.u(2);
+    p.pic_init_qp = 26 + br.se();
+    br.se();  // pic_init_qs
+    br.se();  // chroma_qp_index_offset
+    br.u(1);  // deblocking_filter_control_present
+    br.u(1);  // constrained_intra_pred
+    p.redundant_pic_cnt_present = br.u(1);
+    if (!br.ok()) return false;
+
+    p.valid = true;
+    pps_[id] = p;
+    return true;
+}
+
+// ============================================================================
+//  Slice header
+// ============================================================================
+
+int H264SliceParser::parse_slice_qp(const uint8_t* rbsp, size_t size,
+                                    uint8_t nal_type, uint8_t ref_idc) {
+    BitReader br(rbsp, size);
+    br.ue();  // first_mb_in_slice
+    uint32_t slice_type = br.ue() % 5;  // 0=P 1=B 2=I 3=SP 4=SI
+    uint32_t pps_id = br.ue();
+    if (pps_id >= 256 || !pps_[pps_id].valid) return -1;
+    const Pps& p = pps_[pps_id];
+    const Sps& s = sps_[p.sps_id];
+    if (!s.valid) return -1;
+
+    bool is_b = slice_type == 1;
+    bool is_p = slice_type == 0 || slice_type == 3;
+    bool is_i = slice_type == 2 || slice_type == 4;
+
+    if (s.separate_colour_plane) br.u(2);
+    br.u(s.log2_max_frame_num);
+    bool field_pic = false;
+    if (!s.frame_mbs_only) {
+        field_pic = br.u(1);
+        if (field_pic) br.u(1);
+    }
+    if (nal_type == NAL_IDR) br.ue();  // idr_pic_id
+    if (s.poc_type == 0) {
+        br.u(s.log2_max_poc_lsb);
+        if (p.bottom_field_pic_order_in_frame_present && !field_pic) br.se();
+    } else if (s.poc_type == 1 && !s.delta_pic_order_always_zero) {
+        br.se();
+        if (p.bottom_field_pic_order_in_frame_present && !field_pic) br.se();
+    }
+    if (p.redundant_pic_cnt_present) br.ue();
+    if (is_b) br.u(1);  // direct_spatial_mv_pred
+
+    int num_l0 = p.num_ref_idx_l0_default;
+    int num_l1 = p.num_ref_idx_l1_default;
+    if (is_p || is_b) {
+        if (br.u(1)) {  // num_ref_idx_active_override
+            num_l0 = br.ue() + 1;
+            if (is_b) num_l1 = br.ue() + 1;
+        }
+    }
+
+    // ref_pic_list_modification
+    for (int list = 0; list < (is_b ? 2 : 1) && !is_i; list++) {
+        if (!br.u(1)) continue;
+        for (int guard = 0; guard < 64 && br.ok(); guard++) {
+            uint32_t idc = br.ue();
+            if (idc == 3) break;
+            br.ue();
+        }
+    }
+
+    // pred_weight_table
+    if ((p.weighted_pred && is_p) || (p.weighted_bipred_idc == 1 && is_b)) {
+        br.ue();
+        if (s.chroma_format_idc != 0) br.ue();
+        for (int list = 0; list < (is_b ? 2 : 1); list++) {
+            int n = list == 0 ? num_l0 : num_l1;
+            for (int i = 0; i < n && br.ok(); i++) {
+                if (br.u(1)) { br.se(); br.se(); }
+                if (s.chroma_format_idc != 0 && br.u(1)) {
+                    br.se(); br.se(); br.se(); br.se();
+                }
+            }
+        }
+    }
+
+    // dec_ref_pic_marking
+    if (ref_idc != 0) {
+        if (nal_type == NAL_IDR) {
+            br.u(2);
+        } else if (br.u(1)) {
+            for (int guard = 0; guard < 64 && br.ok(); guard++) {
+                uint32_t mmco = br.ue();
+                if (mmco == 0) break;
+                if (mmco == 1 || mmco == 3) br.ue();
+                if (mmco == 2) br.ue();
+                if (mmco == 3 || mmco == 6) br.ue();
+                if (mmco == 4) br.ue();
+            }
+        }
+    }
+
+    if (p.entropy_coding && !is_i) br.ue();  // cabac_init_idc
+    int qp = p.pic_init_qp + br.se();
+    return br.ok() ? qp : -1;
+}
+
+int H264SliceParser::parse_access_unit(const uint8_t* data, size_t size) {
+    return parse_access_unit(data, h264_split_nals(data, size));
+}
+
+int H264SliceParser::parse_access_unit(const uint8_t* data, const std::vector<NalUnit>& nals) {
+    int qp = -1;
+    for (const NalUnit& n : nals) {
+        if (n.size < 2) continue;
+        const uint8_t* rbsp = data + n.offset + 1;
+        size_t len = n.size - 1;
+        switch (n.type) {
+            case NAL_SPS: parse_sps(rbsp, len); break;
+            case NAL_PPS: parse_pps(rbsp, len); break;
+            case NAL_SLICE:
+            case NAL_IDR:
+                if (qp < 0) qp = parse_slice_qp(rbsp, len, n.type, n.ref_idc);
+                break;
+            default: break;
+        }
+    }
+    return qp;
+}
+
+// ============================================================================
+//  Access unit scan
+// ============================================================================
+
+void h264_scan_access_unit(const uint8_t* data, size_t size, AccessUnitInfo& info) {
+    h264_split_nals(data, size, info.nals);
+    info.keyframe = false;
+    info.sps_id = info.pps_id = info.slice_pps_id = -1;
+
+    for (const NalUnit& n : info.nals) {
+        if (n.size < 2) continue;
+        BitReader br(data + n.offset + 1, n.size - 1);
+        switch (n.type) {
+            case NAL_SPS:
+                br.u(24);   // profile_idc, constraint flags, level_idc
+                info.sps_id = static_cast<int>(br.ue());
+                break;
+            case NAL_PPS:
+                info.pps_id = static_cast<int>(br.ue());
+                break;
+            case NAL_IDR:
+                info.keyframe = true;
+                // fall through
+            case NAL_SLICE:
+                if (info.slice_pps_id < 0) {
+                    br.ue();   // first_mb_in_slice
+                    br.ue();   // slice_type
+                    info.slice_pps_id = static_cast<int>(br.ue());
+                }
+                break;
+            default: break;
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Minimal H.264 Annex-B bitstream helpers.
+/// Enough of SPS/PPS/slice-header parsing to read per-frame encoder
+/// decisions (slice QP) without a decoder, and a start-code scanner fast
+/// enough to run once per encoded frame in place of h264parse.
+
+enum H264NalType : uint8_t {
+    NAL_SLICE  = 1,
+    NAL_IDR    = 5,
+    NAL_SEI    = 6,
+    NAL_SPS    = 7,
+    NAL_PPS    = 8,
+    NAL_AUD    = 9,
+    NAL_FILLER = 12,
+};
+
+/// Lower-case short name of a NAL unit type ("sps", "aud", ...), or
+/// nullptr for types this tree does not name.
+const char* h264_nal_type_name(uint8_t type);
+
+struct NalUnit {
+    size_t offset = 0;      // start of the NAL header (after the start code)
+    size_t size = 0;        // NAL header + payload, excluding the next start code
+    uint8_t type = 0;
+    uint8_t ref_idc = 0;
+};
+
+/// Split an Annex-B access unit into NAL units.
+std::vector<NalUnit> h264_split_nals(const uint8_t* data, size_t size);
+
+/// Same, into `nals` (cleared; its capacity is reused).
+void h264_split_nals(const uint8_t* data, size_t size, std::vector<NalUnit>& nals);
+
+/// One scan of an encoded access unit: everything downstream consumers
+/// need, so none of them has to look for start codes again.
+struct AccessUnitInfo {
+    std::vector<NalUnit> nals;
+    bool keyframe = false;     // carries an IDR slice
+    int sps_id = -1;           // in-band SPS in this AU, else -1
+    int pps_id = -1;           // in-band PPS in this AU, else -1
+    int slice_pps_id = -1;     // PPS the first slice refers to
+};
+
+/// Scan an Annex-B access unit into `info` (start codes found 16 bytes at
+/// a time with NEON on aarch64, SSE2 on x86-64).
+void h264_scan_access_unit(const uint8_t* data, size_t size, AccessUnitInfo& info);
+
+/// Tracks SPS/PPS and reads slice headers up to slice_qp_delta.
+class H264SliceParser {
+public:
+    H264SliceParser() = default;
+
+    /// Parse every NAL of an access unit. Returns the QP of the first slice,
+    /// or -1 if the AU carries no parsable slice (e.g. PPS not seen yet).
+    int parse_access_unit(const uint8_t* data, size_t size);
+
+    /// Same, over NAL units already found by h264_scan_access_unit.
+    int parse_access_unit(const uint8_t* data, const std::vector<NalUnit>& nals);
+
+    /// Width/height from the last SPS (0 until one has been seen).
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    struct Sps {
+        bool valid = false;
+        int profile_idc = 0;
+        int chroma_format_idc = 1;
+        bool separate_colour_plane = false;
+        int log2_max_frame_num = 4;
+        int poc_type = 0;
+        int log2_max_poc_lsb = 4;
+        bool delta_pic_order_always_zero = false;
+        bool frame_mbs_only = true;
+    };
+    struct Pps {
+        bool valid = false;
+        int sps_id = 0;
+        bool entropy_coding = false;
+        bool bottom_field_pic_order_in_frame_present = false;
+        int num_ref_idx_l0_default = 1;
+        int num_ref_idx_l1_default = 1;
+        bool weighted_pred = false;
+        int weighted_bipred_idc = 0;
+        int pic_init_qp = 26;
+        bool redundant_pic_cnt_present = false;
+    };
+
+    Sps sps_[32];
+    Pps pps_[256];
+    int width_ = 0;
+    int height_ = 0;
+
+    bool parse_sps(const uint8_t* rbsp, size_t size);
+    bool parse_pps(const uint8_t* rbsp, size_t size);
+    int parse_slice_qp(const uint8_t* rbsp, size_t size, uint8_t nal_type, uint8_t ref_idc);
+};
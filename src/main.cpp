@@ -5,22 +5,34 @@
 // Ingests RTSP from robot dog camera, re-encodes with NVENC at lower bitrate,
 // serves as local RTSP for go2rtc to consume and serve as WebRTC.
 //
-// Usage: ./rtsp_encoder [--config config.yaml]
+// Usage: ./rtsp_encoder [--config config.yaml] [--upgrade] [--bench-parse FILE] [--bench-connect N]
+//        kill -HUP <pid> reloads the config file in place
+//        --upgrade takes over serving from the running instance
 // =============================================================================
 
+#include "arena_allocator.hpp"
 #include "config.hpp"
+#include "connect_bench.hpp"
+#include "parse_bench.hpp"
 #include "pipeline.hpp"
+#include "startup.hpp"
 #include "stats.hpp"
+#include "thread_roles.hpp"
 
 #include <gst/gst.h>
+#include <glib-unix.h>
 #include <iostream>
 #include <csignal>
 #include <cstring>
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <future>
 #include <unistd.h>
 
+/// Upper bound on the startup DESCRIBE to the camera.
+static constexpr int kDescribeTimeoutMs = 2000;
+
 static std::atomic<bool> g_running{true};
 static GMainLoop* g_main_loop = nullptr;
 
@@ -33,14 +45,52 @@ static void signal_handler(int) {
     }
 }
 
-static std::string parse_config_path(int argc, char* argv[]) {
+struct ReloadContext {
+    std::string path;
+    Pipeline* pipeline;
+};
+
+/// SIGHUP (main loop): re-read the config file and apply the difference.
+/// A file that fails to parse or validate leaves the running config alone.
+static gboolean on_sighup(gpointer data) {
+    ReloadContext* ctx = static_cast<ReloadContext*>(data);
+    std::cout << "[MAIN] SIGHUP: reloading " << ctx->path << std::endl;
+    try {
+        AppConfig next = load_config(ctx->path);
+        validate_config(next);
+        ctx->pipeline->reload(next);
+    } catch (const std::exception& e) {
+        std::cerr << "[MAIN] Reload rejected: " << e.what() << std::endl;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/// `worker_ring` is set when this process was spawned as the split-mode
+/// encoder worker (internal; see WorkerProcess). `upgrade`: take over from
+/// the running instance (see upgrade.hpp). `bench_parse`: time output-path
+/// parsing on a recording and exit (see parse_bench.hpp). `bench_connect`:
+/// time N concurrent connects to the running instance and exit
+/// (see connect_bench.hpp).
+static std::string parse_config_path(int argc, char* argv[], std::string& worker_ring, bool& upgrade,
+                                     std::string& bench_parse, int& bench_connect) {
     std::string path = "config.yaml";
     for (int i = 1; i < argc; i++) {
         if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) && i + 1 < argc) {
             path = argv[i + 1]; i++;
+        } else if (strcmp(argv[i], "--worker") == 0 && i + 1 < argc) {
+            worker_ring = argv[i + 1]; i++;
+        } else if (strcmp(argv[i], "--upgrade") == 0) {
+            upgrade = true;
+        } else if (strcmp(argv[i], "--bench-parse") == 0 && i + 1 < argc) {
+            bench_parse = argv[i + 1]; i++;
+        } else if (strcmp(argv[i], "--bench-connect") == 0 && i + 1 < argc) {
+            bench_connect = atoi(argv[i + 1]); i++;
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-            std::cout << "Usage: " << argv[0] << " [-c config.yaml]" << std::endl;
+            std::cout << "Usage: " << argv[0] << " [-c config.yaml] [--upgrade]" << std::endl;
             std::cout << "  Re-encodes RTSP at lower bitrate, serves local RTSP for go2rtc" << std::endl;
+            std::cout << "  --upgrade  take over clients from the running instance, which then exits" << std::endl;
+            std::cout << "  --bench-parse FILE  per-frame parse cost on an Annex-B .h264 file, then exit" << std::endl;
+            std::cout << "  --bench-connect N   connect latency of the running instance, 1 then N clients at once" << std::endl;
             exit(0);
         }
     }
@@ -48,25 +98,92 @@ static std::string parse_config_path(int argc, char* argv[]) {
 }
 
 int main(int argc, char* argv[]) {
-    std::cout << "========================================" << std::endl;
-    std::cout << "  RTSP Re-Encoder for WebRTC" << std::endl;
-    std::cout << "  Jetson Orin NX | 5G AI-RAN Demo" << std::endl;
-    std::cout << "========================================" << std::endl;
+    StartupTrace startup;
+    std::string worker_ring;
+    bool upgrade = false;
+    std::string bench_parse;
+    int bench_connect = 0;
+    std::string config_path = parse_config_path(argc, argv, worker_ring, upgrade, bench_parse, bench_connect);
+    if (!bench_parse.empty()) {
+        gst_init(&argc, &argv);
+        return run_parse_bench(bench_parse);
+    }
+    if (bench_connect > 0) {
+        try {
+            return run_connect_bench(load_config(config_path), bench_connect);
+        } catch (const std::exception& e) {
+            std::cerr << "[MAIN] Config error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    bool worker = !worker_ring.empty();
 
-    std::string config_path = parse_config_path(argc, argv);
+    if (worker) {
+        std::cout << "[MAIN] Encoder worker (pid " << getpid() << ")" << std::endl;
+    } else {
+        std::cout << "========================================" << std::endl;
+        std::cout << "  RTSP Re-Encoder for WebRTC" << std::endl;
+        std::cout << "  Jetson Orin NX | 5G AI-RAN Demo" << std::endl;
+        std::cout << "========================================" << std::endl;
+    }
+
+    // Config check runs alongside gst_init (the registry load dominates it)
+    std::future<AppConfig> config_future = std::async(std::launch::async, [&]() {
+        int64_t t = startup.now_ns();
+        AppConfig c = load_config(config_path);
+        validate_config(c);
+        startup.phase("config", t);
+        return c;
+    });
+
+    startup.prepare_registry();
+    int64_t t_init = startup.now_ns();
+    gst_init(&argc, &argv);
+    startup.phase("gst_init", t_init);
 
     AppConfig config;
     try {
-        config = load_config(config_path);
-        validate_config(config);
+        config = config_future.get();
     } catch (const std::exception& e) {
         std::cerr << "[MAIN] Config error: " << e.what() << std::endl;
         return 1;
     }
-    print_config(config);
+    // Split mode: this process serves; a worker process (this binary again,
+    // with --worker) encodes
+    bool server = !worker && config.isolation.mode == "split";
+    if (!worker) {
+        print_config(config);
+        std::cout << "[MAIN] GStreamer: " << gst_version_string() << std::endl;
+    }
 
-    gst_init(&argc, &argv);
-    std::cout << "[MAIN] GStreamer: " << gst_version_string() << std::endl;
+    // Camera DESCRIBE overlaps plugin loading, pipeline build and server start.
+    // Its result is only logged; the future's destructor waits (bounded) at exit.
+    std::future<bool> describe;
+    if (!server) {
+        describe = std::async(std::launch::async, [&]() {
+            int64_t t = startup.now_ns();
+            // Mosaic: every input at once (rtsp.url is input 0)
+            const std::vector<std::string>& extra = config.mosaic.enabled ? config.mosaic.sources
+                                                                          : std::vector<std::string>();
+            std::vector<std::future<bool>> inputs;
+            for (size_t i = 0; i < extra.size(); i++) {
+                inputs.push_back(std::async(std::launch::async, probe_source, extra[i], kDescribeTimeoutMs,
+                                            "input " + std::to_string(i + 1)));
+            }
+            bool ok = probe_source(config.rtsp.url, kDescribeTimeoutMs, extra.empty() ? "camera" : "input 0");
+            for (auto& f : inputs) ok = f.get() && ok;
+            startup.phase("source DESCRIBE", t);
+            return ok;
+        });
+    }
+
+    int64_t t_load = startup.now_ns();
+    std::vector<std::string> missing = preload_elements(required_elements(config, !server, !worker));
+    startup.phase("element preload", t_load);
+    if (!missing.empty()) {
+        for (const auto& name : missing) std::cerr << "[MAIN] Missing GStreamer element: " << name << std::endl;
+        return 1;
+    }
 
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
@@ -78,7 +195,21 @@ int main(int argc, char* argv[]) {
     g_main_loop = g_main_loop_new(NULL, FALSE);
 
     Stats stats;
-    Pipeline pipeline(config, stats);
+    arena_allocator_install(config, stats);
+    thread_roles_configure(config.threads);
+    Pipeline pipeline(config, stats, &startup);
+    if (worker) {
+        std::unique_ptr<ShmRing> ring = ShmRing::open(worker_ring);
+        if (!ring) {
+            std::cerr << "[MAIN] Cannot attach to " << worker_ring << std::endl;
+            g_main_loop_unref(g_main_loop);
+            return 1;
+        }
+        pipeline.run_as_worker(std::move(ring));
+    } else if (server) {
+        pipeline.run_as_server(config_path);
+    }
+    if (upgrade && !worker) pipeline.take_over();
 
     if (!pipeline.start()) {
         std::cerr << "[MAIN] Failed to start" << std::endl;
@@ -86,29 +217,38 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Monitor thread: stats + watchdog
+    ReloadContext reload_ctx{config_path, &pipeline};
+    g_unix_signal_add(SIGHUP, on_sighup, &reload_ctx);
+
+    // Monitor thread: stats only. The watchdog and restarts run as a state
+    // machine on the main loop (see Pipeline), so nothing here blocks.
     std::thread monitor([&]() {
+        thread_role_enter(ThreadRole::Monitor);
         auto last_stats = std::chrono::steady_clock::now();
         while (g_running.load()) {
             std::this_thread::sleep_for(std::chrono::seconds(1));
             if (!g_running.load()) break;
 
-            if (config.stats.enabled) {
+            const StatsConfig& sc = pipeline.config()->stats;   // follows reloads
+            if (sc.enabled) {
                 auto now = std::chrono::steady_clock::now();
                 auto dt = std::chrono::duration_cast<std::chrono::seconds>(now - last_stats).count();
-                if (dt >= config.stats.interval_s) {
+                if (dt >= sc.interval_s) {
                     stats.print();
+                    thread_roles_print();
                     last_stats = now;
                 }
             }
 
-            if (!pipeline.watchdog_check()) {
-                std::cerr << "[WATCHDOG] Restarting encoder..." << std::endl;
-                if (g_running.load() && !pipeline.restart_encoder()) {
-                    std::cerr << "[MAIN] Restart failed, exiting" << std::endl;
-                    g_running.store(false);
-                    g_main_loop_quit(g_main_loop);
-                }
+            if (pipeline.failed()) {
+                std::cerr << "[MAIN] Restart failed, exiting" << std::endl;
+                g_running.store(false);
+                g_main_loop_quit(g_main_loop);
+            }
+            if (pipeline.retired()) {
+                std::cout << "[MAIN] Handed over, exiting" << std::endl;
+                g_running.store(false);
+                g_main_loop_quit(g_main_loop);
             }
         }
     });
@@ -0,0 +1,183 @@
+#include "mosaic.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+static int64_t now_ns() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+/// Set a property only if the element/pad class has it (nvcompositor
+/// versions differ in which GstAggregator/GstVideoAggregator props they expose).
+static void set_if_exists(gpointer obj, const char* name, int value) {
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(obj), name)) {
+        g_object_set(obj, name, value, NULL);
+    }
+}
+
+Mosaic::Mosaic(const ConfigStore& config, Stats& stats)
+    : config_(config), stats_(stats) {}
+
+const std::string& Mosaic::input_url(size_t index) const {
+    return index == 0 ? config_->rtsp.url : config_->mosaic.sources[index - 1];
+}
+
+MosaicTile Mosaic::tile_for(size_t index) const {
+    if (!config_->mosaic.tiles.empty()) return config_->mosaic.tiles[index];
+
+    int n = static_cast<int>(input_count());
+    int cols = std::min(config_->mosaic.columns, n);
+    int rows = (n + cols - 1) / cols;
+
+    MosaicTile t;
+    t.width  = (config_->encoder.width / cols) & ~1;   // NV12/RGBA tiles stay even
+    t.height = (config_->encoder.height / rows) & ~1;
+    t.x = static_cast<int>(index % cols) * t.width;
+    t.y = static_cast<int>(index / cols) * t.height;
+    return t;
+}
+
+GstElement* Mosaic::build(GstBin* bin) {
+    inputs_.clear();
+    compositor_ = gst_element_factory_make("nvcompositor", "mosaic");
+    if (!compositor_) {
+        std::cerr << "[MOSAIC] Missing GStreamer plugin: nvcompositor" << std::endl;
+        return nullptr;
+    }
+
+    // Live aggregation: start at the first buffer, wait at most latency_ms for
+    // a late input, then composite with whatever each pad last delivered.
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(compositor_), "latency")) {
+        g_object_set(G_OBJECT(compositor_),
+            "latency", (guint64)config_->mosaic.latency_ms * GST_MSECOND, NULL);
+    }
+    set_if_exists(compositor_, "start-time-selection", 1);  // GST_AGGREGATOR_START_TIME_SELECTION_FIRST
+
+    gst_bin_add(bin, compositor_);
+
+    GstPad* src = gst_element_get_static_pad(compositor_, "src");
+    if (src) {
+        gst_pad_add_probe(src, GST_PAD_PROBE_TYPE_BUFFER, on_output_buffer, this, NULL);
+        gst_object_unref(src);
+    }
+
+    std::cout << "[MOSAIC] " << input_count() << " inputs → "
+              << config_->encoder.width << "x" << config_->encoder.height
+              << ", late-input timeout " << config_->mosaic.latency_ms << " ms" << std::endl;
+    return compositor_;
+}
+
+bool Mosaic::link_input(GstBin* bin, size_t index, GstElement* tail) {
+    MosaicTile tile = tile_for(index);
+
+    // Per-input VIC scaler so the compositor only blits
+    std::string name = "tile_conv" + std::to_string(index);
+    GstElement* conv = gst_element_factory_make("nvvidconv", name.c_str());
+    if (!conv) return false;
+    gst_bin_add(bin, conv);
+
+    if (!gst_element_link(tail, conv)) {
+        std::cerr << "[MOSAIC] Link failed (decoder→" << name << ")" << std::endl;
+        return false;
+    }
+
+    std::ostringstream ss;
+    ss << "video/x-raw(memory:NVMM),format=RGBA"
+       << ",width=" << tile.width << ",height=" << tile.height;
+    GstCaps* caps = gst_caps_from_string(ss.str().c_str());
+
+#if GST_CHECK_VERSION(1, 20, 0)
+    GstPad* sink = gst_element_request_pad_simple(compositor_, "sink_%u");
+#else
+    GstPad* sink = gst_element_get_request_pad(compositor_, "sink_%u");  // JetPack 5 (GStreamer 1.16)
+#endif
+    GstElement* capsf = gst_element_factory_make("capsfilter", NULL);
+    g_object_set(G_OBJECT(capsf), "caps", caps, NULL);
+    gst_caps_unref(caps);
+    gst_bin_add(bin, capsf);
+
+    GstPad* capsf_src = gst_element_get_static_pad(capsf, "src");
+    bool ok = sink && gst_element_link(conv, capsf) &&
+              gst_pad_link(capsf_src, sink) == GST_PAD_LINK_OK;
+    gst_object_unref(capsf_src);
+    if (!ok) {
+        std::cerr << "[MOSAIC] Link failed (" << name << "→compositor): " << ss.str() << std::endl;
+        if (sink) gst_object_unref(sink);
+        return false;
+    }
+
+    g_object_set(G_OBJECT(sink),
+        "xpos", tile.x, "ypos", tile.y,
+        "width", tile.width, "height", tile.height, NULL);
+    set_if_exists(sink, "repeat-after-eos", TRUE);  // dead camera keeps its last frame
+
+    auto input = std::make_unique<Input>();
+    input->owner = this;
+    input->index = index;
+    gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_BUFFER, on_input_buffer, input.get(), NULL);
+    gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_QUERY_UPSTREAM, on_input_query, input.get(), NULL);
+    inputs_.push_back(std::move(input));
+    gst_object_unref(sink);
+
+    std::cout << "[MOSAIC] Input " << index << " → tile " << tile.width << "x" << tile.height
+              << "+" << tile.x << "+" << tile.y << std::endl;
+    return true;
+}
+
+// ============================================================================
+//  Probes
+// ============================================================================
+
+/// Restamp each input buffer with the running time at arrival.
+GstPadProbeReturn Mosaic::on_input_buffer(GstPad*, GstPadProbeInfo* info, gpointer data) {
+    Input* in = static_cast<Input*>(data);
+    in->arrival_ns.store(now_ns());
+    in->fresh.store(true);
+
+    GstClock* clock = gst_element_get_clock(in->owner->compositor_);
+    if (!clock) return GST_PAD_PROBE_OK;
+    GstClockTime running = gst_clock_get_time(clock) -
+                           gst_element_get_base_time(in->owner->compositor_);
+    gst_object_unref(clock);
+
+    GstBuffer* buf = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    GST_BUFFER_PTS(buf) = running;
+    GST_BUFFER_DTS(buf) = GST_CLOCK_TIME_NONE;
+    GST_PAD_PROBE_INFO_DATA(info) = buf;
+    return GST_PAD_PROBE_OK;
+}
+
+/// Hide upstream (jitterbuffer) latency: buffers are restamped on arrival,
+/// so the only wait the aggregator should add is `mosaic.latency_ms`.
+GstPadProbeReturn Mosaic::on_input_query(GstPad*, GstPadProbeInfo* info, gpointer) {
+    if (!(info->type & GST_PAD_PROBE_TYPE_PULL)) return GST_PAD_PROBE_OK;
+    GstQuery* q = GST_PAD_PROBE_INFO_QUERY(info);
+    if (GST_QUERY_TYPE(q) != GST_QUERY_LATENCY) return GST_PAD_PROBE_OK;
+
+    gboolean live; GstClockTime min, max;
+    gst_query_parse_latency(q, &live, &min, &max);
+    gst_query_set_latency(q, live, 0, max);
+    return GST_PAD_PROBE_OK;
+}
+
+/// Per composited frame: compositing cost, added latency and reused tiles.
+GstPadProbeReturn Mosaic::on_output_buffer(GstPad*, GstPadProbeInfo*, gpointer data) {
+    Mosaic* self = static_cast<Mosaic*>(data);
+    int64_t now = now_ns();
+    int64_t newest = 0, oldest = 0;
+    uint32_t reused = 0;
+
+    for (auto& in : self->inputs_) {
+        if (!in->fresh.exchange(false)) { reused++; continue; }
+        int64_t t = in->arrival_ns.load();
+        if (newest == 0 || t > newest) newest = t;
+        if (oldest == 0 || t < oldest) oldest = t;
+    }
+
+    if (newest > 0) {
+        self->stats_.on_mosaic_frame((now - newest) / 1000, (now - oldest) / 1000,
+                                     static_cast<uint32_t>(self->inputs_.size()), reused);
+    }
+    return GST_PAD_PROBE_OK;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "config.hpp"
+#include "stats.hpp"
+
+#include <gst/gst.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/// Multi-camera mosaic: N decoded sources → nvcompositor → one encoder.
+///
+///   src_i → depay → parse → nvv4l2decoder → nvvidconv (tile size, RGBA)
+///         → nvcompositor sink_i ─┐
+///                                ├→ (encoder chain)
+///   ...                         ─┘
+///
+/// Inputs are synchronised on arrival, not on source timestamps: every
+/// buffer is restamped with the pipeline running time when it reaches the
+/// compositor, and upstream latency is hidden from the aggregator. A slow
+/// or dead camera therefore never stalls the mosaic — the compositor times
+/// out after `mosaic.latency_ms` and reuses that tile's last frame.
+
+class Mosaic {
+public:
+    Mosaic(const ConfigStore& config, Stats& stats);
+
+    Mosaic(const Mosaic&) = delete;
+    Mosaic& operator=(const Mosaic&) = delete;
+
+    /// Number of inputs (rtsp.url + mosaic.sources).
+    size_t input_count() const { return 1 + config_->mosaic.sources.size(); }
+
+    /// URL of input `index`.
+    const std::string& input_url(size_t index) const;
+
+    /// Create the compositor inside `bin`. Returns nullptr if the plugin is missing.
+    /// Output caps: RGBA NVMM at encoder width × height.
+    GstElement* build(GstBin* bin);
+
+    /// Scale input `index` to its tile and attach `tail` (a decoder) to the compositor.
+    bool link_input(GstBin* bin, size_t index, GstElement* tail);
+
+private:
+    struct Input {
+        Mosaic* owner = nullptr;
+        size_t index = 0;
+        std::atomic<int64_t> arrival_ns{0};
+        std::atomic<bool> fresh{false};
+    };
+
+    const ConfigStore& config_;
+    Stats& stats_;
+    GstElement* compositor_ = nullptr;
+    std::vector<std::unique_ptr<Input>> inputs_;
+
+    /// Tile rectangle for input `index` (explicit tiles or grid).
+    MosaicTile tile_for(size_t index) const;
+
+    static GstPadProbeReturn on_input_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    static GstPadProbeReturn on_input_query(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    static GstPadProbeReturn on_output_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+};
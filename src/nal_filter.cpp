@@ -0,0 +1,35 @@
+#include "nal_filter.hpp"
+#include <algorithm>
+
+bool has_nal_units(const AccessUnitInfo& au, uint32_t mask) {
+    for (const NalUnit& n : au.nals) {
+        if (mask & nal_bit(n.type)) return true;
+    }
+    return false;
+}
+
+GstBuffer* strip_nal_units(GstBuffer* buf, const AccessUnitInfo& au, uint32_t mask,
+                           uint64_t removed[32]) {
+    std::fill(removed, removed + 32, 0);
+    GstBuffer* out = gst_buffer_new();
+    gst_buffer_copy_into(out, buf, (GstBufferCopyFlags)(GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS), 0, -1);
+
+    // A NAL unit spans from its start code to the next one, trailing zeros
+    // included; what is left in between still starts with a start code
+    size_t size = gst_buffer_get_size(buf);
+    size_t kept_from = 0;
+    for (size_t i = 0; i < au.nals.size(); i++) {
+        if (!(mask & nal_bit(au.nals[i].type))) continue;
+        size_t begin = au.nals[i].offset - 3;
+        size_t end = i + 1 < au.nals.size() ? au.nals[i + 1].offset - 3 : size;
+        if (begin > kept_from) {
+            gst_buffer_copy_into(out, buf, GST_BUFFER_COPY_MEMORY, kept_from, begin - kept_from);
+        }
+        removed[au.nals[i].type] += end - begin;
+        kept_from = end;
+    }
+    if (kept_from < size) {
+        gst_buffer_copy_into(out, buf, GST_BUFFER_COPY_MEMORY, kept_from, size - kept_from);
+    }
+    return out;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "h264.hpp"
+#include <gst/gst.h>
+#include <cstdint>
+
+/// Drops NAL units from encoded access units on their way to clients.
+///
+/// None of AUD, SEI (buffering period, picture timing, recovery point) or
+/// filler data is needed to decode the slices, and our viewers use none of
+/// them; at 2 Mbps NVENC's CBR filler alone can be a few percent of the
+/// stream (`output.strip_nals`). Unchanged SPS/PPS go the same way (see
+/// ParamSetCache). The kept ranges are shared with the encoder's buffer,
+/// so filtering copies no payload.
+
+/// Bit for one NAL unit type in a filter mask.
+constexpr uint32_t nal_bit(uint8_t type) { return 1u << (type & 0x1F); }
+
+/// Types `output.strip_nals` may name.
+constexpr uint32_t kStrippableNals = nal_bit(NAL_AUD) | nal_bit(NAL_SEI) | nal_bit(NAL_FILLER);
+
+/// Whether `au` has a NAL unit whose type is in `mask`.
+bool has_nal_units(const AccessUnitInfo& au, uint32_t mask);
+
+/// A buffer with `buf`'s flags and timestamps and its memory minus the NAL
+/// units of `au` whose type is in `mask`; `removed[type]` gets the bytes
+/// left out per type (start codes included).
+GstBuffer* strip_nal_units(GstBuffer* buf, const AccessUnitInfo& au, uint32_t mask,
+                           uint64_t removed[32]);
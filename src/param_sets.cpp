@@ -0,0 +1,41 @@
+#include "param_sets.hpp"
+#include <cstring>
+
+ParamSetCache::Result ParamSetCache::update(const uint8_t* data, const AccessUnitInfo& au) {
+    std::vector<std::vector<uint8_t>> sets;
+    for (const NalUnit& n : au.nals) {
+        if (kParamSetNals & nal_bit(n.type)) sets.emplace_back(data + n.offset, data + n.offset + n.size);
+    }
+    if (sets.empty()) return Result::None;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sets == sets_) return Result::Unchanged;
+    sets_ = std::move(sets);
+    return Result::Changed;
+}
+
+std::vector<uint8_t> ParamSetCache::annexb() const {
+    static const uint8_t kStartCode[4] = {0, 0, 0, 1};
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint8_t> out;
+    for (const auto& s : sets_) {
+        out.insert(out.end(), kStartCode, kStartCode + 4);
+        out.insert(out.end(), s.begin(), s.end());
+    }
+    return out;
+}
+
+GstBuffer* prepend_param_sets(GstBuffer* buf, const std::vector<uint8_t>& sets) {
+    GstBuffer* out = gst_buffer_copy(buf);
+    if (sets.empty()) return out;
+    GstMemory* mem = gst_allocator_alloc(nullptr, sets.size(), nullptr);
+    GstMapInfo map;
+    if (!mem || !gst_memory_map(mem, &map, GST_MAP_WRITE)) {
+        if (mem) gst_memory_unref(mem);
+        return out;
+    }
+    memcpy(map.data, sets.data(), sets.size());
+    gst_memory_unmap(mem, &map);
+    gst_buffer_prepend_memory(out, mem);
+    return out;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "nal_filter.hpp"
+#include <gst/gst.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// Current SPS/PPS of the encoded stream, for sending them out of band.
+///
+/// The encoder repeats its parameter sets in front of every IDR. With
+/// `output.param_sets: on_join` they are cached here from the IDR that
+/// first carries them and stripped from later IDRs for as long as they stay
+/// the same (strip_nal_units); a client gets them once, in front of the first IDR its feeder
+/// sends, where the payloader also takes them for the SDP's
+/// sprop-parameter-sets. Parameter sets that differ from the cached ones
+/// (new resolution, encoder rebuilt) go out in-band once and replace them.
+
+/// Parameter-set NAL unit types.
+constexpr uint32_t kParamSetNals = nal_bit(NAL_SPS) | nal_bit(NAL_PPS);
+
+class ParamSetCache {
+public:
+    enum class Result {
+        None,        // the access unit carries no parameter sets
+        Unchanged,   // all of them already cached: may be stripped
+        Changed,     // new or different: now cached, keep them in-band
+    };
+
+    /// Streaming thread, per access unit `data` scanned into `au`.
+    Result update(const uint8_t* data, const AccessUnitInfo& au);
+
+    /// Cached parameter sets as Annex-B (4-byte start codes) in stream
+    /// order; empty until an IDR carrying them was seen. Any thread.
+    std::vector<uint8_t> annexb() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::vector<uint8_t>> sets_;   // NAL units, no start codes
+};
+
+/// A copy of `buf` with `sets` (Annex-B) in a new memory in front.
+GstBuffer* prepend_param_sets(GstBuffer* buf, const std::vector<uint8_t>& sets);
@@ -0,0 +1,171 @@
+#include "parse_bench.hpp"
+#include "h264.hpp"
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+static constexpr int kParserRuns = 3;            // best of, to shed scheduling noise
+static constexpr int64_t kMinScanNs = 1000000000LL;
+static constexpr GstClockTime kFrameDuration = GST_SECOND / 30;
+
+namespace {
+
+struct Span {
+    size_t offset;
+    size_t size;
+};
+
+int64_t clock_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/// Start of the start code (3 or 4 bytes) in front of a NAL.
+size_t start_code_of(const uint8_t* data, const NalUnit& n) {
+    size_t at = n.offset - 3;
+    return (at > 0 && data[at - 1] == 0) ? at - 1 : at;
+}
+
+/// Access unit boundaries (H.264 7.4.1.2.3): an AUD, SPS, PPS or SEI after
+/// a slice, or a slice starting at macroblock 0, opens a new AU.
+std::vector<Span> split_access_units(const std::vector<uint8_t>& file) {
+    std::vector<Span> aus;
+    const uint8_t* data = file.data();
+    size_t au_start = 0;
+    bool have_slice = false;
+    for (const NalUnit& n : h264_split_nals(data, file.size())) {
+        bool slice = n.type == NAL_SLICE || n.type == NAL_IDR;
+        bool first_mb_zero = slice && n.size > 1 && (data[n.offset + 1] & 0x80);
+        bool opens = have_slice &&
+            (n.type == NAL_AUD || n.type == NAL_SPS || n.type == NAL_PPS || n.type == NAL_SEI || first_mb_zero);
+        if (opens) {
+            size_t at = start_code_of(data, n);
+            aus.push_back({au_start, at - au_start});
+            au_start = at;
+            have_slice = false;
+        }
+        if (slice) have_slice = true;
+    }
+    if (have_slice) aus.push_back({au_start, file.size() - au_start});
+    return aus;
+}
+
+/// Process CPU time to push every AU through appsrc → [h264parse] → fakesink.
+int64_t run_pipeline(const std::vector<uint8_t>& file, const std::vector<Span>& aus, bool with_parser) {
+    GstElement* pipeline = gst_pipeline_new("bench");
+    GstElement* src  = gst_element_factory_make("appsrc", "src");
+    GstElement* parse = with_parser ? gst_element_factory_make("h264parse", "parse") : nullptr;
+    GstElement* sink = gst_element_factory_make("fakesink", "sink");
+    if (!pipeline || !src || !sink || (with_parser && !parse)) {
+        std::cerr << "[BENCH] Missing appsrc/h264parse/fakesink" << std::endl;
+        for (GstElement* e : {pipeline, src, parse, sink}) if (e) gst_object_unref(e);
+        return -1;
+    }
+
+    GstCaps* caps = gst_caps_from_string("video/x-h264,stream-format=byte-stream,alignment=au");
+    g_object_set(G_OBJECT(src), "caps", caps, "format", GST_FORMAT_TIME,
+                 "block", TRUE, "max-bytes", (guint64)(4 * 1024 * 1024), NULL);
+    gst_caps_unref(caps);
+    g_object_set(G_OBJECT(sink), "sync", FALSE, NULL);
+    if (parse) g_object_set(G_OBJECT(parse), "config-interval", -1, NULL);
+
+    bool linked;
+    if (parse) {
+        gst_bin_add_many(GST_BIN(pipeline), src, parse, sink, NULL);
+        linked = gst_element_link_many(src, parse, sink, NULL);
+    } else {
+        gst_bin_add_many(GST_BIN(pipeline), src, sink, NULL);
+        linked = gst_element_link(src, sink);
+    }
+    if (!linked || gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        std::cerr << "[BENCH] Cannot start the bench pipeline" << std::endl;
+        gst_object_unref(pipeline);
+        return -1;
+    }
+
+    int64_t t0 = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    for (size_t i = 0; i < aus.size(); i++) {
+        // Wrapped read-only: the parser copies when it inserts SPS/PPS
+        GstBuffer* buf = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+            const_cast<uint8_t*>(file.data()) + aus[i].offset, aus[i].size, 0, aus[i].size, nullptr, nullptr);
+        GST_BUFFER_PTS(buf) = GST_BUFFER_DTS(buf) = i * kFrameDuration;
+        GST_BUFFER_DURATION(buf) = kFrameDuration;
+        if (gst_app_src_push_buffer(GST_APP_SRC(src), buf) != GST_FLOW_OK) break;
+    }
+    gst_app_src_end_of_stream(GST_APP_SRC(src));
+
+    GstBus* bus = gst_element_get_bus(pipeline);
+    GstMessage* msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+        (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    int64_t cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - t0;
+    bool ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    if (msg) gst_message_unref(msg);
+    gst_object_unref(bus);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    if (!ok) std::cerr << "[BENCH] Bench pipeline failed" << std::endl;
+    return ok ? cpu : -1;
+}
+
+}  // namespace
+
+int run_parse_bench(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    std::vector<Span> aus = split_access_units(file);
+    if (aus.empty()) {
+        std::cerr << "[BENCH] No H.264 access units in " << path << std::endl;
+        return 1;
+    }
+
+    // In-house scan: repeat until a second of samples
+    AccessUnitInfo info;
+    int64_t scan_total = 0, scan_max = 0;
+    uint64_t scans = 0, nals = 0;
+    while (scan_total < kMinScanNs) {
+        for (const Span& au : aus) {
+            int64_t t = clock_ns(CLOCK_MONOTONIC);
+            h264_scan_access_unit(file.data() + au.offset, au.size, info);
+            int64_t ns = clock_ns(CLOCK_MONOTONIC) - t;
+            scan_total += ns;
+            scan_max = std::max(scan_max, ns);
+            nals += info.nals.size();
+            scans++;
+        }
+    }
+
+    // h264parse: best of N, less the same pipeline without it
+    int64_t with = -1, without = -1;
+    for (int i = 0; i < kParserRuns; i++) {
+        int64_t a = run_pipeline(file, aus, true);
+        int64_t b = run_pipeline(file, aus, false);
+        if (a < 0 || b < 0) return 1;
+        with = with < 0 ? a : std::min(with, a);
+        without = without < 0 ? b : std::min(without, b);
+    }
+    double parse_us = std::max<int64_t>(0, with - without) / 1000.0 / aus.size();
+    double scan_us = scan_total / 1000.0 / scans;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[BENCH] " << path << ": " << aus.size() << " access units, "
+              << (double)nals / scans << " NALs/AU, " << file.size() / aus.size() << " bytes/AU" << std::endl;
+    std::cout << "[BENCH] h264parse:  " << parse_us << " us/frame per instance" << std::endl;
+    std::cout << "[BENCH]   before:   parse_out + parse0 per client = "
+              << parse_us * 2 << " / " << parse_us * 3 << " / " << parse_us * 5
+              << " us/frame at 1 / 2 / 4 clients" << std::endl;
+    std::cout << "[BENCH] AU scan:    " << scan_us << " us/frame (max " << scan_max / 1000.0
+              << " us), once per frame at any client count" << std::endl;
+    if (scan_us > 0) {
+        std::cout << "[BENCH] speedup:    " << std::setprecision(1) << parse_us * 2 / scan_us
+                  << "x at 1 client" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+/// `--bench-parse FILE`: per-frame parse cost of the output path on an
+/// Annex-B H.264 recording, before and after the in-house scan.
+///
+/// Before, every frame went through h264parse at the encoder output and
+/// again in each client's media (config-interval=-1 on both). This times
+/// one h264parse instance (appsrc → h264parse → fakesink, less the same
+/// pipeline without the parser) in process CPU time, and times
+/// h264_scan_access_unit over the same access units. Needs gst_init.
+int run_parse_bench(const std::string& path);
@@ -1,10 +1,100 @@
 #include "pipeline.hpp"
+#include "au_meta.hpp"
+#include "thread_roles.hpp"
+#include "upgrade.hpp"
+#include <glib-unix.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <ctime>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 
+/// Converter-in entries older than this never came out of the encoder.
+static constexpr int64_t kTransitLostNs = 1000000000LL;
+static constexpr size_t kTransitMaxPending = 120;
+
+static int64_t monotonic_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Buffer-count properties differ between L4T releases; skip what's absent.
+static void set_if_exists(gpointer obj, const char* name, int value) {
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(obj), name)) {
+        g_object_set(obj, name, value, NULL);
+    }
+}
+
+/// Stage queue fill, sampled as each buffer leaves the queue.
+struct StageQueueMeter {
+    Stats* stats;
+    QueueBoundary boundary;
+};
+
+static GstPadProbeReturn on_stage_queue_output(GstPad* pad, GstPadProbeInfo*, gpointer data) {
+    StageQueueMeter* meter = static_cast<StageQueueMeter*>(data);
+    GstElement* queue = gst_pad_get_parent_element(pad);
+    if (!queue) return GST_PAD_PROBE_OK;
+    guint level = 0, capacity = 0;
+    g_object_get(queue, "current-level-buffers", &level, "max-size-buffers", &capacity, NULL);
+    gst_object_unref(queue);
+    meter->stats->on_queue_level(meter->boundary, level, capacity);
+    return GST_PAD_PROBE_OK;
+}
+
+static void on_stage_queue_overrun(GstElement*, gpointer data) {
+    StageQueueMeter* meter = static_cast<StageQueueMeter*>(data);
+    meter->stats->on_queue_full(meter->boundary);
+}
+
+/// A metered `queue` for one stage boundary, or nullptr when it is off.
+static GstElement* make_stage_queue(const QueueConfig& qc, QueueBoundary boundary,
+                                    const std::string& name, Stats& stats) {
+    if (!qc.enabled) return nullptr;
+    GstElement* q = gst_element_factory_make("queue", name.c_str());
+    if (!q) return nullptr;
+    g_object_set(G_OBJECT(q),
+        "max-size-buffers", (guint)qc.max_buffers,
+        "max-size-bytes",   (guint)0,
+        "max-size-time",    (guint64)qc.max_time_ms * GST_MSECOND,
+        NULL);
+    gst_util_set_object_arg(G_OBJECT(q), "leaky", qc.leaky.c_str());
+
+    StageQueueMeter* meter = new StageQueueMeter{&stats, boundary};
+    g_object_set_data_full(G_OBJECT(q), "stage-queue-meter", meter,
+        [](gpointer p) { delete static_cast<StageQueueMeter*>(p); });
+    g_signal_connect(q, "overrun", G_CALLBACK(on_stage_queue_overrun), meter);
+    GstPad* src = gst_element_get_static_pad(q, "src");
+    gst_pad_add_probe(src, GST_PAD_PROBE_TYPE_BUFFER, on_stage_queue_output, meter, NULL);
+    gst_object_unref(src);
+    return q;
+}
+
+/// A named capsfilter, so a renegotiation can find it again by name (the
+/// one gst_element_link_filtered() makes is anonymous, and with a stage
+/// queue in between it is not the next element's peer either).
+static GstElement* make_capsfilter(const char* name, const std::string& caps_str) {
+    GstElement* f = gst_element_factory_make("capsfilter", name);
+    if (!f) return nullptr;
+    GstCaps* caps = gst_caps_from_string(caps_str.c_str());
+    g_object_set(G_OBJECT(f), "caps", caps, NULL);
+    gst_caps_unref(caps);
+    return f;
+}
+
+/// a → [queue] → b; `caps` (optional) constrains the a side.
+static bool link_via_queue(GstElement* a, GstElement* queue, GstElement* b, GstCaps* caps) {
+    if (!queue) return gst_element_link_filtered(a, b, caps);
+    return gst_element_link_filtered(a, queue, caps) && gst_element_link(queue, b);
+}
+
 // ============================================================================
 //  Custom RTSP Media Factory
 // ============================================================================
@@ -24,11 +114,12 @@ static void encoder_factory_init(EncoderFactory*) {}
 GstRTSPMediaFactory* encoder_factory_new(Pipeline* pipeline) {
     EncoderFactory* f = (EncoderFactory*)g_object_new(TYPE_ENCODER_FACTORY, NULL);
     f->pipeline = pipeline;
-    gst_rtsp_media_factory_set_shared(GST_RTSP_MEDIA_FACTORY(f), TRUE);
     return GST_RTSP_MEDIA_FACTORY(f);
 }
 
-/// Called when go2rtc/client connects: appsrc → h264parse → rtph264pay(pay0)
+/// Called when go2rtc/client connects: appsrc → rtph264pay(pay0). Access
+/// units arrive whole, so the payloader needs no parser; the client's first
+/// one is an IDR with SPS/PPS in front (see ParamSetCache).
 static GstElement* encoder_factory_create_element(GstRTSPMediaFactory* factory,
                                                     const GstRTSPUrl*) {
     EncoderFactory* self = ENCODER_FACTORY(factory);
@@ -38,28 +129,34 @@ static GstElement* encoder_factory_create_element(GstRTSPMediaFactory* factory,
 
     GstElement* bin      = gst_bin_new("serve-bin");
     GstElement* appsrc   = gst_element_factory_make("appsrc",      "appsrc0");
-    GstElement* parse    = gst_element_factory_make("h264parse",   "parse0");
     GstElement* pay      = gst_element_factory_make("rtph264pay",  "pay0");
 
-    if (!appsrc || !parse || !pay) {
+    if (!appsrc || !pay) {
         std::cerr << "[SERVER] Failed to create elements" << std::endl;
         gst_object_unref(bin);
         return nullptr;
     }
 
-    // Configure appsrc with H.264 caps
-    GstCaps* caps = gst_caps_from_string("video/x-h264,stream-format=byte-stream,alignment=au");
+    // Buffers keep the output timeline's PTS (continuous across encoder
+    // restarts, see splice_sample), not their arrival time.
+    // Negotiated encoder caps (size, rate, profile), complete enough for the
+    // payloader; the generic ones only until the first access unit
+    GstCaps* caps = gst_caps_from_string(pipeline->has_caps()
+        ? pipeline->get_caps_string().c_str()
+        : "video/x-h264,stream-format=byte-stream,alignment=au");
     g_object_set(G_OBJECT(appsrc),
-        "is-live", TRUE, "format", GST_FORMAT_TIME, "do-timestamp", TRUE,
+        "is-live", TRUE, "format", GST_FORMAT_TIME, "do-timestamp", FALSE,
         "block", FALSE, "max-bytes", (guint64)(2 * 1024 * 1024),
         "caps", caps, NULL);
     gst_caps_unref(caps);
 
-    g_object_set(G_OBJECT(parse), "config-interval", -1, NULL);
-    g_object_set(G_OBJECT(pay),   "config-interval", -1, "pt", 96, NULL);
+    // on_join: the payloader takes SPS/PPS (and sprop-parameter-sets) from
+    // the first IDR and sends them again only when they reappear in-band
+    bool on_join = pipeline->config()->output.param_sets == "on_join";
+    g_object_set(G_OBJECT(pay), "config-interval", on_join ? 0 : -1, "pt", 96, NULL);
 
-    gst_bin_add_many(GST_BIN(bin), appsrc, parse, pay, NULL);
-    if (!gst_element_link_many(appsrc, parse, pay, NULL)) {
+    gst_bin_add_many(GST_BIN(bin), appsrc, pay, NULL);
+    if (!gst_element_link(appsrc, pay)) {
         std::cerr << "[SERVER] Link failed" << std::endl;
         gst_object_unref(bin);
         return nullptr;
@@ -67,26 +164,58 @@ static GstElement* encoder_factory_create_element(GstRTSPMediaFactory* factory,
 
     // GstRTSPServer finds "pay0" automatically — no manual ghost pad
 
-    // Feeder thread: pull H.264 from encoder appsink → push to this appsrc
+    // Feeder thread: this media's fan-out subscriber → appsrc
+    auto sub = pipeline->subscribe();
+    g_object_set_data_full(G_OBJECT(bin), "fanout-subscriber",
+        new std::shared_ptr<FanOutSubscriber>(sub),
+        [](gpointer p) { delete static_cast<std::shared_ptr<FanOutSubscriber>*>(p); });
+
     gst_object_ref(appsrc);
-    std::thread([pipeline, appsrc]() {
-        std::cout << "[SERVER] Feeder started" << std::endl;
+    std::thread([pipeline, appsrc, sub]() {
+        thread_role_enter(ThreadRole::Serving);
+        std::cout << "[SERVER] Feeder #" << sub->id() << " started" << std::endl;
+        int layer = sub->max_layer();
+        bool joined = false;
+        GstCaps* caps = nullptr;   // last set on appsrc
         while (pipeline->is_running()) {
-            GstSample* sample = pipeline->pull_latest_sample();
-            if (sample) {
-                GstBuffer* buf = gst_sample_get_buffer(sample);
-                if (buf) {
-                    GstBuffer* copy = gst_buffer_copy(buf);
-                    GstFlowReturn ret = gst_app_src_push_buffer(GST_APP_SRC(appsrc), copy);
-                    if (ret != GST_FLOW_OK) { gst_sample_unref(sample); break; }
-                }
+            GstSample* sample = sub->pop(100);
+            if (!sample) continue;
+            GstBuffer* buf = gst_sample_get_buffer(sample);
+            // Nothing before the first IDR is decodable; the media prerolls
+            // on it, so the SDP is built from its parameter sets
+            if (buf && !joined && GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
                 gst_sample_unref(sample);
-            } else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                continue;
+            }
+            // Renegotiated: serialized ahead of the buffer that carries the new format
+            GstCaps* sample_caps = gst_sample_get_caps(sample);
+            if (buf && sample_caps && sample_caps != caps) {
+                if (!caps || !gst_caps_is_equal(sample_caps, caps)) {
+                    gst_app_src_set_caps(GST_APP_SRC(appsrc), sample_caps);
+                }
+                gst_caps_replace(&caps, sample_caps);
+            }
+            if (buf) {
+                GstBuffer* copy = joined ? gst_buffer_copy(buf) : pipeline->join_buffer(buf);
+                joined = true;
+                GstFlowReturn ret = gst_app_src_push_buffer(GST_APP_SRC(appsrc), copy);
+                if (ret != GST_FLOW_OK) { gst_sample_unref(sample); break; }
+                if (pipeline->startup()) pipeline->startup()->on_first_served();
+            }
+            gst_sample_unref(sample);
+
+            sub->on_backlog(gst_app_src_get_current_level_bytes(GST_APP_SRC(appsrc)));
+            if (sub->max_layer() != layer) {
+                layer = sub->max_layer();
+                std::cout << "[SVC] Client #" << sub->id() << " → layers T0-T" << layer << std::endl;
             }
         }
-        std::cout << "[SERVER] Feeder stopped" << std::endl;
+        if (caps) gst_caps_unref(caps);
+        pipeline->unsubscribe(sub);
+        std::cout << "[SERVER] Feeder #" << sub->id() << " stopped (thinned "
+                  << sub->thinned() << ", dropped " << sub->dropped() << ")" << std::endl;
         gst_object_unref(appsrc);
+        thread_role_leave();
     }).detach();
 
     return bin;
@@ -96,143 +225,405 @@ static GstElement* encoder_factory_create_element(GstRTSPMediaFactory* factory,
 //  Pipeline
 // ============================================================================
 
-Pipeline::Pipeline(const AppConfig& config, Stats& stats)
-    : config_(config), stats_(stats) {
-    reconnect_delay_s_ = config_.rtsp.reconnect_delay_s;
+Pipeline::Pipeline(const AppConfig& config, Stats& stats, StartupTrace* startup)
+    : config_(config), stats_(stats), startup_(startup), mosaic_(config_, stats), denoiser_(config_, stats),
+      gop_(config_), fanout_(config_), admission_(config_, stats), stall_(config_, stats),
+      thermal_(config_, stats) {
+    reconnect_delay_s_ = config_->rtsp.reconnect_delay_s;
 }
 
-Pipeline::~Pipeline() { stop(); }
+Pipeline::~Pipeline() {
+    stop();
+    if (ring_caps_) gst_caps_unref(ring_caps_);
+    if (out_caps_) gst_caps_unref(out_caps_);
+}
 
-// Frame count probe
-static GstPadProbeReturn frame_probe(GstPad*, GstPadProbeInfo*, gpointer data) {
-    static_cast<Stats*>(data)->on_frame_encoded();
+void Pipeline::run_as_worker(std::unique_ptr<ShmRing> ring) {
+    role_ = PipelineRole::Worker;
+    ring_ = std::move(ring);
+}
+
+void Pipeline::run_as_server(const std::string& config_path) {
+    role_ = PipelineRole::Server;
+    worker_ = std::make_unique<WorkerProcess>(config_, stats_, config_path);
+}
+
+// The one scan of each encoded AU (attached as AuMeta), frame count/size, adaptive GOP clock, recovery meter (+ slice QP while the denoiser is configured, for its on/off comparison)
+GstPadProbeReturn Pipeline::on_encoded_buffer(GstPad*, GstPadProbeInfo* info, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    GstBuffer* buf = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    GST_PAD_PROBE_INFO_DATA(info) = buf;
+
+    const AccessUnitInfo* au = nullptr;
+    GstMapInfo map;
+    if (gst_buffer_map(buf, &map, GST_MAP_READ)) {
+        int64_t t0 = monotonic_ns();
+        AccessUnitInfo scan;
+        h264_scan_access_unit(map.data, map.size, scan);
+        self->stats_.on_au_scan(monotonic_ns() - t0, scan.nals.size());
+        au = buffer_add_au_info(buf, std::move(scan));
+        if (au && au->keyframe) GST_BUFFER_FLAG_UNSET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+        else if (au) GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+        if (au && self->config_->output.filler_headroom) {
+            uint64_t filler = 0;
+            for (const NalUnit& n : au->nals) {
+                if (n.type == NAL_FILLER) filler += n.size + 3;
+            }
+            self->wire_bytes_.fetch_add(map.size - std::min<uint64_t>(filler, map.size),
+                                        std::memory_order_relaxed);
+        }
+        if (au && self->config_->denoise.enabled) {
+            int qp = self->slice_parser_.parse_access_unit(map.data, au->nals);
+            if (qp >= 0) self->stats_.on_frame_qp(qp, self->denoiser_.active());
+        }
+        gst_buffer_unmap(buf, &map);
+    }
+    bool keyframe = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    self->stats_.on_frame_encoded(gst_buffer_get_size(buf), keyframe);
+    self->stall_.on_frame();
+    self->match_transit(GST_BUFFER_PTS(buf));
+    int64_t woke_ns = self->resume_started_ns_.load();
+    if (woke_ns && self->resume_started_ns_.exchange(0)) {
+        int64_t ms = (monotonic_ns() - woke_ns) / 1000000;
+        bool torn_down = self->resume_from_teardown_.load();
+        self->stats_.on_idle_resume(ms, torn_down);
+        std::cout << "[IDLE] Resumed from " << (torn_down ? "teardown" : "pause") << ": first frame "
+                  << ms << " ms after wake-up" << std::endl;
+    }
+    if (self->awaiting_first_frame_.load() && self->awaiting_first_frame_.exchange(false)) {
+        self->restart_first_frame_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    // Worker: IDR decisions are made by the server, which sees the clients
+    if (self->ring_ && self->ring_->take_idr_requests() > 0) self->encoder_.force_idr();
+
+    if (self->config_->gop.adaptive && self->role_ != PipelineRole::Worker) {
+        if (self->gop_.on_frame(keyframe)) self->encoder_.force_idr();
+        if (keyframe) {
+            int64_t ms = self->gop_.take_pli_to_idr_ms();
+            if (ms >= 0) self->stats_.on_pli_answered(ms);
+        }
+    }
+
+    RecoveryMeter::Result rec;
+    if (self->recovery_.on_frame(gst_buffer_get_size(buf), keyframe, rec)) {
+        self->stats_.on_recovery(recovery_mode_name(self->recovery_mode_),
+                                 rec.duration_ms, rec.excess_bytes, rec.peak_ratio);
+    }
     return GST_PAD_PROBE_OK;
 }
 
+// Stamp each decoded frame as it enters the converter; the thermal
+// governor's fps step drops all but one in `frame_divisor_` here, and
+// nothing passes while Idle (a mosaic's compositor keeps producing frames)
+GstPadProbeReturn Pipeline::on_converter_buffer(GstPad*, GstPadProbeInfo* info, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    if (self->encode_paused_.load(std::memory_order_relaxed)) return GST_PAD_PROBE_DROP;
+    int divisor = self->frame_divisor_.load(std::memory_order_relaxed);
+    if (divisor > 1 && self->converted_frames_++ % divisor != 0) return GST_PAD_PROBE_DROP;
+    GstClockTime pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+    if (!GST_CLOCK_TIME_IS_VALID(pts)) return GST_PAD_PROBE_OK;
+    std::lock_guard<std::mutex> lock(self->transit_mutex_);
+    if (self->transit_.size() >= kTransitMaxPending) self->transit_.pop_front();
+    self->transit_.emplace_back(pts, monotonic_ns());
+    return GST_PAD_PROBE_OK;
+}
+
+// Encoded frames keep the converter-in PTS (B-frames reorder, so search)
+void Pipeline::match_transit(GstClockTime pts) {
+    int64_t now = monotonic_ns();
+    uint64_t lost = 0;
+    int64_t transit_ns = -1;
+    {
+        std::lock_guard<std::mutex> lock(transit_mutex_);
+        for (auto it = transit_.begin(); it != transit_.end();) {
+            if (it->first == pts) {
+                transit_ns = now - it->second;
+                it = transit_.erase(it);
+            } else if (now - it->second > kTransitLostNs) {
+                lost++;
+                it = transit_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (transit_ns >= 0) stats_.on_transit(transit_ns / 1000);
+    if (lost) stats_.on_frames_lost(lost);
+}
+
+/// rtspsrc → rtph264depay → h264parse → nvv4l2decoder, added to enc_pipeline_.
+/// Returns the decoder (chain tail) or nullptr on failure.
+/// Raw NV12 caps at the encoder resolution (NVMM for the encoder input,
+/// system memory for the denoise stage).
+static std::string nv12_caps_string(bool nvmm, int width, int height) {
+    std::ostringstream ss;
+    ss << (nvmm ? "video/x-raw(memory:NVMM),format=NV12" : "video/x-raw,format=NV12")
+       << ",width=" << width << ",height=" << height;
+    return ss.str();
+}
+
+GstElement* Pipeline::make_source(const std::string& url, const std::string& suffix) {
+    GstElement* src = gst_element_factory_make("rtspsrc", ("src" + suffix).c_str());
+    if (!src) return nullptr;
+    g_object_set(G_OBJECT(src),
+        "location",        url.c_str(),
+        "protocols",       (config_->rtsp.transport == "tcp") ? 4 : 1,
+        "latency",         (guint)config_->rtsp.latency_ms,
+        "tcp-timeout",     (guint64)5000000,
+        "retry",           (guint)5,
+        "do-retransmission", FALSE,
+        "drop-on-latency", TRUE,
+        "ntp-sync",        FALSE,
+        NULL);
+    return src;
+}
+
+GstElement* Pipeline::add_source_chain(const std::string& url, const std::string& suffix) {
+    GstElement* src      = make_source(url, suffix);
+    GstElement* depay    = gst_element_factory_make("rtph264depay",  ("depay" + suffix).c_str());
+    GstElement* parse_in = gst_element_factory_make("h264parse",     ("parse_in" + suffix).c_str());
+    GstElement* decoder  = gst_element_factory_make("nvv4l2decoder", ("decoder" + suffix).c_str());
+
+    if (!src || !depay || !parse_in || !decoder) {
+        std::cerr << "[ENC] Missing GStreamer plugins!" << std::endl;
+        if (!src)     std::cerr << "  - rtspsrc" << std::endl;
+        if (!decoder) std::cerr << "  - nvv4l2decoder" << std::endl;
+        for (GstElement* e : {src, depay, parse_in, decoder}) if (e) gst_object_unref(e);
+        return nullptr;
+    }
+
+    // Decoder: capture surfaces beyond the DPB minimum (memory.decoder_extra_surfaces)
+    g_object_set(G_OBJECT(decoder), "enable-max-performance", TRUE, NULL);
+    set_if_exists(decoder, "num-extra-surfaces", config_->memory.decoder_extra_surfaces);
+
+    // Input parse: inline SPS/PPS (an IDR replayed by the decode gate carries its own)
+    g_object_set(G_OBJECT(parse_in), "config-interval", -1, NULL);
+
+    gst_bin_add_many(GST_BIN(enc_pipeline_), src, depay, parse_in, decoder, NULL);
+
+    // Optional thread boundary: decode runs apart from depay/parse and the jitterbuffer
+    GstElement* q_decode = make_stage_queue(config_->queues.decode, QueueBoundary::Decode,
+                                            "q_decode" + suffix, stats_);
+    if (q_decode) gst_bin_add(GST_BIN(enc_pipeline_), q_decode);
+
+    if (!gst_element_link(depay, parse_in) ||
+        !link_via_queue(parse_in, q_decode, decoder, nullptr)) {
+        std::cerr << "[ENC] Link failed (depay→decoder" << suffix << ")" << std::endl;
+        return nullptr;
+    }
+
+    // Decode gate: parser → decoder, open until the pipeline goes idle
+    auto gate = std::make_shared<DecodeGate>((size_t)config_->idle.source_gop_frames);
+    GstPad* parse_src = gst_element_get_static_pad(parse_in, "src");
+    DecodeGate::attach(parse_src, gate);
+    gst_object_unref(parse_src);
+    gates_.push_back(gate);
+
+    // Dynamic pad for rtspsrc → depay
+    g_signal_connect(src, "pad-added", G_CALLBACK(Pipeline::on_pad_added), depay);
+    return decoder;
+}
+
 bool Pipeline::build_encoder_pipeline() {
     std::lock_guard<std::mutex> lock(mutex_);
+    gates_.clear();
 
     enc_pipeline_ = gst_pipeline_new("encoder");
     if (!enc_pipeline_) return false;
 
-    // Create all elements
-    GstElement* src      = gst_element_factory_make("rtspsrc",       "src");
-    GstElement* depay    = gst_element_factory_make("rtph264depay",  "depay");
-    GstElement* parse_in = gst_element_factory_make("h264parse",     "parse_in");
-    GstElement* decoder  = gst_element_factory_make("nvv4l2decoder", "decoder");
+    // Encoder-side elements
     GstElement* conv     = gst_element_factory_make("nvvidconv",     "conv");
     GstElement* enc      = gst_element_factory_make("nvv4l2h264enc", "enc");
-    GstElement* parse_out= gst_element_factory_make("h264parse",     "parse_out");
     GstElement* sink     = gst_element_factory_make("appsink",       "enc_sink");
 
-    if (!src || !depay || !parse_in || !decoder || !conv || !enc || !parse_out || !sink) {
+    if (!conv || !enc || !sink) {
         std::cerr << "[ENC] Missing GStreamer plugins!" << std::endl;
-        if (!src)     std::cerr << "  - rtspsrc" << std::endl;
-        if (!decoder) std::cerr << "  - nvv4l2decoder" << std::endl;
         if (!conv)    std::cerr << "  - nvvidconv" << std::endl;
         if (!enc)     std::cerr << "  - nvv4l2h264enc" << std::endl;
+        for (GstElement* e : {conv, enc, sink}) if (e) gst_object_unref(e);
         gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
         return false;
     }
 
-    // Configure rtspsrc
-    g_object_set(G_OBJECT(src),
-        "location",        config_.rtsp.url.c_str(),
-        "protocols",       (config_.rtsp.transport == "tcp") ? 4 : 1,
-        "latency",         (guint)config_.rtsp.latency_ms,
-        "tcp-timeout",     (guint64)5000000,
-        "retry",           (guint)5,
-        "do-retransmission", FALSE,
-        "drop-on-latency", TRUE,
-        "ntp-sync",        FALSE,
-        NULL);
-
-    // Decoder
-    g_object_set(G_OBJECT(decoder), "enable-max-performance", TRUE, NULL);
-
-    // Input parse: inline SPS/PPS
-    g_object_set(G_OBJECT(parse_in), "config-interval", -1, NULL);
-
-    // Encoder (NVENC)
+    // Encoder (NVENC). With the adaptive GOP the encoder's own IDR cadence is
+    // only a safety net well beyond the controller's ceiling.
+    uint32_t divisor = frame_divisor_.load();   // see apply_bitrate()
     encoder_.configure(enc,
-                       config_.encoder.target_bitrate_kbps,
-                       config_.encoder.max_bitrate_kbps,
-                       config_.encoder.idr_interval,
-                       config_.encoder.preset,
-                       config_.encoder.profile,
-                       config_.encoder.control_rate);
+                       config_->encoder.target_bitrate_kbps * divisor,
+                       config_->encoder.max_bitrate_kbps * divisor,
+                       config_->gop.adaptive ? config_->gop.max_frames * 2 : config_->encoder.idr_interval,
+                       faster_preset(config_->encoder.preset, quality_.preset_steps),
+                       config_->encoder.profile,
+                       config_->encoder.control_rate);
+
+    // Loss recovery: intra refresh where the encoder supports it
+    recovery_mode_ = RecoveryMode::Idr;
+    if (config_->recovery.mode != "idr") {
+        if (encoder_.set_intra_refresh(config_->recovery.refresh_frames)) {
+            recovery_mode_ = RecoveryMode::IntraRefresh;
+        } else if (config_->recovery.mode == "intra_refresh") {
+            std::cerr << "[ENC] Encoder has no intra refresh control, recovering with IDRs" << std::endl;
+        }
+    }
+    recovery_.configure(recovery_mode_, config_->recovery.refresh_frames);
+
+    // Temporal layers: non-reference B-frames the fan-out can drop per client
+    int layers = 1;
+    if (config_->svc.temporal_layers > 1) {
+        if (encoder_.set_b_frames(svc_b_frames(config_->svc.temporal_layers))) {
+            layers = config_->svc.temporal_layers;
+        } else {
+            std::cerr << "[ENC] Encoder has no B-frame control, temporal layering off" << std::endl;
+        }
+    }
+    layer_tagger_ = TemporalLayerTagger(layers);
+    admission_.reset_layer_share();
+    gop_.set_refresh_recovery(recovery_mode_ == RecoveryMode::IntraRefresh);
 
-    // Output parse: inject SPS/PPS with every IDR
-    g_object_set(G_OBJECT(parse_out), "config-interval", -1, NULL);
+    // Converter output pool (memory.converter_buffers)
+    set_if_exists(conv, "output-buffers", config_->memory.converter_buffers);
 
     // Appsink
     GstCaps* sink_caps = gst_caps_from_string("video/x-h264,stream-format=byte-stream,alignment=au");
     g_object_set(G_OBJECT(sink),
         "emit-signals", FALSE, "sync", FALSE,
-        "max-buffers", (guint)3, "drop", TRUE,
+        "max-buffers", (guint)config_->memory.appsink_buffers, "drop", TRUE,
         "caps", sink_caps, NULL);
     gst_caps_unref(sink_caps);
     appsink_ = sink;
+    GstAppSinkCallbacks callbacks{};
+    callbacks.new_sample = Pipeline::on_new_sample;
+    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, this, NULL);
 
     // Add all to pipeline
-    gst_bin_add_many(GST_BIN(enc_pipeline_),
-        src, depay, parse_in, decoder, conv, enc, parse_out, sink, NULL);
+    gst_bin_add_many(GST_BIN(enc_pipeline_), conv, enc, sink, NULL);
+
+    // Optional thread boundaries between the stages (queues.*)
+    GstElement* q_convert = make_stage_queue(config_->queues.convert, QueueBoundary::Convert, "q_convert", stats_);
+    GstElement* q_encode  = make_stage_queue(config_->queues.encode,  QueueBoundary::Encode,  "q_encode",  stats_);
+    GstElement* q_output  = make_stage_queue(config_->queues.output,  QueueBoundary::Output,  "q_output",  stats_);
+    for (GstElement* q : {q_convert, q_encode, q_output}) {
+        if (q) gst_bin_add(GST_BIN(enc_pipeline_), q);
+    }
 
-    // Link static elements
-    if (!gst_element_link(depay, parse_in) ||
-        !gst_element_link(parse_in, decoder) ||
-        !gst_element_link(decoder, conv)) {
-        std::cerr << "[ENC] Link failed (depay→decoder→conv)" << std::endl;
-        gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
-        return false;
+    // Source side: one camera, or N cameras composited into one frame
+    if (config_->mosaic.enabled) {
+        GstElement* comp = mosaic_.build(GST_BIN(enc_pipeline_));
+        bool ok = comp != nullptr;
+        for (size_t i = 0; ok && i < mosaic_.input_count(); i++) {
+            GstElement* tail = add_source_chain(mosaic_.input_url(i), std::to_string(i));
+            ok = tail && mosaic_.link_input(GST_BIN(enc_pipeline_), i, tail);
+        }
+        if (ok) {
+            std::ostringstream ss;
+            ss << "video/x-raw(memory:NVMM),format=RGBA"
+               << ",width=" << config_->encoder.width
+               << ",height=" << config_->encoder.height
+               << ",framerate=" << config_->encoder.framerate << "/1";
+            GstCaps* caps = gst_caps_from_string(ss.str().c_str());
+            ok = link_via_queue(comp, q_convert, conv, caps);
+            gst_caps_unref(caps);
+            if (!ok) std::cerr << "[ENC] Link failed (mosaic→conv): " << ss.str() << std::endl;
+        }
+        if (!ok) {
+            gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
+            return false;
+        }
+    } else {
+        GstElement* decoder = add_source_chain(config_->rtsp.url, "");
+        if (!decoder || !link_via_queue(decoder, q_convert, conv, nullptr)) {
+            std::cerr << "[ENC] Link failed (depay→decoder→conv)" << std::endl;
+            gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
+            return false;
+        }
+    }
+
+    // Optional CPU denoise: conv → NV12 system memory → [filter] → dn_up → NVMM
+    GstElement* enc_feed = conv;
+    if (config_->denoise.enabled) {
+        GstElement* dn_up = gst_element_factory_make("nvvidconv", "dn_up");
+        if (!dn_up) {
+            gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
+            return false;
+        }
+        set_if_exists(dn_up, "output-buffers", config_->memory.converter_buffers);
+        gst_bin_add(GST_BIN(enc_pipeline_), dn_up);
+
+        int width, height;
+        encoder_input_size(width, height);
+        std::string caps_str = nv12_caps_string(false, width, height);
+        GstElement* dn_caps = make_capsfilter("dn_caps", caps_str);
+        bool ok = dn_caps != nullptr;
+        if (ok) {
+            gst_bin_add(GST_BIN(enc_pipeline_), dn_caps);
+            ok = gst_element_link_many(conv, dn_caps, dn_up, NULL);
+        }
+        if (!ok) {
+            std::cerr << "[ENC] Link failed (conv→dn_up): " << caps_str << std::endl;
+            gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
+            return false;
+        }
+
+        GstPad* dn_pad = gst_element_get_static_pad(dn_up, "sink");
+        denoiser_.attach(dn_pad);
+        gst_object_unref(dn_pad);
+        enc_feed = dn_up;
     }
 
     // conv → enc (NVMM caps, NO framerate — decoder outputs 0/1)
     {
-        std::ostringstream ss;
-        ss << "video/x-raw(memory:NVMM),format=NV12"
-           << ",width=" << config_.encoder.width
-           << ",height=" << config_.encoder.height;
-        GstCaps* caps = gst_caps_from_string(ss.str().c_str());
-        if (!gst_element_link_filtered(conv, enc, caps)) {
-            std::cerr << "[ENC] Link failed (conv→enc): " << ss.str() << std::endl;
-            gst_caps_unref(caps);
+        int width, height;
+        encoder_input_size(width, height);
+        std::string caps_str = nv12_caps_string(true, width, height);
+        GstElement* enc_caps = make_capsfilter("enc_caps", caps_str);
+        bool ok = enc_caps != nullptr;
+        if (ok) {
+            gst_bin_add(GST_BIN(enc_pipeline_), enc_caps);
+            ok = gst_element_link(enc_feed, enc_caps) && link_via_queue(enc_caps, q_encode, enc, nullptr);
+        }
+        if (!ok) {
+            std::cerr << "[ENC] Link failed (conv→enc): " << caps_str << std::endl;
             gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
             return false;
         }
-        gst_caps_unref(caps);
     }
 
-    // enc → parse_out (byte-stream)
+    // enc → sink: NVENC emits whole access units with SPS/PPS before each
+    // IDR, so no parser; on_encoded_buffer scans each AU once
     GstCaps* enc_caps = gst_caps_from_string("video/x-h264,stream-format=byte-stream");
-    if (!gst_element_link_filtered(enc, parse_out, enc_caps)) {
-        std::cerr << "[ENC] Link failed (enc→parse_out)" << std::endl;
+    if (!link_via_queue(enc, q_output, sink, enc_caps)) {
+        std::cerr << "[ENC] Link failed (enc→sink)" << std::endl;
         gst_caps_unref(enc_caps);
         gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
         return false;
     }
     gst_caps_unref(enc_caps);
 
-    // parse_out → sink
-    if (!gst_element_link(parse_out, sink)) {
-        std::cerr << "[ENC] Link failed (parse_out→sink)" << std::endl;
-        gst_object_unref(enc_pipeline_); enc_pipeline_ = nullptr;
-        return false;
-    }
-
-    // Dynamic pad for rtspsrc → depay
-    g_signal_connect(src, "pad-added", G_CALLBACK(Pipeline::on_pad_added), depay);
-
     // Frame counter probe
     GstPad* pad = gst_element_get_static_pad(sink, "sink");
     if (pad) {
-        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, frame_probe, &stats_, NULL);
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, Pipeline::on_encoded_buffer, this, NULL);
         gst_object_unref(pad);
     }
 
+    // Transit probe: converter in → appsink
+    pad = gst_element_get_static_pad(conv, "sink");
+    if (pad) {
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, Pipeline::on_converter_buffer, this, NULL);
+        gst_object_unref(pad);
+    }
+    {
+        std::lock_guard<std::mutex> transit_lock(transit_mutex_);
+        transit_.clear();
+    }
+
+    gop_.reset();
+
     // Bus watch
     enc_bus_ = gst_element_get_bus(enc_pipeline_);
     gst_bus_add_watch(enc_bus_, Pipeline::on_bus_message, this);
+    thread_roles_watch_bus(enc_bus_, ThreadRole::Streaming);
 
     std::cout << "[ENC] Pipeline built OK" << std::endl;
     return true;
@@ -243,33 +634,78 @@ bool Pipeline::build_encoder_pipeline() {
 bool Pipeline::start() {
     if (running_.load()) return false;
 
-    if (!build_encoder_pipeline()) {
-        std::cerr << "[PIPE] Build failed" << std::endl;
-        return false;
-    }
+    failed_.store(false);
 
-    GstStateChangeReturn ret = gst_element_set_state(enc_pipeline_, GST_STATE_PLAYING);
-    if (ret == GST_STATE_CHANGE_FAILURE) {
-        std::cerr << "[PIPE] PLAYING failed" << std::endl;
-        stop_encoder();
-        return false;
+    // Server first: clients can connect (and wait for the first IDR) while
+    // the camera is still negotiating
+    int64_t t = startup_ ? startup_->now_ns() : 0;
+    if (role_ != PipelineRole::Worker) {
+        if (!start_rtsp_server(take_over_ ? take_over_socket() : -1)) {
+            std::cerr << "[PIPE] RTSP server failed" << std::endl;
+            return false;
+        }
+        if (startup_) startup_->phase("rtsp server", t);
+        start_upgrade_listener();
     }
 
-    if (!start_rtsp_server()) {
-        std::cerr << "[PIPE] RTSP server failed" << std::endl;
-        stop_encoder();
-        return false;
+    transition(PipelineState::Building, "start");
+    if (role_ == PipelineRole::Server) {
+        // No encoder here to probe: intra refresh only when asked for by name
+        recovery_mode_ = config_->recovery.mode == "intra_refresh" ? RecoveryMode::IntraRefresh
+                                                                   : RecoveryMode::Idr;
+        gop_.set_refresh_recovery(recovery_mode_ == RecoveryMode::IntraRefresh);
+        bool ok = worker_->start(
+            [this](GstSample* sample, bool keyframe) { on_worker_frame(sample, keyframe); },
+            [this]() {
+                if (GST_CLOCK_TIME_IS_VALID(last_out_pts_.load())) splice_pending_.store(true);
+            });
+        if (!ok) {
+            std::cerr << "[PIPE] Encoder worker failed to start" << std::endl;
+            stop_upgrade_listener(true);
+            stop_rtsp_server();
+            transition(PipelineState::Stopped, "worker spawn failed");
+            return false;
+        }
+    } else {
+        t = startup_ ? startup_->now_ns() : 0;
+        if (!build_encoder_pipeline()) {
+            std::cerr << "[PIPE] Build failed" << std::endl;
+            stop_upgrade_listener(true);
+            stop_rtsp_server();
+            transition(PipelineState::Stopped, "build failed");
+            return false;
+        }
+        if (startup_) startup_->phase("pipeline build", t);
+
+        t = startup_ ? startup_->now_ns() : 0;
+        GstStateChangeReturn ret = gst_element_set_state(enc_pipeline_, GST_STATE_PLAYING);
+        if (ret == GST_STATE_CHANGE_FAILURE) {
+            std::cerr << "[PIPE] PLAYING failed" << std::endl;
+            stop_encoder();
+            stop_upgrade_listener(true);
+            stop_rtsp_server();
+            transition(PipelineState::Stopped, "PLAYING failed");
+            return false;
+        }
+        if (startup_) startup_->phase("set PLAYING", t);
     }
 
     running_.store(true);
     stats_.reset();
-    reconnect_delay_s_ = config_.rtsp.reconnect_delay_s;
+    open_power_meter();
+    thermal_.open();
+    reconnect_delay_s_ = config_->rtsp.reconnect_delay_s;
+    control_source_id_ = g_timeout_add(1000, Pipeline::on_control_tick, this);
+    transition(PipelineState::Connecting, "");
+    if (role_ != PipelineRole::Server) {
+        stall_.start([this](StallDetector::Level level, int64_t ms) { on_stall(level, ms); });
+    }
 
     std::cout << "============================================" << std::endl;
     std::cout << "  RUNNING" << std::endl;
-    std::cout << "  Input:   " << config_.rtsp.url << std::endl;
-    std::cout << "  Output:  rtsp://localhost:" << config_.output.port
-              << config_.output.path << std::endl;
+    std::cout << "  Input:   " << config_->rtsp.url << std::endl;
+    std::cout << "  Output:  rtsp://localhost:" << config_->output.port
+              << config_->output.path << std::endl;
     std::cout << "============================================" << std::endl;
 
     return true;
@@ -279,61 +715,684 @@ void Pipeline::stop() {
     if (!running_.load()) return;
     std::cout << "[PIPE] Stopping..." << std::endl;
     running_.store(false);
+    fanout_.close_all();
+    if (control_source_id_) { g_source_remove(control_source_id_); control_source_id_ = 0; }
+    if (backoff_source_id_) { g_source_remove(backoff_source_id_); backoff_source_id_ = 0; }
+    if (drain_source_id_) { g_source_remove(drain_source_id_); drain_source_id_ = 0; }
+    if (worker_) worker_->stop();
     stop_encoder();
+    stall_.stop();   // after the appsink thread that re-arms it is gone
+    stop_upgrade_listener(true);
     stop_rtsp_server();
+    // The pool is process-wide; only the final stop may wait out its threads
+    gst_rtsp_thread_pool_cleanup();
+    if (state_.load() != PipelineState::Stopped) transition(PipelineState::Stopped, "stop");
     std::cout << "[PIPE] Stopped" << std::endl;
 }
 
-bool Pipeline::restart_encoder() {
-    int max = config_.resilience.max_pipeline_restarts;
-    uint32_t cur = stats_.restart_count();
-    if (max > 0 && (int)cur >= max) {
+// ============================================================================
+//  Lifecycle
+// ============================================================================
+
+const char* pipeline_state_name(PipelineState state) {
+    switch (state) {
+        case PipelineState::Stopped:    return "Stopped";
+        case PipelineState::Building:   return "Building";
+        case PipelineState::Connecting: return "Connecting";
+        case PipelineState::Playing:    return "Playing";
+        case PipelineState::Degraded:   return "Degraded";
+        case PipelineState::Backoff:    return "Backoff";
+        case PipelineState::Idle:       return "Idle";
+    }
+    return "?";
+}
+
+/// HH:MM:SS.mmm local time for transition logs.
+static std::string wall_clock_string() {
+    auto now = std::chrono::system_clock::now();
+    std::time_t t = std::chrono::system_clock::to_time_t(now);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        now.time_since_epoch()).count() % 1000;
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%03d",
+             tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<int>(ms));
+    return buf;
+}
+
+void Pipeline::transition(PipelineState next, const std::string& reason) {
+    auto now = std::chrono::steady_clock::now();
+    PipelineState prev = state_.exchange(next);
+    double held_s = std::chrono::duration<double>(now - state_since_).count();
+    state_since_ = now;
+    std::cout << "[STATE] " << wall_clock_string() << " "
+              << pipeline_state_name(prev) << " → " << pipeline_state_name(next);
+    if (prev != PipelineState::Stopped) {
+        std::cout << " after " << std::fixed << std::setprecision(1) << held_s << "s";
+    }
+    if (!reason.empty()) std::cout << " (" << reason << ")";
+    std::cout << std::endl;
+}
+
+const char* restart_tier_name(RestartTier tier) {
+    switch (tier) {
+        case RestartTier::Source:  return "source";
+        case RestartTier::Decoder: return "decoder";
+        case RestartTier::Full:    return "full";
+    }
+    return "?";
+}
+
+/// Which part of the encoder pipeline an error came from: the element's
+/// ancestor directly inside enc_pipeline_ ("src3" → source chain 3).
+RestartTier Pipeline::classify_failure(GstObject* origin, std::string& suffix) const {
+    GstObject* obj = origin ? GST_OBJECT(gst_object_ref(origin)) : nullptr;
+    while (obj) {
+        GstObject* parent = gst_object_get_parent(obj);
+        if (!parent) break;
+        if (parent == GST_OBJECT(enc_pipeline_)) { gst_object_unref(parent); break; }
+        gst_object_unref(obj);
+        obj = parent;
+    }
+    RestartTier tier = RestartTier::Full;
+    if (obj) {
+        gchar* name = gst_object_get_name(obj);
+        std::string n = name ? name : "";
+        g_free(name);
+        gst_object_unref(obj);
+        for (const char* prefix : {"src", "depay", "parse_in", "decoder"}) {
+            if (n.rfind(prefix, 0) == 0) {
+                suffix = n.substr(strlen(prefix));
+                tier = strcmp(prefix, "decoder") == 0 ? RestartTier::Decoder : RestartTier::Source;
+                break;
+            }
+        }
+    }
+    return tier;
+}
+
+/// Schedule recovery after the backoff delay. The first retry after a
+/// healthy run is immediate; consecutive failures back off exponentially
+/// and escalate source → decoder → full rebuild.
+void Pipeline::schedule_restart(const std::string& reason, RestartTier tier, const std::string& suffix) {
+    PipelineState st = state_.load();
+    if (st == PipelineState::Stopped) return;
+    if (st == PipelineState::Backoff) {
+        // Already pending: a deeper tier asked for meanwhile (e.g. a structural
+        // reload) must not be lost
+        if (tier > pending_tier_) {
+            pending_tier_ = tier;
+            pending_suffix_ = suffix;
+            if (tier == RestartTier::Full) {
+                if (GST_CLOCK_TIME_IS_VALID(last_out_pts_.load())) splice_pending_.store(true);
+                stop_encoder();
+            }
+        }
+        return;
+    }
+
+    int max = config_->resilience.max_pipeline_restarts;
+    if (max > 0 && (int)stats_.restart_count() >= max) {
         std::cerr << "[PIPE] Max restarts reached" << std::endl;
-        return false;
+        stop_encoder();
+        transition(PipelineState::Stopped, "restart budget exhausted");
+        failed_.store(true);
+        return;
     }
 
-    stats_.on_pipeline_restart();
-    std::cout << "[PIPE] Restart #" << stats_.restart_count()
-              << ", wait " << reconnect_delay_s_ << "s..." << std::endl;
+    if (st == PipelineState::Idle) {
+        // Failed while idle: restart like any other, then idle again after the grace
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& gate : gates_) gate->open();
+        encode_paused_.store(false);
+        torn_down_ = false;
+        idle_ticks_ = 0;
+    }
 
-    std::this_thread::sleep_for(std::chrono::seconds(reconnect_delay_s_));
-    reconnect_delay_s_ = std::min(reconnect_delay_s_ * 2, 30);
+    bool healthy = st == PipelineState::Playing || st == PipelineState::Degraded;
+    if (healthy) escalation_floor_ = RestartTier::Source;
+    pending_tier_ = std::max(tier, escalation_floor_);
+    pending_suffix_ = suffix;
+    if (!enc_pipeline_) pending_tier_ = RestartTier::Full;
+    // Mosaic chains are numbered; without one named there is nothing to swap
+    if (config_->mosaic.enabled && suffix.empty()) pending_tier_ = RestartTier::Full;
+
+    if (pending_tier_ == RestartTier::Full) {
+        // Clients stay attached to the fan-out; output resumes on the new IDR
+        if (GST_CLOCK_TIME_IS_VALID(last_out_pts_.load())) splice_pending_.store(true);
+        stop_encoder();
+    }
+    int delay_s = healthy ? 0 : reconnect_delay_s_;
+    if (delay_s > 0) reconnect_delay_s_ = std::min(reconnect_delay_s_ * 2, 30);
+    transition(PipelineState::Backoff, reason + ", " + restart_tier_name(pending_tier_) +
+                                       " restart in " + std::to_string(delay_s) + "s");
+    backoff_source_id_ = g_timeout_add_seconds(delay_s, Pipeline::on_backoff_expired, this);
+}
 
-    stop_encoder();
-    if (!build_encoder_pipeline()) return false;
+gboolean Pipeline::on_backoff_expired(gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    self->backoff_source_id_ = 0;
+    RestartTier tier = self->pending_tier_;
+
+    self->stats_.on_pipeline_restart();
+    self->transition(PipelineState::Building, std::string(restart_tier_name(tier)) +
+                                              " restart #" + std::to_string(self->stats_.restart_count()));
+    // A tier that doesn't bring frames back escalates on the next failure
+    self->escalation_floor_ = tier == RestartTier::Full ? RestartTier::Full
+                                                        : static_cast<RestartTier>(static_cast<int>(tier) + 1);
+    self->restart_started_ = std::chrono::steady_clock::now();
+
+    bool ok;
+    if (tier == RestartTier::Full) {
+        ok = self->build_encoder_pipeline() &&
+             gst_element_set_state(self->enc_pipeline_, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE;
+    } else {
+        ok = self->restart_source_chain(tier, self->pending_suffix_);
+    }
+    if (!ok) {
+        self->schedule_restart(std::string(restart_tier_name(tier)) + " restart failed", RestartTier::Full, "");
+        return G_SOURCE_REMOVE;
+    }
 
-    GstStateChangeReturn ret = gst_element_set_state(enc_pipeline_, GST_STATE_PLAYING);
-    if (ret == GST_STATE_CHANGE_FAILURE) { stop_encoder(); return false; }
+    self->restart_build_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - self->restart_started_).count();
+    self->restart_first_frame_ns_.store(0);
+    self->awaiting_first_frame_.store(true);
+    self->stats_.reset();
+    self->stall_.reset();
+    self->transition(PipelineState::Connecting, "");
+    return G_SOURCE_REMOVE;
+}
 
-    stats_.reset();
-    reconnect_delay_s_ = config_.rtsp.reconnect_delay_s;
-    std::cout << "[PIPE] Restarted OK" << std::endl;
-    return true;
+/// In-place recovery of one source chain, leaving conv/NVENC/appsink (and
+/// clients) untouched. Source tier: replace rtspsrc. Decoder tier: also
+/// flush the decoder, which drops its queued frames and resets its state.
+bool Pipeline::restart_source_chain(RestartTier tier, const std::string& suffix) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    GstBin* bin = GST_BIN(enc_pipeline_);
+
+    std::string url = config_->rtsp.url;
+    if (config_->mosaic.enabled) {
+        size_t index = suffix.empty() ? 0 : std::stoul(suffix);
+        if (index >= mosaic_.input_count()) return false;
+        url = mosaic_.input_url(index);
+    }
+
+    GstElement* depay = gst_bin_get_by_name(bin, ("depay" + suffix).c_str());
+    if (!depay) return false;
+
+    GstElement* old_src = gst_bin_get_by_name(bin, ("src" + suffix).c_str());
+    if (old_src) {
+        gst_element_set_state(old_src, GST_STATE_NULL);
+        gst_bin_remove(bin, old_src);   // also unlinks it from depay
+        gst_object_unref(old_src);
+    }
+
+    if (tier == RestartTier::Decoder) {
+        // From the decode queue when there is one, so its backlog goes too
+        GstElement* decoder = gst_bin_get_by_name(bin, ("q_decode" + suffix).c_str());
+        if (!decoder) decoder = gst_bin_get_by_name(bin, ("decoder" + suffix).c_str());
+        if (decoder) {
+            GstPad* pad = gst_element_get_static_pad(decoder, "sink");
+            gst_pad_send_event(pad, gst_event_new_flush_start());
+            gst_pad_send_event(pad, gst_event_new_flush_stop(FALSE));
+            gst_object_unref(pad);
+            gst_object_unref(decoder);
+        }
+        // The flush reaches NVENC too: resume output on its next IDR
+        if (GST_CLOCK_TIME_IS_VALID(last_out_pts_.load())) splice_pending_.store(true);
+    }
+
+    GstElement* src = make_source(url, suffix);
+    bool ok = src != nullptr;
+    if (ok) {
+        gst_bin_add(bin, src);
+        g_signal_connect(src, "pad-added", G_CALLBACK(Pipeline::on_pad_added), depay);
+        ok = gst_element_sync_state_with_parent(src);
+    }
+    gst_object_unref(depay);
+    return ok;
 }
 
-bool Pipeline::watchdog_check() {
-    if (!running_.load()) return false;
+/// Once per control tick: frame flow decides Connecting/Playing/Degraded
+/// and triggers the watchdog restart.
+void Pipeline::check_liveness() {
+    if (role_ == PipelineRole::Server) { check_worker(); return; }
+    PipelineState st = state_.load();
+    double timeout = (double)config_->resilience.watchdog_timeout_s;
+
+    if (st == PipelineState::Connecting) {
+        if (stats_.frame_count() > 0) {
+            reconnect_delay_s_ = config_->rtsp.reconnect_delay_s;
+            int64_t first_ns = restart_first_frame_ns_.exchange(0);
+            if (first_ns > 0) {
+                // Tier duration: restart began → first encoded frame
+                int64_t total_ms = (first_ns - std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    restart_started_.time_since_epoch()).count()) / 1000000;
+                std::cout << "[RESTART] " << restart_tier_name(pending_tier_) << " restart: "
+                          << restart_build_ms_ << " ms rebuild, " << total_ms
+                          << " ms to first frame" << std::endl;
+                stats_.on_restart_tier(pending_tier_, restart_build_ms_, total_ms);
+            }
+            transition(PipelineState::Playing, "first frame");
+        } else if (std::chrono::duration<double>(std::chrono::steady_clock::now() - state_since_).count() > timeout) {
+            schedule_restart("no first frame", RestartTier::Source, "");
+        }
+        return;
+    }
+    if (st != PipelineState::Playing && st != PipelineState::Degraded) return;
+
     double since = stats_.seconds_since_last_frame();
-    if (since > (double)config_.resilience.watchdog_timeout_s && stats_.frame_count() > 0) {
-        std::cerr << "[WATCH] No frames for " << since << "s" << std::endl;
+    double degraded_after = config_->resilience.degraded_after_ms / 1000.0;
+    if (since > timeout) {
+        std::ostringstream ss;
+        ss << "watchdog: no frames for " << std::fixed << std::setprecision(1) << since << "s";
+        schedule_restart(ss.str(), RestartTier::Source, "");
+    } else if (st == PipelineState::Playing && since > degraded_after) {
+        transition(PipelineState::Degraded, "frames stalled");   // stall detector unavailable
+    } else if (st == PipelineState::Degraded && !stall_.stalled() && since <= degraded_after) {
+        int64_t ms = stall_.take_cleared_ms();
+        transition(PipelineState::Playing, ms >= 0 ? "frames resumed after " + std::to_string(ms) + "ms"
+                                                   : "frames resumed");
+    }
+}
+
+/// Server: frame flow from the worker only drives the reported state; the
+/// worker restarts its own encoder, and is killed and respawned if hung.
+void Pipeline::check_worker() {
+    worker_->check();
+    PipelineState st = state_.load();
+    double degraded_after = config_->resilience.degraded_after_ms / 1000.0;
+    bool flowing = stats_.frame_count() > 0 && stats_.seconds_since_last_frame() <= degraded_after;
+    if (flowing && st != PipelineState::Playing) {
+        transition(PipelineState::Playing, st == PipelineState::Connecting ? "first frame from worker" : "frames resumed");
+    } else if (!flowing && st == PipelineState::Playing) {
+        transition(PipelineState::Degraded, worker_->alive() ? "worker frames stalled" : "worker exited");
+    }
+}
+
+/// Cadence-based stall reaction (main loop). Soft: ask NVENC for an IDR so
+/// the first frame after the gap is decodable on its own. Hard: restart,
+/// starting from the cheapest tier.
+void Pipeline::on_stall(StallDetector::Level level, int64_t stalled_ms) {
+    PipelineState st = state_.load();
+    if (st != PipelineState::Playing && st != PipelineState::Degraded) return;
+
+    std::ostringstream ss;
+    ss << "no frame for " << stalled_ms << "ms, expected every "
+       << std::fixed << std::setprecision(1) << stall_.gap_ms() << "ms";
+    if (level == StallDetector::Soft) {
+        request_idr();
+        if (st == PipelineState::Playing) transition(PipelineState::Degraded, ss.str());
+    } else {
+        schedule_restart("stall: " + ss.str(), RestartTier::Source, "");
+    }
+}
+
+void Pipeline::set_bitrate(uint32_t t, uint32_t m) {
+    AppConfig next = config_.get();
+    next.encoder.target_bitrate_kbps = t;
+    next.encoder.max_bitrate_kbps = m;
+    config_.publish(next);
+    apply_bitrate(t, m);
+}
+
+/// NVENC budgets each frame as bitrate / the negotiated framerate, which the
+/// thermal fps step leaves as it is (nvvidconv cannot change the rate in
+/// caps). With one frame in `frame_divisor_` encoded, the rate is scaled up
+/// by the divisor so the wire still carries the target. Main loop.
+void Pipeline::apply_bitrate(uint32_t target_kbps, uint32_t peak_kbps) {
+    uint32_t divisor = frame_divisor_.load();
+    encoder_.set_bitrate(target_kbps * divisor, peak_kbps * divisor);
+}
+
+// ============================================================================
+//  Hot reload
+// ============================================================================
+
+static const char* config_change_name(ConfigChange change) {
+    switch (change) {
+        case ConfigChange::None:        return "none";
+        case ConfigChange::Live:        return "live";
+        case ConfigChange::Renegotiate: return "renegotiate";
+        case ConfigChange::Structural:  return "structural";
+    }
+    return "?";
+}
+
+void Pipeline::reload(const AppConfig& next) {
+    if (handed_over_) {
+        std::cout << "[RELOAD] Ignored: draining after an upgrade" << std::endl;
+        return;
+    }
+    std::string what;
+    ConfigChange change = diff_config(config_.get(), next, what);
+    if (change == ConfigChange::None) {
+        std::cout << "[RELOAD] No changes" << std::endl;
+        return;
+    }
+    AppConfig prev = config_.get();
+    config_.publish(next);
+    std::cout << "[RELOAD] Applying (" << config_change_name(change) << "): " << what << std::endl;
+
+    if (prev.isolation.mode != next.isolation.mode || prev.isolation.ring_kb != next.isolation.ring_kb) {
+        std::cerr << "[RELOAD] isolation.mode/ring_kb take effect on the next start" << std::endl;
+    }
+    if (prev.memory.arena != next.memory.arena || prev.memory.arena_mb != next.memory.arena_mb ||
+        prev.memory.hugepages != next.memory.hugepages || prev.memory.budget_mb != next.memory.budget_mb) {
+        std::cerr << "[RELOAD] memory.arena/arena_mb/hugepages/budget_mb take effect on the next start" << std::endl;
+    }
+    if (!prev.threads.same_as(next.threads)) thread_roles_configure(next.threads);
+    if (prev.output.workers != next.output.workers && rtsp_server_) {
+        // New clients only; connected ones stay on their thread
+        GstRTSPThreadPool* pool = gst_rtsp_server_get_thread_pool(rtsp_server_);
+        gst_rtsp_thread_pool_set_max_threads(pool, next.output.workers);
+        g_object_unref(pool);
+    }
+    if (prev.idle.power_voltage != next.idle.power_voltage || prev.idle.power_current != next.idle.power_current) {
+        open_power_meter();
+    }
+    if (!prev.thermal.same_as(next.thermal)) {
+        thermal_.open();
+        if (role_ != PipelineRole::Server) apply_quality(thermal_.quality());
+    }
+    if (prev.upgrade.socket != next.upgrade.socket && role_ != PipelineRole::Worker) {
+        stop_upgrade_listener(true);
+        start_upgrade_listener();
+    }
+    bool endpoint_changed = prev.output.port != next.output.port || prev.output.path != next.output.path ||
+                            prev.svc.temporal_layers != next.svc.temporal_layers;
+    if (role_ == PipelineRole::Server) {
+        // Encoder changes are the worker's: it re-reads the same file
+        if (endpoint_changed) {
+            std::cerr << "[RELOAD] RTSP endpoint changed, clients will reconnect" << std::endl;
+            stop_rtsp_server();
+            if (!start_rtsp_server()) std::cerr << "[RELOAD] RTSP server failed" << std::endl;
+        }
+        worker_->reload();
+        return;
+    }
+
+    if (change == ConfigChange::Structural) {
+        // Endpoint or media sharing changed: the server itself must be replaced
+        if (endpoint_changed && role_ == PipelineRole::Single) {
+            std::cerr << "[RELOAD] RTSP endpoint changed, clients will reconnect" << std::endl;
+            stop_rtsp_server();
+            if (!start_rtsp_server()) std::cerr << "[RELOAD] RTSP server failed" << std::endl;
+        }
+        schedule_restart("config reload", RestartTier::Full, "");
+        return;
+    }
+
+    if (prev.encoder.target_bitrate_kbps != next.encoder.target_bitrate_kbps ||
+        prev.encoder.max_bitrate_kbps != next.encoder.max_bitrate_kbps) {
+        apply_bitrate(next.encoder.target_bitrate_kbps, next.encoder.max_bitrate_kbps);
+    }
+    if (change == ConfigChange::Renegotiate && !renegotiate(prev, next)) {
+        schedule_restart("config reload, renegotiation refused", RestartTier::Full, "");
+    }
+}
+
+/// Resolution and fixed IDR interval changes without a rebuild: new caps on
+/// the encoder-input capsfilters (nvvidconv rescales, NVENC reconfigures on
+/// the caps event), new IDR interval on the running encoder.
+bool Pipeline::renegotiate(const AppConfig& prev, const AppConfig& next) {
+    if (!enc_pipeline_) return true;   // the next build picks it up
+    bool ok = true;
+
+    if (prev.encoder.width != next.encoder.width || prev.encoder.height != next.encoder.height) {
+        if (!set_encoder_input_size()) return false;
+        int width, height;
+        encoder_input_size(width, height);
+        std::cout << "[RELOAD] Renegotiated to " << width << "x" << height << std::endl;
+    }
+
+    if (!next.gop.adaptive && prev.encoder.idr_interval != next.encoder.idr_interval) {
+        ok = encoder_.set_idr_interval(next.encoder.idr_interval);
+    }
+    return ok;
+}
+
+/// Encoder input size: the configured one, scaled by the thermal governor
+/// (kept even for NV12).
+void Pipeline::encoder_input_size(int& width, int& height) const {
+    width = (int)(config_->encoder.width * quality_.scale) & ~1;
+    height = (int)(config_->encoder.height * quality_.scale) & ~1;
+}
+
+/// New encoder input size on the running pipeline: new caps on the named
+/// capsfilters in front of the encoder (enc_caps) and the denoise upload
+/// (dn_caps); nvvidconv rescales, NVENC reconfigures on the caps event and
+/// starts over with an IDR. False if a filter is missing.
+bool Pipeline::set_encoder_input_size() {
+    if (!enc_pipeline_) return true;   // the next build picks it up
+    auto set_filter_caps = [this](const char* name, const std::string& caps_str) {
+        GstElement* filter = gst_bin_get_by_name(GST_BIN(enc_pipeline_), name);
+        if (!filter) {
+            std::cerr << "[ENC] No capsfilter '" << name << "' to renegotiate" << std::endl;
+            return false;
+        }
+        GstCaps* caps = gst_caps_from_string(caps_str.c_str());
+        g_object_set(G_OBJECT(filter), "caps", caps, NULL);
+        gst_caps_unref(caps);
+        gst_object_unref(filter);
+        return true;
+    };
+    int width, height;
+    encoder_input_size(width, height);
+    if (config_->denoise.enabled && !set_filter_caps("dn_caps", nv12_caps_string(false, width, height))) {
         return false;
     }
+    if (!set_filter_caps("enc_caps", nv12_caps_string(true, width, height))) return false;
+    request_idr();
     return true;
 }
 
-void Pipeline::set_bitrate(uint32_t t, uint32_t m) {
-    config_.encoder.target_bitrate_kbps = t;
-    config_.encoder.max_bitrate_kbps = m;
-    encoder_.set_bitrate(t, m);
+/// Continuous output across encoder restarts. Each encoder starts its own
+/// timeline at zero, so after a restart output waits for the new encoder's
+/// first IDR, then every buffer is shifted onto the old timeline plus the
+/// wall-clock outage; the first one is flagged DISCONT.
+/// Returns the sample to publish (new ref) or nullptr to drop.
+GstSample* Pipeline::splice_sample(GstSample* sample, bool keyframe) {
+    GstBuffer* buf = gst_sample_get_buffer(sample);
+    auto now = std::chrono::steady_clock::now();
+    bool first = false;
+    GstClockTime last_pts = last_out_pts_.load();
+
+    if (splice_pending_.load()) {
+        if (!keyframe) return nullptr;
+        splice_pending_.store(false);
+        first = true;
+        int64_t gap_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_publish_).count();
+        if (GST_BUFFER_PTS_IS_VALID(buf) && GST_CLOCK_TIME_IS_VALID(last_pts)) {
+            ts_offset_ns_ = (int64_t)last_pts + gap_ns - (int64_t)GST_BUFFER_PTS(buf);
+        }
+        stats_.on_splice(gap_ns / 1000000);
+        std::cout << "[SPLICE] Output resumed on new encoder's IDR after "
+                  << gap_ns / 1000000 << " ms, " << clients_.load() << " client(s) kept" << std::endl;
+    }
+    last_publish_ = now;
+
+    if (ts_offset_ns_ == 0 && !first) {
+        if (GST_BUFFER_PTS_IS_VALID(buf) &&
+            (!GST_CLOCK_TIME_IS_VALID(last_pts) || GST_BUFFER_PTS(buf) > last_pts)) {
+            last_out_pts_.store(GST_BUFFER_PTS(buf));
+        }
+        return gst_sample_ref(sample);
+    }
+
+    // Metadata copy; the encoded memory itself is shared
+    GstBuffer* out = gst_buffer_copy(buf);
+    auto shift = [this](GstClockTime t) -> GstClockTime {
+        if (!GST_CLOCK_TIME_IS_VALID(t)) return t;
+        int64_t v = (int64_t)t + ts_offset_ns_;
+        return v > 0 ? (GstClockTime)v : 0;
+    };
+    GST_BUFFER_PTS(out) = shift(GST_BUFFER_PTS(out));
+    GST_BUFFER_DTS(out) = shift(GST_BUFFER_DTS(out));
+    if (first) GST_BUFFER_FLAG_SET(out, GST_BUFFER_FLAG_DISCONT);
+    if (GST_BUFFER_PTS_IS_VALID(out) &&
+        (!GST_CLOCK_TIME_IS_VALID(last_pts) || GST_BUFFER_PTS(out) > last_pts)) {
+        last_out_pts_.store(GST_BUFFER_PTS(out));
+    }
+
+    GstSample* spliced = gst_sample_new(out, gst_sample_get_caps(sample), NULL, NULL);
+    gst_buffer_unref(out);
+    return spliced;
 }
 
-GstSample* Pipeline::pull_latest_sample() {
-    if (!appsink_ || !running_.load()) return nullptr;
-    return gst_app_sink_try_pull_sample(GST_APP_SINK(appsink_), GST_MSECOND * 100);
+/// Appsink streaming thread: tag the access unit's temporal layer and
+/// hand it to every client's fan-out queue.
+GstFlowReturn Pipeline::on_new_sample(GstAppSink* sink, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    GstSample* sample = gst_app_sink_pull_sample(sink);
+    if (!sample) return GST_FLOW_OK;
+
+    GstBuffer* buf = gst_sample_get_buffer(sample);
+    if (buf) {
+        bool keyframe = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+        GstSample* out = self->splice_sample(sample, keyframe);
+        if (out) {
+            self->publish_output(out, keyframe);
+            gst_sample_unref(out);
+        }
+    }
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+/// Spliced output → clients: every client's fan-out queue, or in a worker
+/// the shared-memory ring towards the serving process.
+void Pipeline::publish_output(GstSample* sample, bool keyframe) {
+    GstBuffer* buf = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+    if (!gst_buffer_map(buf, &map, GST_MAP_READ)) return;
+
+    if (ring_) {
+        GstCaps* caps = gst_sample_get_caps(sample);
+        if (caps && (!ring_caps_ || !gst_caps_is_equal(caps, ring_caps_))) {
+            gchar* str = gst_caps_to_string(caps);
+            ring_->set_caps(str);
+            g_free(str);
+            gst_caps_replace(&ring_caps_, caps);
+        }
+        RingFrame frame;
+        frame.pts = GST_BUFFER_PTS(buf);
+        frame.dts = GST_BUFFER_DTS(buf);
+        frame.duration = GST_BUFFER_DURATION(buf);
+        frame.keyframe = keyframe;
+        frame.discont = GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DISCONT);
+        if (!ring_->write(map.data, map.size, frame)) {
+            std::cerr << "[RING] Access unit of " << map.size << " bytes exceeds half the ring" << std::endl;
+        }
+        gst_buffer_unmap(buf, &map);
+        return;
+    }
+
+    GstCaps* caps = gst_sample_get_caps(sample);
+    if (caps && caps != out_caps_ && (!out_caps_ || !gst_caps_is_equal(caps, out_caps_))) on_output_caps(caps);
+
+    // Split-mode frames come off the ring without the scan
+    AccessUnitInfo scanned;
+    const AccessUnitInfo* au = buffer_get_au_info(buf);
+    if (!au) {
+        h264_scan_access_unit(map.data, map.size, scanned);
+        au = &scanned;
+    }
+    int tid = layer_tagger_.tag(au->nals);
+    admission_.on_access_unit(tid, map.size);
+
+    // Parameter sets: cached from every IDR, stripped while unchanged;
+    // AUD/SEI/filler as configured. One rebuild drops them all.
+    uint32_t mask = config_->output.strip_mask();
+    ParamSetCache::Result ps = keyframe ? param_sets_.update(map.data, *au) : ParamSetCache::Result::None;
+    if (ps == ParamSetCache::Result::Changed) {
+        stats_.on_param_sets_changed();
+    } else if (ps == ParamSetCache::Result::Unchanged && config_->output.param_sets == "on_join") {
+        mask |= kParamSetNals;
+    }
+    GstSample* out = gst_sample_ref(sample);
+    if (mask && has_nal_units(*au, mask)) {
+        uint64_t removed[32];
+        GstBuffer* stripped = strip_nal_units(buf, *au, mask, removed);
+        gst_sample_unref(out);
+        out = gst_sample_new(stripped, gst_sample_get_caps(sample), NULL, NULL);
+        gst_buffer_unref(stripped);
+        uint64_t ps_bytes = removed[NAL_SPS] + removed[NAL_PPS];
+        if (ps_bytes) stats_.on_param_sets_stripped(ps_bytes, clients_.load());
+        for (uint8_t t : {NAL_AUD, NAL_SEI, NAL_FILLER}) {
+            if (removed[t]) stats_.on_nal_stripped(t, removed[t]);
+        }
+    }
+    gst_buffer_unmap(buf, &map);
+    fanout_.publish(out, tid, keyframe);
+    gst_sample_unref(out);
+    if (startup_) startup_->on_first_frame();
+}
+
+/// The encoder (re)negotiated: keep the caps for new clients' appsrc; the
+/// feeders of connected ones pick them up from the next sample.
+void Pipeline::on_output_caps(GstCaps* caps) {
+    gst_caps_replace(&out_caps_, caps);
+    gchar* str = gst_caps_to_string(caps);
+    {
+        std::lock_guard<std::mutex> lock(caps_mutex_);
+        caps_string_ = str;
+    }
+    has_caps_.store(true);
+    std::cout << "[SERVER] Output caps: " << str << std::endl;
+    g_free(str);
+}
+
+GstBuffer* Pipeline::join_buffer(GstBuffer* keyframe) {
+    if (config_->output.param_sets != "on_join") return gst_buffer_copy(keyframe);
+    std::vector<uint8_t> sets = param_sets_.annexb();
+    if (!sets.empty()) stats_.on_param_sets_injected(sets.size());
+    return prepend_param_sets(keyframe, sets);
+}
+
+/// Server reader thread: an access unit from the worker. Takes the place of
+/// the encoded-buffer probe and appsink callback of a single process.
+void Pipeline::on_worker_frame(GstSample* sample, bool keyframe) {
+    GstBuffer* buf = gst_sample_get_buffer(sample);
+    size_t size = gst_buffer_get_size(buf);
+    stats_.on_frame_encoded(size, keyframe);
+
+    if (config_->gop.adaptive) {
+        if (gop_.on_frame(keyframe)) request_idr();
+        if (keyframe) {
+            int64_t ms = gop_.take_pli_to_idr_ms();
+            if (ms >= 0) stats_.on_pli_answered(ms);
+        }
+    }
+    RecoveryMeter::Result rec;
+    if (recovery_.on_frame(size, keyframe, rec)) {
+        stats_.on_recovery(recovery_mode_name(recovery_mode_), rec.duration_ms, rec.excess_bytes, rec.peak_ratio);
+    }
+
+    GstSample* out = splice_sample(sample, keyframe);
+    if (out) {
+        publish_output(out, keyframe);
+        gst_sample_unref(out);
+    }
+}
+
+void Pipeline::request_idr() {
+    if (worker_) worker_->request_idr();
+    else encoder_.force_idr();
+}
+
+/// New media (client thread): its DESCRIBE waits for the feeder's first
+/// IDR, so with a long adaptive GOP ask for one now rather than at PLAY.
+std::shared_ptr<FanOutSubscriber> Pipeline::subscribe() {
+    auto sub = fanout_.subscribe();
+    if (config_->gop.adaptive && gop_.on_client_play()) request_idr();
+    return sub;
 }
 
 std::string Pipeline::get_caps_string() const {
-    std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(mutex_));
+    std::lock_guard<std::mutex> lock(caps_mutex_);
     return caps_string_;
 }
 
@@ -341,31 +1400,113 @@ std::string Pipeline::get_caps_string() const {
 //  RTSP Server
 // ============================================================================
 
-bool Pipeline::start_rtsp_server() {
-    rtsp_server_ = gst_rtsp_server_new();
-    if (!rtsp_server_) return false;
+bool Pipeline::start_rtsp_server(int listen_fd) {
+    if (listen_fd < 0) listen_fd = open_rtsp_listen_socket(config_->output.port);
+    if (listen_fd < 0) return false;
+    GError* err = nullptr;
+    listen_socket_ = g_socket_new_from_fd(listen_fd, &err);
+    if (!listen_socket_) {
+        std::cerr << "[SERVER] " << (err ? err->message : "bad listening socket") << std::endl;
+        if (err) g_error_free(err);
+        close(listen_fd);
+        return false;
+    }
+    g_socket_set_blocking(listen_socket_, FALSE);
 
-    char port[16];
-    snprintf(port, sizeof(port), "%d", config_.output.port);
-    gst_rtsp_server_set_service(rtsp_server_, port);
+    rtsp_server_ = gst_rtsp_server_new();
+    if (!rtsp_server_) {
+        g_object_unref(listen_socket_); listen_socket_ = nullptr;
+        return false;
+    }
 
+    // Temporal layering needs one media (and fan-out subscriber) per client
     GstRTSPMediaFactory* factory = encoder_factory_new(this);
+    gst_rtsp_media_factory_set_shared(factory, config_->svc.temporal_layers < 2);
+    g_signal_connect(factory, "media-configure", G_CALLBACK(Pipeline::on_media_configure), this);
+    g_signal_connect(rtsp_server_, "client-connected", G_CALLBACK(Pipeline::on_client_connected), this);
     GstRTSPMountPoints* mounts = gst_rtsp_server_get_mount_points(rtsp_server_);
-    gst_rtsp_mount_points_add_factory(mounts, config_.output.path.c_str(), factory);
+    gst_rtsp_mount_points_add_factory(mounts, config_->output.path.c_str(), factory);
     g_object_unref(mounts);
 
-    server_source_id_ = gst_rtsp_server_attach(rtsp_server_, NULL);
-    if (server_source_id_ == 0) {
-        g_object_unref(rtsp_server_); rtsp_server_ = nullptr;
-        return false;
+    // Clients spread over up to output.workers threads, each with its own
+    // context (round robin once all exist); 0 keeps them on the server thread
+    GstRTSPThreadPool* pool = gst_rtsp_server_get_thread_pool(rtsp_server_);
+    gst_rtsp_thread_pool_set_max_threads(pool, config_->output.workers);
+    g_signal_connect(pool, "thread-enter", G_CALLBACK(Pipeline::on_pool_thread_enter), this);
+    g_signal_connect(pool, "thread-leave", G_CALLBACK(Pipeline::on_pool_thread_leave), this);
+    g_object_unref(pool);
+
+    server_context_ = g_main_context_new();
+    server_loop_ = g_main_loop_new(server_context_, FALSE);
+
+    accept_source_ = g_socket_create_source(listen_socket_, G_IO_IN, NULL);
+    g_source_set_callback(accept_source_, G_SOURCE_FUNC(Pipeline::on_rtsp_accept), this, NULL);
+    g_source_attach(accept_source_, server_context_);
+
+    // Sessions of clients that vanished without TEARDOWN (UDP) time out
+    GstRTSPSessionPool* sessions = gst_rtsp_server_get_session_pool(rtsp_server_);
+    GSource* cleanup = gst_rtsp_session_pool_create_watch(sessions);
+    g_source_set_callback(cleanup, G_SOURCE_FUNC(Pipeline::on_session_timeout), NULL, NULL);
+    g_source_attach(cleanup, server_context_);
+    g_source_unref(cleanup);
+    g_object_unref(sessions);
+
+    GMainContext* context = server_context_;
+    GMainLoop* loop = server_loop_;
+    server_thread_ = std::thread([context, loop]() {
+        thread_role_enter(ThreadRole::Serving);
+        // Thread default, so connections transferred from here (and, with
+        // no workers, their clients) attach to this context
+        g_main_context_push_thread_default(context);
+        g_main_loop_run(loop);
+        g_main_context_pop_thread_default(context);
+        thread_role_leave();
+    });
+
+    std::cout << "[SERVER] rtsp://localhost:" << config_->output.port
+              << config_->output.path << " (" << config_->output.workers << " client thread"
+              << (config_->output.workers == 1 ? "" : "s") << ")" << std::endl;
+    return true;
+}
+
+void Pipeline::on_pool_thread_enter(GstRTSPThreadPool*, GstRTSPThread*, gpointer) {
+    thread_role_enter(ThreadRole::Serving);
+}
+
+void Pipeline::on_pool_thread_leave(GstRTSPThreadPool*, GstRTSPThread*, gpointer) {
+    thread_role_leave();
+}
+
+gboolean Pipeline::on_session_timeout(GstRTSPSessionPool* pool, gpointer) {
+    gst_rtsp_session_pool_cleanup(pool);
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean Pipeline::on_rtsp_accept(GSocket* socket, GIOCondition, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    GSocket* client = g_socket_accept(socket, NULL, NULL);
+    if (!client) return G_SOURCE_CONTINUE;
+
+    gchar* ip = nullptr;
+    guint16 port = 0;
+    GSocketAddress* addr = g_socket_get_remote_address(client, NULL);
+    if (addr && G_IS_INET_SOCKET_ADDRESS(addr)) {
+        GInetSocketAddress* inet = G_INET_SOCKET_ADDRESS(addr);
+        ip = g_inet_address_to_string(g_inet_socket_address_get_address(inet));
+        port = g_inet_socket_address_get_port(inet);
     }
+    if (addr) g_object_unref(addr);
 
-    std::cout << "[SERVER] rtsp://localhost:" << config_.output.port
-              << config_.output.path << std::endl;
-    return true;
+    // Takes the socket; emits client-connected like the built-in accept loop
+    if (!gst_rtsp_server_transfer_connection(self->rtsp_server_, client, ip ? ip : "0.0.0.0", port, NULL)) {
+        std::cerr << "[SERVER] Could not set up connection from " << (ip ? ip : "?") << std::endl;
+    }
+    g_free(ip);
+    return G_SOURCE_CONTINUE;
 }
 
 void Pipeline::stop_encoder() {
+    encoder_.release();
     if (enc_pipeline_) {
         gst_element_set_state(enc_pipeline_, GST_STATE_NULL);
         if (enc_bus_) { gst_bus_remove_watch(enc_bus_); gst_object_unref(enc_bus_); enc_bus_ = nullptr; }
@@ -374,9 +1515,192 @@ void Pipeline::stop_encoder() {
     }
 }
 
+/// Any thread: the source holds its own ref on the socket, so an accept
+/// already dispatching on the server thread finishes safely.
+void Pipeline::stop_accepting() {
+    if (accept_source_) {
+        g_source_destroy(accept_source_);
+        g_source_unref(accept_source_);
+        accept_source_ = nullptr;
+    }
+}
+
 void Pipeline::stop_rtsp_server() {
-    if (server_source_id_) { g_source_remove(server_source_id_); server_source_id_ = 0; }
+    stop_accepting();
+    if (rtsp_server_) {
+        // Sessions run on pool threads with us as callback data: close them all
+        GList* kept = gst_rtsp_server_client_filter(rtsp_server_,
+            [](GstRTSPServer*, GstRTSPClient*, gpointer) { return GST_RTSP_FILTER_REMOVE; }, nullptr);
+        g_list_free_full(kept, g_object_unref);
+    }
+    if (server_loop_) {
+        // Queued on the loop itself: a quit before it started running would be lost
+        GSource* quit = g_idle_source_new();
+        g_source_set_callback(quit, [](gpointer loop) -> gboolean {
+            g_main_loop_quit(static_cast<GMainLoop*>(loop));
+            return G_SOURCE_REMOVE;
+        }, server_loop_, NULL);
+        g_source_attach(quit, server_context_);
+        g_source_unref(quit);
+        if (server_thread_.joinable()) server_thread_.join();
+        g_main_loop_unref(server_loop_);
+        server_loop_ = nullptr;
+    }
     if (rtsp_server_) { g_object_unref(rtsp_server_); rtsp_server_ = nullptr; }
+    if (server_context_) { g_main_context_unref(server_context_); server_context_ = nullptr; }
+    if (listen_socket_) { g_object_unref(listen_socket_); listen_socket_ = nullptr; }
+}
+
+// ============================================================================
+//  Upgrade hand-off
+// ============================================================================
+
+/// New binary: the predecessor's listening socket, or -1 to bind the port.
+/// Its last GOP becomes the fan-out's bridge until our first IDR.
+int Pipeline::take_over_socket() {
+    const std::string& path = config_->upgrade.socket;
+    auto t0 = std::chrono::steady_clock::now();
+    int fd = -1;
+    std::vector<GstSample*> gop;
+    if (path.empty() || !upgrade_request(path, fd, gop)) {
+        std::cerr << "[UPGRADE] No running instance at " << (path.empty() ? "(off)" : path)
+                  << ", binding the port" << std::endl;
+        return -1;
+    }
+    size_t bytes = 0;
+    for (GstSample* s : gop) bytes += gst_buffer_get_size(gst_sample_get_buffer(s));
+    size_t frames = gop.size();
+    fanout_.adopt_gop(std::move(gop));
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[UPGRADE] Took over in " << ms << " ms (listening socket + " << frames
+              << " frames, " << bytes / 1024 << " KB)" << std::endl;
+    return fd;
+}
+
+void Pipeline::start_upgrade_listener() {
+    upgrade_path_ = config_->upgrade.socket;
+    if (upgrade_path_.empty() || upgrade_fd_ >= 0) return;
+    upgrade_fd_ = upgrade_listen(upgrade_path_);
+    if (upgrade_fd_ < 0) return;
+    upgrade_source_id_ = g_unix_fd_add(upgrade_fd_, G_IO_IN, Pipeline::on_upgrade_request, this);
+}
+
+void Pipeline::stop_upgrade_listener(bool unlink_path) {
+    if (upgrade_source_id_) { g_source_remove(upgrade_source_id_); upgrade_source_id_ = 0; }
+    // A hand-off in flight finishes (bounded by its socket timeouts) and its
+    // result is dropped: the listener it would re-arm is going away
+    if (upgrade_thread_.joinable()) upgrade_thread_.join();
+    if (upgrade_done_) {
+        g_source_destroy(upgrade_done_);
+        g_source_unref(upgrade_done_);
+        upgrade_done_ = nullptr;
+    }
+    if (upgrade_fd_ >= 0) {
+        close(upgrade_fd_);
+        upgrade_fd_ = -1;
+        if (unlink_path) unlink(upgrade_path_.c_str());
+    }
+}
+
+/// Old binary: a successor asks for the socket. The GOP is collected here
+/// and sent from upgrade_thread_, so the blocking socket I/O never holds up
+/// the main loop; one hand-off at a time, the watch is re-armed if it fails.
+gboolean Pipeline::on_upgrade_request(gint fd, GIOCondition, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    int conn = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn < 0) return G_SOURCE_CONTINUE;
+    // Its own descriptor for the listening socket: a reload may drop
+    // listen_socket_ while the send is in flight
+    int listen_fd = self->listen_socket_
+        ? fcntl(g_socket_get_fd(self->listen_socket_), F_DUPFD_CLOEXEC, 0) : -1;
+    if (listen_fd < 0) {
+        close(conn);
+        std::cerr << "[UPGRADE] Hand-off failed, still serving" << std::endl;
+        return G_SOURCE_CONTINUE;
+    }
+
+    self->upgrade_started_ = std::chrono::steady_clock::now();
+    std::vector<GstSample*> gop = self->fanout_.current_gop();
+    if (!gop.empty() && self->config_->output.param_sets == "on_join") {
+        // The successor's cache starts empty: its bridge carries them in-band
+        GstBuffer* first = prepend_param_sets(gst_sample_get_buffer(gop[0]), self->param_sets_.annexb());
+        GstSample* primed = gst_sample_new(first, gst_sample_get_caps(gop[0]), NULL, NULL);
+        gst_buffer_unref(first);
+        gst_sample_unref(gop[0]);
+        gop[0] = primed;
+    }
+    self->upgrade_bytes_ = 0;
+    for (GstSample* s : gop) self->upgrade_bytes_ += gst_buffer_get_size(gst_sample_get_buffer(s));
+    self->upgrade_frames_ = gop.size();
+
+    if (self->upgrade_thread_.joinable()) self->upgrade_thread_.join();
+    self->upgrade_thread_ = std::thread([self, conn, listen_fd, gop]() {
+        bool ok = upgrade_send(conn, listen_fd, gop);
+        close(conn);
+        close(listen_fd);
+        for (GstSample* s : gop) gst_sample_unref(s);
+        self->upgrade_ok_.store(ok);
+        GSource* done = g_idle_source_new();
+        g_source_set_callback(done, Pipeline::on_upgrade_sent, self, NULL);
+        self->upgrade_done_ = done;
+        g_source_attach(done, NULL);
+    });
+    self->upgrade_source_id_ = 0;
+    return G_SOURCE_REMOVE;
+}
+
+/// Old binary, main loop: the hand-off finished. Once the successor has the
+/// socket this process stops accepting (pending connections wait in the
+/// shared backlog for the successor) and drains.
+gboolean Pipeline::on_upgrade_sent(gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    if (self->upgrade_thread_.joinable()) self->upgrade_thread_.join();
+    g_source_unref(self->upgrade_done_);
+    self->upgrade_done_ = nullptr;
+    if (!self->upgrade_ok_.load()) {
+        std::cerr << "[UPGRADE] Hand-off failed, still serving" << std::endl;
+        if (self->upgrade_fd_ >= 0) {
+            self->upgrade_source_id_ = g_unix_fd_add(self->upgrade_fd_, G_IO_IN,
+                                                     Pipeline::on_upgrade_request, self);
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - self->upgrade_started_).count();
+    std::cout << "[UPGRADE] Handed over in " << ms << " ms (" << self->upgrade_frames_ << " frames, "
+              << self->upgrade_bytes_ / 1024 << " KB); draining " << self->clients_.load()
+              << " client(s) for up to " << self->config_->upgrade.drain_s << " s" << std::endl;
+
+    // The successor owns the socket and the path now
+    self->stop_accepting();
+    if (self->listen_socket_) { g_object_unref(self->listen_socket_); self->listen_socket_ = nullptr; }
+    self->stop_upgrade_listener(false);
+    self->handed_over_ = true;
+    self->handed_over_at_ = std::chrono::steady_clock::now();
+    self->drain_source_id_ = g_timeout_add(250, Pipeline::on_drain_tick, self);
+    return G_SOURCE_REMOVE;
+}
+
+/// Old binary: existing sessions keep playing here until they leave or
+/// `upgrade.drain_s` runs out; the rest are closed and reconnect to the successor.
+gboolean Pipeline::on_drain_tick(gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    int clients = self->clients_.load();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - self->handed_over_at_).count();
+    if (clients > 0 && ms < (int64_t)self->config_->upgrade.drain_s * 1000) return G_SOURCE_CONTINUE;
+
+    if (clients > 0 && self->rtsp_server_) {
+        GList* kept = gst_rtsp_server_client_filter(self->rtsp_server_,
+            [](GstRTSPServer*, GstRTSPClient*, gpointer) { return GST_RTSP_FILTER_REMOVE; }, nullptr);
+        g_list_free_full(kept, g_object_unref);
+    }
+    std::cout << "[UPGRADE] Drained after " << ms << " ms, closed " << clients << " client(s)" << std::endl;
+    self->drain_source_id_ = 0;
+    self->retired_.store(true);
+    return G_SOURCE_REMOVE;
 }
 
 // ============================================================================
@@ -407,6 +1731,409 @@ void Pipeline::on_pad_added(GstElement*, GstPad* pad, gpointer data) {
     gst_caps_unref(caps);
 }
 
+// RTCP feedback (PLI/FIR, receiver-report loss) from every client's RTP session
+
+#define RTCP_TYPE_PSFB     206
+#define RTCP_PSFB_TYPE_PLI 1
+#define RTCP_PSFB_TYPE_FIR 4
+
+void Pipeline::on_media_configure(GstRTSPMediaFactory*, GstRTSPMedia* media, gpointer data) {
+    g_signal_connect(media, "prepared", G_CALLBACK(Pipeline::on_media_prepared), data);
+
+    // The media's pipeline exists by now (the bin is in it); its task
+    // threads start on prepare
+    GstElement* bin = gst_rtsp_media_get_element(media);
+    if (bin) {
+        GstObject* media_pipeline = gst_object_get_parent(GST_OBJECT(bin));
+        if (media_pipeline) {
+            GstBus* bus = gst_element_get_bus(GST_ELEMENT(media_pipeline));
+            thread_roles_watch_bus(bus, ThreadRole::Serving);
+            gst_object_unref(bus);
+            gst_object_unref(media_pipeline);
+        }
+        gst_object_unref(bin);
+    }
+}
+
+void Pipeline::on_media_prepared(GstRTSPMedia* media, gpointer data) {
+    // The media's fan-out subscriber, so receiver reports can steer its layer cut
+    std::shared_ptr<FanOutSubscriber> sub;
+    GstElement* bin = gst_rtsp_media_get_element(media);
+    if (bin) {
+        auto* p = static_cast<std::shared_ptr<FanOutSubscriber>*>(
+            g_object_get_data(G_OBJECT(bin), "fanout-subscriber"));
+        if (p) sub = *p;
+        gst_object_unref(bin);
+    }
+
+    for (guint i = 0; i < gst_rtsp_media_n_streams(media); i++) {
+        GstRTSPStream* stream = gst_rtsp_media_get_stream(media, i);
+        GObject* session = gst_rtsp_stream_get_rtpsession(stream);
+        if (!session) continue;
+        if (sub) {
+            g_object_set_data_full(session, "fanout-subscriber",
+                new std::shared_ptr<FanOutSubscriber>(sub),
+                [](gpointer p) { delete static_cast<std::shared_ptr<FanOutSubscriber>*>(p); });
+        }
+        g_signal_connect(session, "on-feedback-rtcp", G_CALLBACK(Pipeline::on_feedback_rtcp), data);
+        g_signal_connect(session, "on-ssrc-active", G_CALLBACK(Pipeline::on_ssrc_active), data);
+        g_object_unref(session);
+    }
+}
+
+void Pipeline::on_feedback_rtcp(GObject*, guint type, guint fbtype, guint, guint,
+                                GstBuffer*, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    if (type != RTCP_TYPE_PSFB) return;
+    if (fbtype != RTCP_PSFB_TYPE_PLI && fbtype != RTCP_PSFB_TYPE_FIR) return;
+    self->on_loss_event();
+}
+
+/// A viewer lost picture (PLI/FIR, or emulated): start timing the recovery
+/// and, in IDR mode, ask for the keyframe.
+void Pipeline::on_loss_event() {
+    recovery_.on_loss();
+    if (config_->gop.adaptive && gop_.on_pli()) request_idr();
+}
+
+/// A client's RTCP arrived: its receiver report about our stream is now in
+/// the session's internal (sender) source stats.
+void Pipeline::on_ssrc_active(GObject* session, GObject*, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    GObject* internal = nullptr;
+    g_object_get(session, "internal-source", &internal, NULL);
+    if (!internal) return;
+
+    GstStructure* st = nullptr;
+    g_object_get(internal, "stats", &st, NULL);
+    g_object_unref(internal);
+    if (!st) return;
+
+    gboolean have_rb = FALSE;
+    guint fraction = 0;
+    if (gst_structure_get_boolean(st, "have-rb", &have_rb) && have_rb &&
+        gst_structure_get_uint(st, "rb-fractionlost", &fraction)) {
+        self->gop_.on_loss_report(fraction / 256.0);
+        auto* sub = static_cast<std::shared_ptr<FanOutSubscriber>*>(
+            g_object_get_data(session, "fanout-subscriber"));
+        if (sub) (*sub)->on_loss_report(fraction / 256.0);
+    }
+    gst_structure_free(st);
+}
+
+void Pipeline::on_client_connected(GstRTSPServer*, GstRTSPClient* client, gpointer data) {
+    g_signal_connect(client, "closed", G_CALLBACK(Pipeline::on_client_closed), data);
+    g_signal_connect(client, "describe-request", G_CALLBACK(Pipeline::on_describe_request), data);
+    g_signal_connect(client, "pre-setup-request", G_CALLBACK(Pipeline::on_pre_setup_request), data);
+    g_signal_connect(client, "play-request", G_CALLBACK(Pipeline::on_play_request), data);
+}
+
+void Pipeline::on_client_closed(GstRTSPClient* client, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    if (self->admission_.release(client)) self->clients_.fetch_sub(1);
+}
+
+/// Client thread: DESCRIBE blocks until the media prerolls on an encoded
+/// IDR, so an idle pipeline has to come back here, before any SETUP.
+void Pipeline::on_describe_request(GstRTSPClient*, GstRTSPContext*, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    if (self->state_.load() == PipelineState::Idle) self->wake();
+}
+
+/// Client thread: the session reserves its egress before any transport is
+/// set up, so a refused one never starts a stream. Only an admitted client
+/// counts as a viewer and keeps the pipeline out of Idle.
+GstRTSPStatusCode Pipeline::on_pre_setup_request(GstRTSPClient* client, GstRTSPContext*, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    GstRTSPConnection* conn = gst_rtsp_client_get_connection(client);
+    const gchar* ip = conn ? gst_rtsp_connection_get_ip(conn) : nullptr;
+    std::string addr = ip ? ip : "?";
+
+    AdmissionControl::Decision d = self->admission_.admit(client, addr);
+    const AdmissionConfig& ac = self->config_->admission;
+    if (!d.admitted) {
+        std::cerr << "[ADMIT] Refused " << addr << ": egress budget " << ac.budget_kbps
+                  << " kbps reached (" << d.reserved << " kbps reserved)" << std::endl;
+        return GST_RTSP_STS_NOT_ENOUGH_BANDWIDTH;
+    }
+    if (d.first) self->clients_.fetch_add(1);
+    if (ac.enabled) {
+        std::cout << "[ADMIT] " << addr << ": " << egress_class_name(d.cls) << " (" << d.kbps << " kbps, "
+                  << d.reserved << "/" << ac.budget_kbps << " kbps reserved)" << std::endl;
+    }
+    return GST_RTSP_STS_OK;
+}
+
+/// A viewer joining a shared media that is already running: don't make it
+/// wait up to a full (long) GOP for its first picture (a new media got its
+/// IDR in subscribe()). A downgraded session gets only the base layer from
+/// here on.
+void Pipeline::on_play_request(GstRTSPClient* client, GstRTSPContext* ctx, gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    EgressClass cls;
+    if (ctx && ctx->media && self->admission_.lookup(client, cls) && cls == EgressClass::Reduced) {
+        GstElement* bin = gst_rtsp_media_get_element(ctx->media);
+        if (bin) {
+            auto* sub = static_cast<std::shared_ptr<FanOutSubscriber>*>(
+                g_object_get_data(G_OBJECT(bin), "fanout-subscriber"));
+            if (sub) (*sub)->cap_layers(0);
+            gst_object_unref(bin);
+        }
+    }
+    bool shared = self->config_->svc.temporal_layers < 2;
+    if (shared && self->config_->gop.adaptive && self->gop_.on_client_play()) self->request_idr();
+}
+
+/// Smallest encoder target change worth making for filler headroom.
+static constexpr double kHeadroomStepKbps = 25.0;
+
+/// CBR pads every frame up to the target with filler, which the output
+/// strips: bitrate the uplink has room for and the picture did not get.
+/// Each tick (1 s) the boost is regulated on the wire rate (encoded minus
+/// stripped filler) against the target: it comes down by the full overshoot
+/// as soon as the wire goes over the target, and rises halfway towards it
+/// only while the encoder turns the previous raise into picture bits. A
+/// simple scene that leaves the target unused therefore builds no boost that
+/// the next complex scene could send. Never past the peak bitrate. Main loop.
+void Pipeline::update_filler_headroom() {
+    uint64_t bytes = wire_bytes_.exchange(0);
+    const AppConfig& cfg = config_.get();
+    if (!cfg.output.filler_headroom && filler_boost_kbps_ == 0.0) return;
+    uint32_t target = cfg.encoder.target_bitrate_kbps;
+    uint32_t peak = cfg.encoder.max_bitrate_kbps;
+    double boost = 0.0;
+    if (cfg.output.filler_headroom) {
+        double wire_kbps = bytes * 8.0 / 1000.0;
+        double step = 0.0;
+        if (wire_kbps > target) {
+            step = target - wire_kbps;
+        } else if (filler_step_kbps_ > 0.0 && wire_kbps - filler_wire_kbps_ < 0.5 * filler_step_kbps_) {
+            step = -filler_step_kbps_;    // the last raise went to filler: take it back
+        } else {
+            step = 0.5 * (target - wire_kbps);
+        }
+        boost = filler_boost_kbps_ + step;
+        boost = std::max(0.0, std::min(boost, (double)(peak > target ? peak - target : 0)));
+        filler_step_kbps_ = boost - filler_boost_kbps_;
+        filler_wire_kbps_ = wire_kbps;
+    } else {
+        filler_step_kbps_ = 0.0;
+    }
+    filler_boost_kbps_ = boost;
+    if (state_.load() != PipelineState::Playing) return;
+
+    uint32_t want = target + (uint32_t)boost;
+    uint32_t have = encoder_.get_target_bitrate_kbps() / frame_divisor_.load();
+    if (std::fabs((double)want - have) < kHeadroomStepKbps && !(boost == 0.0 && have != target)) return;
+    apply_bitrate(want, peak);
+    stats_.on_filler_headroom((int64_t)boost);
+}
+
+// ============================================================================
+//  Thermal governor
+// ============================================================================
+
+void Pipeline::update_thermal() {
+    if (thermal_.tick()) apply_quality(thermal_.quality());
+}
+
+/// Apply a governor level (main loop). Frame rate and size change in
+/// place; a preset change needs a new encoder, which also takes the size.
+void Pipeline::apply_quality(const QualityLevel& next) {
+    QualityLevel prev = quality_;
+    if (next == prev) return;
+    quality_ = next;
+
+    if (next.fps_divisor != prev.fps_divisor) {
+        // A fixed GOP in frames now lasts fps_divisor times as long
+        frame_divisor_.store(next.fps_divisor);
+        stall_.reset();   // relearn the frame cadence
+        apply_bitrate(config_->encoder.target_bitrate_kbps + (uint32_t)filler_boost_kbps_,
+                      config_->encoder.max_bitrate_kbps);
+    }
+    // Compared as NVENC presets: "UltraLowLatency" and "ultrafast" are one
+    std::string preset = faster_preset(config_->encoder.preset, next.preset_steps);
+    if (preset_speed_rank(preset) != preset_speed_rank(faster_preset(config_->encoder.preset, prev.preset_steps)) &&
+        enc_pipeline_) {
+        if (state_.load() == PipelineState::Idle) {
+            if (!torn_down_) tear_down_idle();   // rebuilt with it on resume
+        } else {
+            schedule_restart("thermal: preset " + preset, RestartTier::Full, "");
+        }
+        return;
+    }
+    if (next.scale != prev.scale) {
+        if (!set_encoder_input_size()) {
+            schedule_restart("thermal: renegotiation failed", RestartTier::Full, "");
+            return;
+        }
+        int width, height;
+        encoder_input_size(width, height);
+        std::cout << "[THERMAL] Encoder input " << width << "x" << height << ", 1/" << next.fps_divisor
+                  << " of the frames, preset " << preset
+                  << std::endl;
+    }
+}
+
+// ============================================================================
+//  On-demand encoding
+// ============================================================================
+
+/// Once per control tick: go idle after `idle.pause_s` without clients,
+/// tear down after `teardown_s` more; resume if clients are back or idling
+/// was switched off (the connect path normally wakes us first).
+void Pipeline::update_idle() {
+    const IdleConfig& ic = config_->idle;
+    if (ic.enabled) sample_idle_cost();
+    PipelineState st = state_.load();
+    int clients = clients_.load();
+
+    if (st == PipelineState::Idle) {
+        if (!ic.enabled || clients > 0) {
+            resume_from_idle(clients > 0 ? "client connected" : "idle disabled");
+            return;
+        }
+        if (!torn_down_ && ic.teardown_s > 0 && ++idle_ticks_ >= ic.teardown_s) tear_down_idle();
+        return;
+    }
+    if (!ic.enabled || clients > 0 || (st != PipelineState::Playing && st != PipelineState::Degraded)) {
+        idle_ticks_ = 0;
+        return;
+    }
+    if (++idle_ticks_ >= ic.pause_s) enter_idle();
+}
+
+/// Process CPU time and board power since the previous tick, booked to
+/// the state we were in (active or idle) for the `idle` stats line.
+void Pipeline::sample_idle_cost() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    int64_t cpu_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    auto now = std::chrono::steady_clock::now();
+    bool idle = state_.load() == PipelineState::Idle;
+    if (cost_sampled_) {
+        double mw = -1.0;
+        if (power_.available() && !power_.read_mw(mw)) mw = -1.0;
+        stats_.on_idle_sample(cost_was_idle_, std::chrono::duration<double>(now - cost_at_).count(),
+                              (cpu_ns - cost_cpu_ns_) / 1e9, mw);
+    }
+    cost_sampled_ = true;
+    cost_was_idle_ = idle;
+    cost_cpu_ns_ = cpu_ns;
+    cost_at_ = now;
+}
+
+void Pipeline::open_power_meter() {
+    const IdleConfig& ic = config_->idle;
+    if (!power_.open(ic.power_voltage, ic.power_current) && !ic.power_voltage.empty()) {
+        std::cerr << "[IDLE] No power sensor at " << ic.power_voltage << " / " << ic.power_current
+                  << "; reporting CPU only" << std::endl;
+    }
+}
+
+/// No consumers: stop feeding the decoder; the camera stays connected and
+/// its current GOP is kept for the resume.
+void Pipeline::enter_idle() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& gate : gates_) gate->close();
+    }
+    encode_paused_.store(true);
+    idle_ticks_ = 0;
+    torn_down_ = false;
+    resume_started_ns_.store(0);
+    stall_.reset();   // no frames from here on is not a stall
+    transition(PipelineState::Idle, "no clients for " + std::to_string(config_->idle.pause_s) +
+                                    "s, decode paused");
+}
+
+/// Idle for `idle.teardown_s` as well: close the camera and free the
+/// decoder, converter and encoder. Clients that come back start on the old
+/// timeline, as after a full restart.
+void Pipeline::tear_down_idle() {
+    if (GST_CLOCK_TIME_IS_VALID(last_out_pts_.load())) splice_pending_.store(true);
+    stop_encoder();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        gates_.clear();
+    }
+    torn_down_ = true;
+    std::cout << "[IDLE] " << wall_clock_string() << " Paused for " << config_->idle.teardown_s
+              << "s: encoder pipeline torn down" << std::endl;
+}
+
+/// Client thread, on a DESCRIBE while Idle: open the gates at
+/// once (the decoder starts on the cached GOP with the next camera frame)
+/// and let the main loop do the rest.
+void Pipeline::wake() {
+    int64_t none = 0;
+    if (!resume_started_ns_.compare_exchange_strong(none, monotonic_ns())) return;   // already waking
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& gate : gates_) gate->open();
+    }
+    encode_paused_.store(false);
+    g_idle_add_full(G_PRIORITY_HIGH, Pipeline::on_wake, this, nullptr);
+}
+
+gboolean Pipeline::on_wake(gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    if (self->running_.load()) self->resume_from_idle("client DESCRIBE");
+    return G_SOURCE_REMOVE;
+}
+
+void Pipeline::resume_from_idle(const std::string& reason) {
+    if (state_.load() != PipelineState::Idle) return;
+    bool torn_down = torn_down_;
+    torn_down_ = false;
+    idle_ticks_ = 0;
+    resume_from_teardown_.store(torn_down);
+    encode_paused_.store(false);
+    int64_t none = 0;
+    resume_started_ns_.compare_exchange_strong(none, monotonic_ns());
+    stats_.reset();
+    stall_.reset();
+
+    if (torn_down) {
+        bool ok = build_encoder_pipeline() &&
+                  gst_element_set_state(enc_pipeline_, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE;
+        if (!ok) {
+            schedule_restart("resume failed", RestartTier::Full, "");
+            return;
+        }
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& gate : gates_) gate->open();
+        }
+        // NVENC stopped mid-GOP: the first frame after the gap must stand alone
+        request_idr();
+    }
+    transition(PipelineState::Connecting, reason);
+}
+
+gboolean Pipeline::on_control_tick(gpointer data) {
+    Pipeline* self = static_cast<Pipeline*>(data);
+    if (self->ring_) self->ring_->heartbeat();
+    self->check_liveness();
+    if (self->config_->gop.adaptive) {
+        int clients = self->clients_.load();
+        self->gop_.tick(clients);
+        self->stats_.on_gop_update(self->gop_.gop_frames(), self->gop_.loss_ewma(),
+                                   self->gop_.pli_rate(), clients);
+    }
+    if (self->role_ != PipelineRole::Server) self->update_filler_headroom();
+    if (self->role_ != PipelineRole::Server) self->update_thermal();
+    if (self->role_ == PipelineRole::Single) self->update_idle();
+    int every = self->config_->recovery.emulate_loss_interval_s;
+    if (every > 0 && ++self->loss_emulation_ticks_ >= every) {
+        self->loss_emulation_ticks_ = 0;
+        std::cout << "[RECOVERY] Emulated loss event" << std::endl;
+        self->on_loss_event();
+    }
+    return G_SOURCE_CONTINUE;
+}
+
 gboolean Pipeline::on_bus_message(GstBus*, GstMessage* msg, gpointer data) {
     Pipeline* self = static_cast<Pipeline*>(data);
     switch (GST_MESSAGE_TYPE(msg)) {
@@ -417,11 +2144,16 @@ gboolean Pipeline::on_bus_message(GstBus*, GstMessage* msg, gpointer data) {
             if (dbg) { std::cerr << "[ENC] " << dbg << std::endl; g_free(dbg); }
             if (err) g_error_free(err);
             self->stats_.on_reconnect();
+            std::string suffix;
+            RestartTier tier = self->classify_failure(GST_MESSAGE_SRC(msg), suffix);
+            self->schedule_restart("error in " + std::string(GST_OBJECT_NAME(GST_MESSAGE_SRC(msg))), tier, suffix);
             break;
         }
         case GST_MESSAGE_EOS:
             std::cout << "[ENC] EOS" << std::endl;
             self->stats_.on_reconnect();
+            // Downstream is EOS too; a new rtspsrc alone would not clear that
+            self->schedule_restart("EOS", RestartTier::Full, "");
             break;
         case GST_MESSAGE_STATE_CHANGED:
             if (GST_MESSAGE_SRC(msg) == GST_OBJECT(self->enc_pipeline_)) {
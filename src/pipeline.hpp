@@ -1,71 +1,325 @@
 #pragma once
 
+#include "admission.hpp"
 #include "config.hpp"
+#include "decode_gate.hpp"
+#include "denoise.hpp"
 #include "encoder.hpp"
+#include "fanout.hpp"
+#include "gop_controller.hpp"
+#include "h264.hpp"
+#include "mosaic.hpp"
+#include "param_sets.hpp"
+#include "power_meter.hpp"
+#include "recovery.hpp"
+#include "restart_tier.hpp"
+#include "shm_ring.hpp"
+#include "stall_detector.hpp"
+#include "startup.hpp"
 #include "stats.hpp"
+#include "svc.hpp"
+#include "thermal_governor.hpp"
+#include "worker_process.hpp"
 
+#include <gio/gio.h>
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
 #include <gst/app/gstappsrc.h>
 #include <gst/rtsp-server/rtsp-server.h>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 /// RTSP Re-encoder pipeline for Jetson Orin NX.
 ///
 /// Encoder pipeline (always running):
 ///   rtspsrc → rtph264depay → h264parse → nvv4l2decoder → nvvidconv
-///   → nvv4l2h264enc (CBR) → h264parse → appsink
+///   → nvv4l2h264enc (CBR) → appsink
+///
+/// Each encoded access unit is scanned once at the appsink (h264.hpp) and
+/// the result rides on the buffer (au_meta.hpp) for every consumer.
+///
+/// IDR timing is owned by GopController (loss/PLI/client driven) unless
+/// `gop.adaptive` is off; RTCP feedback is tapped from each media's RTP session.
+///
+/// Loss recovery is IDR or encoder intra refresh (`recovery.mode`, see
+/// recovery.hpp); each recovery is timed and costed for the stats line.
+///
+/// Denoise mode splits conv → enc into conv → NV12 (system memory) →
+/// CPU temporal filter → nvvidconv → NVMM → enc (see denoise.hpp).
+///
+/// Mosaic mode replaces the single source chain with N chains feeding
+/// nvcompositor (see mosaic.hpp); the encoder side is unchanged.
 ///
 /// RTSP Server (on-demand per client):
-///   Custom factory: appsrc → h264parse → rtph264pay (name=pay0)
-///   Feeder thread bridges appsink → appsrc
+///   Custom factory: appsrc → rtph264pay (name=pay0)
+///   appsink → FanOut → one subscriber + feeder thread per media → appsrc
+///
+/// Serving outlives the encoder: on a restart the fan-out keeps every
+/// client's media, output pauses until the new encoder's first IDR and
+/// timestamps continue on the old timeline (first buffer DISCONT).
+///
+/// With `svc.temporal_layers` > 1 each client gets its own media and the
+/// fan-out forwards only the temporal layers that client can take
+/// (see svc.hpp).
+
+/// With `isolation.mode: split` the same class runs in two processes: the
+/// server (RTSP, fan-out, RTCP-driven IDR decisions, splicing) spawns a
+/// worker (encoder only) that publishes into a shared-memory ring
+/// (see shm_ring.hpp, worker_process.hpp).
+///
+/// The RTSP listening socket is our own (not gst_rtsp_server_attach) so it
+/// can be handed to a new binary on upgrade: accepted connections go to the
+/// server with gst_rtsp_server_transfer_connection (see upgrade.hpp).
+
+/// Encoder lifecycle, driven only from the GLib main context:
+///
+///   Building → Connecting → Playing ⇄ Degraded
+///       ↑                      │  error / EOS / watchdog / no first frame
+///       └─────── Backoff ←─────┘
+///   Stopped: stop() or `resilience.max_pipeline_restarts` exhausted.
+///   Idle: `idle.enabled` and no RTSP client for `idle.pause_s`; decoding
+///   is gated off (see decode_gate.hpp) and, after `idle.teardown_s`, the
+///   encoder pipeline is torn down. A connecting client resumes through
+///   Connecting, with an IDR forced for it.
+///
+/// Stalls are caught from frame cadence (see stall_detector.hpp): a soft
+/// stall requests an IDR and marks the state Degraded, a hard one restarts
+/// at the source tier; the seconds-scale watchdog remains as a backstop.
+/// Recovery is tiered (RestartTier): a source failure replaces rtspsrc only,
+/// a decoder failure also flushes the decoder, anything else (or a tier that
+/// didn't bring frames back) rebuilds the whole pipeline.
+/// Waits are GSource timers, never sleeps; every transition is logged
+/// with a wall-clock timestamp and the time spent in the previous state.
+enum class PipelineState { Stopped, Building, Connecting, Playing, Degraded, Backoff, Idle };
+
+/// Which half of the work this process does.
+enum class PipelineRole { Single, Worker, Server };
+
+const char* pipeline_state_name(PipelineState state);
 
 class Pipeline {
 public:
-    Pipeline(const AppConfig& config, Stats& stats);
+    /// `startup` (optional) receives phase timings and the first frame.
+    Pipeline(const AppConfig& config, Stats& stats, StartupTrace* startup = nullptr);
     ~Pipeline();
 
     Pipeline(const Pipeline&) = delete;
     Pipeline& operator=(const Pipeline&) = delete;
 
+    /// Split mode, before start(): encode only and publish into `ring`.
+    void run_as_worker(std::unique_ptr<ShmRing> ring);
+    /// Split mode, before start(): serve only; the encoder runs in a
+    /// supervised worker process reading `config_path`.
+    void run_as_server(const std::string& config_path);
+    /// Upgrade, before start(): inherit the RTSP socket and last GOP from
+    /// the instance listening on `upgrade.socket` instead of binding the port.
+    void take_over() { take_over_ = true; }
+
     bool start();
     void stop();
     bool is_running() const { return running_.load(); }
-    bool watchdog_check();
-    bool restart_encoder();
+    PipelineState state() const { return state_.load(); }
+    /// Restart budget exhausted; the encoder will not come back.
+    bool failed() const { return failed_.load(); }
+    /// Handed over to a successor and drained; the process should exit.
+    bool retired() const { return retired_.load(); }
     void set_bitrate(uint32_t target_kbps, uint32_t max_kbps);
 
-    // Used by RTSP server feeder thread
-    GstSample* pull_latest_sample();
+    /// Apply a reloaded config (main loop): live changes take effect through
+    /// the snapshot, resolution/IDR interval renegotiate in place, anything
+    /// structural swaps the encoder pipeline under connected clients.
+    void reload(const AppConfig& next);
+    const ConfigStore& config() const { return config_; }
+
+    // Used by RTSP server feeder threads
+    std::shared_ptr<FanOutSubscriber> subscribe();
+    void unsubscribe(const std::shared_ptr<FanOutSubscriber>& sub) { fanout_.unsubscribe(sub); }
+    /// The encoder's negotiated output caps (profile, level, size, rate),
+    /// once the first access unit was published; has_caps() until then false.
     std::string get_caps_string() const;
+    StartupTrace* startup() const { return startup_; }
+    /// A client's first IDR: a copy with the cached SPS/PPS in front when
+    /// they travel out of band (`output.param_sets: on_join`).
+    GstBuffer* join_buffer(GstBuffer* keyframe);
     bool has_caps() const { return has_caps_.load(); }
 
 private:
-    AppConfig config_;
+    ConfigStore config_;   // running config; hot paths read the snapshot lock-free
     Stats& stats_;
+    StartupTrace* startup_;
+    PipelineRole role_ = PipelineRole::Single;
+    std::unique_ptr<ShmRing> ring_;            // Worker: output
+    std::unique_ptr<WorkerProcess> worker_;    // Server: the encoder
+    GstCaps* ring_caps_ = nullptr;             // Worker: caps last written to the ring (appsink thread)
+    GstCaps* out_caps_ = nullptr;              // caps last published to the fan-out (publishing thread)
     Encoder encoder_;
+    Mosaic mosaic_;
+    Denoiser denoiser_;
+    H264SliceParser slice_parser_;   // encoded-QP readout, touched only by the appsink streaming thread
+    GopController gop_;
+    RecoveryMeter recovery_;
+    RecoveryMode recovery_mode_ = RecoveryMode::Idr;
+    int loss_emulation_ticks_ = 0;
+    FanOut fanout_;
+    AdmissionControl admission_;
+    StallDetector stall_;
+    ThermalGovernor thermal_;
+    QualityLevel quality_;                  // governor level as applied (main loop)
+    std::atomic<int> frame_divisor_{1};     // encode one in this many converted frames
+    uint64_t converted_frames_ = 0;         // converter-input streaming thread
+    TemporalLayerTagger layer_tagger_{1};   // appsink streaming thread only
+    ParamSetCache param_sets_;              // written by the publishing thread
+    std::atomic<uint64_t> wire_bytes_{0};   // encoded bytes minus CBR filler since the last control tick
+    double filler_boost_kbps_ = 0.0;        // main loop
+    double filler_step_kbps_ = 0.0;         // boost change made on the last tick (main loop)
+    double filler_wire_kbps_ = 0.0;         // wire rate measured on the last tick (main loop)
+
+    // On-demand encoding (main loop unless noted)
+    std::vector<std::shared_ptr<DecodeGate>> gates_;   // one per source chain (guarded by mutex_)
+    bool torn_down_ = false;                // Idle with the encoder pipeline stopped
+    std::atomic<bool> encode_paused_{false};   // Idle: converter input dropped (read by its streaming thread)
+    int idle_ticks_ = 0;                    // control ticks without clients, then since pausing
+    std::atomic<int64_t> resume_started_ns_{0};    // client DESCRIBE that woke us, until the first frame
+    std::atomic<bool> resume_from_teardown_{false};
+    PowerMeter power_;
+    bool cost_sampled_ = false;
+    bool cost_was_idle_ = false;
+    int64_t cost_cpu_ns_ = 0;
+    std::chrono::steady_clock::time_point cost_at_{};
+
+    // Converter-in (PTS, ns) awaiting the matching encoded frame at the appsink
+    std::mutex transit_mutex_;
+    std::deque<std::pair<GstClockTime, int64_t>> transit_;
+
+    // Output timeline across encoder restarts (appsink streaming thread; one
+    // encoder exists at a time, so old and new threads never overlap)
+    std::atomic<bool> splice_pending_{false};
+    int64_t ts_offset_ns_ = 0;
+    std::atomic<GstClockTime> last_out_pts_{GST_CLOCK_TIME_NONE};   // also read by the main loop
+    std::chrono::steady_clock::time_point last_publish_{};
 
     GstElement* enc_pipeline_ = nullptr;
     GstElement* appsink_ = nullptr;
     GstBus* enc_bus_ = nullptr;
 
     GstRTSPServer* rtsp_server_ = nullptr;
-    guint server_source_id_ = 0;
+    GSocket* listen_socket_ = nullptr;
+    // The RTSP server's own sources (accept, session timeouts) run on a
+    // thread of their own; clients on the server's GstRTSPThreadPool. The
+    // main loop keeps the encoder bus watch and the control tick.
+    GMainContext* server_context_ = nullptr;
+    GMainLoop* server_loop_ = nullptr;
+    std::thread server_thread_;
+    GSource* accept_source_ = nullptr;     // on server_context_, watches listen_socket_
+    guint control_source_id_ = 0;
+    std::atomic<int> clients_{0};
 
     std::atomic<bool> running_{false};
+    std::atomic<bool> failed_{false};
+
+    // Upgrade hand-off (main loop)
+    bool take_over_ = false;
+    int upgrade_fd_ = -1;             // listening for a successor
+    std::string upgrade_path_;
+    guint upgrade_source_id_ = 0;
+    std::thread upgrade_thread_;      // sends the hand-off; socket I/O stays off the main loop
+    GSource* upgrade_done_ = nullptr; // posted by upgrade_thread_ when it finishes
+    std::atomic<bool> upgrade_ok_{false};
+    std::chrono::steady_clock::time_point upgrade_started_{};
+    size_t upgrade_frames_ = 0;
+    size_t upgrade_bytes_ = 0;
+    bool handed_over_ = false;
+    guint drain_source_id_ = 0;
+    std::chrono::steady_clock::time_point handed_over_at_{};
+    std::atomic<bool> retired_{false};
+    std::atomic<PipelineState> state_{PipelineState::Stopped};
+    std::chrono::steady_clock::time_point state_since_{};
+    guint backoff_source_id_ = 0;
+    RestartTier pending_tier_ = RestartTier::Full;
+    std::string pending_suffix_;
+    RestartTier escalation_floor_ = RestartTier::Source;
+    std::chrono::steady_clock::time_point restart_started_{};
+    int64_t restart_build_ms_ = 0;
+    std::atomic<bool> awaiting_first_frame_{false};
+    std::atomic<int64_t> restart_first_frame_ns_{0};
     std::atomic<bool> has_caps_{false};
     std::mutex mutex_;
-    std::string caps_string_;
+    // Own lock: written on the appsink thread, which a restart holding mutex_ may flush
+    mutable std::mutex caps_mutex_;
+    std::string caps_string_;   // negotiated encoder caps, as served (guarded by caps_mutex_)
     int reconnect_delay_s_ = 3;
 
     bool build_encoder_pipeline();
-    bool start_rtsp_server();
+    GstElement* make_source(const std::string& url, const std::string& suffix);
+    GstElement* add_source_chain(const std::string& url, const std::string& suffix);
+    bool start_rtsp_server(int listen_fd = -1);
     void stop_encoder();
     void stop_rtsp_server();
+    void stop_accepting();
+    int take_over_socket();
+    void start_upgrade_listener();
+    void stop_upgrade_listener(bool unlink_path);
+    void on_loss_event();
+    void request_idr();
+    void publish_output(GstSample* sample, bool keyframe);
+    void on_worker_frame(GstSample* sample, bool keyframe);
+    void check_worker();
+    bool renegotiate(const AppConfig& prev, const AppConfig& next);
+
+    void transition(PipelineState next, const std::string& reason);
+    void schedule_restart(const std::string& reason, RestartTier tier, const std::string& suffix);
+    RestartTier classify_failure(GstObject* origin, std::string& suffix) const;
+    bool restart_source_chain(RestartTier tier, const std::string& suffix);
+    void check_liveness();
+    void update_filler_headroom();
+    /// Encoder rate for a configured one, compensating the thermal fps step.
+    void apply_bitrate(uint32_t target_kbps, uint32_t peak_kbps);
+    void update_thermal();
+    void apply_quality(const QualityLevel& next);
+    void encoder_input_size(int& width, int& height) const;
+    bool set_encoder_input_size();
+    void update_idle();
+    void sample_idle_cost();
+    void open_power_meter();
+    void enter_idle();
+    void tear_down_idle();
+    void wake();
+    void resume_from_idle(const std::string& reason);
+    static gboolean on_wake(gpointer data);
+    void on_output_caps(GstCaps* caps);
+    void on_stall(StallDetector::Level level, int64_t stalled_ms);
+    static gboolean on_backoff_expired(gpointer data);
+    static gboolean on_rtsp_accept(GSocket* socket, GIOCondition cond, gpointer data);
+    static void on_pool_thread_enter(GstRTSPThreadPool* pool, GstRTSPThread* thread, gpointer data);
+    static void on_pool_thread_leave(GstRTSPThreadPool* pool, GstRTSPThread* thread, gpointer data);
+    static gboolean on_session_timeout(GstRTSPSessionPool* pool, gpointer data);
+    static gboolean on_upgrade_request(gint fd, GIOCondition cond, gpointer data);
+    static gboolean on_upgrade_sent(gpointer data);
+    static gboolean on_drain_tick(gpointer data);
 
     static void on_pad_added(GstElement* src, GstPad* new_pad, gpointer depay);
+    static gboolean on_control_tick(gpointer data);
+    static void on_media_configure(GstRTSPMediaFactory* factory, GstRTSPMedia* media, gpointer data);
+    static void on_media_prepared(GstRTSPMedia* media, gpointer data);
+    static void on_feedback_rtcp(GObject* session, guint type, guint fbtype, guint sender_ssrc,
+                                 guint media_ssrc, GstBuffer* fci, gpointer data);
+    static void on_ssrc_active(GObject* session, GObject* src, gpointer data);
+    static void on_client_connected(GstRTSPServer* server, GstRTSPClient* client, gpointer data);
+    static GstRTSPStatusCode on_pre_setup_request(GstRTSPClient* client, GstRTSPContext* ctx, gpointer data);
+    static void on_client_closed(GstRTSPClient* client, gpointer data);
+    static void on_describe_request(GstRTSPClient* client, GstRTSPContext* ctx, gpointer data);
+    static void on_play_request(GstRTSPClient* client, GstRTSPContext* ctx, gpointer data);
+    GstSample* splice_sample(GstSample* sample, bool keyframe);
+    static GstFlowReturn on_new_sample(GstAppSink* sink, gpointer data);
+    static GstPadProbeReturn on_encoded_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    static GstPadProbeReturn on_converter_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer data);
+    void match_transit(GstClockTime pts);
     static gboolean on_bus_message(GstBus* bus, GstMessage* msg, gpointer data);
 };
 
@@ -0,0 +1,34 @@
+#include "power_meter.hpp"
+#include <glob.h>
+#include <fstream>
+
+static std::string resolve(const std::string& pattern) {
+    glob_t g{};
+    std::string path;
+    if (glob(pattern.c_str(), 0, nullptr, &g) == 0 && g.gl_pathc > 0) path = g.gl_pathv[0];
+    globfree(&g);
+    return path;
+}
+
+static bool read_number(const std::string& path, double& value) {
+    std::ifstream f(path);
+    return static_cast<bool>(f >> value);
+}
+
+bool PowerMeter::open(const std::string& voltage_glob, const std::string& current_glob) {
+    voltage_path_.clear();
+    current_path_.clear();
+    if (voltage_glob.empty() || current_glob.empty()) return false;
+    std::string v = resolve(voltage_glob), c = resolve(current_glob);
+    if (v.empty() || c.empty()) return false;
+    voltage_path_ = v;
+    current_path_ = c;
+    return true;
+}
+
+bool PowerMeter::read_mw(double& mw) const {
+    double mv, ma;
+    if (!available() || !read_number(voltage_path_, mv) || !read_number(current_path_, ma)) return false;
+    mw = mv * ma / 1000.0;
+    return true;
+}
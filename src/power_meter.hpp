@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+/// Board power from a hwmon voltage/current pair.
+///
+/// On the Orin NX the INA3221 monitors the module input rail; its hwmon
+/// node number changes between boots, so both paths may be globs and are
+/// resolved (first match) once in open(). Voltage in mV, current in mA, as
+/// hwmon reports them.
+
+class PowerMeter {
+public:
+    /// False (and read() unavailable) if either path matches nothing.
+    bool open(const std::string& voltage_glob, const std::string& current_glob);
+    bool available() const { return !voltage_path_.empty(); }
+
+    /// Current draw in mW; false if a read failed.
+    bool read_mw(double& mw) const;
+
+private:
+    std::string voltage_path_;
+    std::string current_path_;
+};
@@ -0,0 +1,50 @@
+#include "recovery.hpp"
+#include <algorithm>
+
+const char* recovery_mode_name(RecoveryMode mode) {
+    return mode == RecoveryMode::IntraRefresh ? "intra_refresh" : "idr";
+}
+
+void RecoveryMeter::configure(RecoveryMode mode, int refresh_frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mode_ = mode;
+    refresh_frames_ = std::max(refresh_frames, 1);
+    active_ = false;
+}
+
+void RecoveryMeter::on_loss() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_) return;  // one measurement at a time; later losses fold into it
+    active_ = true;
+    started_ = Clock::now();
+    frames_ = 0;
+    bytes_ = 0;
+    peak_bytes_ = 0;
+}
+
+bool RecoveryMeter::on_frame(uint64_t bytes, bool keyframe, Result& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!active_) {
+        if (!keyframe) {
+            avg_p_bytes_ = avg_p_bytes_ > 0.0 ? 0.95 * avg_p_bytes_ + 0.05 * bytes
+                                              : static_cast<double>(bytes);
+        }
+        return false;
+    }
+
+    frames_++;
+    bytes_ += bytes;
+    peak_bytes_ = std::max(peak_bytes_, bytes);
+
+    // IDR mode heals on the first keyframe; intra refresh after one full sweep
+    bool done = (mode_ == RecoveryMode::Idr) ? keyframe : frames_ >= refresh_frames_;
+    if (!done) return false;
+
+    active_ = false;
+    out.duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - started_).count();
+    out.excess_bytes = static_cast<int64_t>(bytes_ - avg_p_bytes_ * frames_);
+    out.peak_ratio = avg_p_bytes_ > 0.0 ? peak_bytes_ / avg_p_bytes_ : 0.0;
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/// How the encoder heals a viewer after reported loss.
+///
+///   IDR           — force a full intra frame (one large spike on the very
+///                   link that just dropped packets).
+///   IntraRefresh  — gradual decoder refresh: a column of intra MBs sweeps
+///                   the frame every `recovery.refresh_frames`, so every
+///                   frame stays P-sized and a damaged picture heals within
+///                   one sweep, with no spike.
+///
+/// Jetson's nvv4l2h264enc exposes neither long-term reference control nor
+/// NVENC's reference-picture invalidation, so "predict from the last good
+/// reference" isn't reachable through the V4L2 plugin; intra refresh is the
+/// encoder-supported way to get a P-frame-sized recovery.
+enum class RecoveryMode { Idr, IntraRefresh };
+
+const char* recovery_mode_name(RecoveryMode mode);
+
+/// Measures each recovery: loss event → picture fully refreshed. In IDR
+/// mode that is the wait for the keyframe; in IntraRefresh mode the window
+/// is one configured sweep (`refresh_frames`), so its duration is the sweep
+/// length at the current frame rate, not a measurement of healing.
+/// Excess bytes = bytes sent during recovery beyond the running average
+/// P-frame size; peak = largest frame in the window / average P-frame.
+/// Thread-safe (loss events from RTCP/main loop, frames from streaming thread).
+class RecoveryMeter {
+public:
+    struct Result {
+        int64_t duration_ms = 0;
+        int64_t excess_bytes = 0;
+        double peak_ratio = 0.0;
+    };
+
+    /// refresh_frames: sweep length in IntraRefresh mode (ignored for IDR).
+    void configure(RecoveryMode mode, int refresh_frames);
+
+    /// A client reported loss (PLI/FIR) or loss was emulated.
+    void on_loss();
+
+    /// Per encoded frame. Returns true and fills `out` when a recovery completes.
+    bool on_frame(uint64_t bytes, bool keyframe, Result& out);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::mutex mutex_;
+    RecoveryMode mode_ = RecoveryMode::Idr;
+    int refresh_frames_ = 30;
+
+    double avg_p_bytes_ = 0.0;
+    bool active_ = false;
+    Clock::time_point started_{};
+    int frames_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t peak_bytes_ = 0;
+};
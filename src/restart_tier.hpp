@@ -0,0 +1,8 @@
+#pragma once
+
+/// Encoder recovery tiers, cheapest first (see Pipeline): the source chain
+/// alone, the source chain plus a decoder flush, or the whole pipeline.
+/// Stats counts restarts per tier, so it shares the type.
+enum class RestartTier { Source = 0, Decoder = 1, Full = 2 };
+
+const char* restart_tier_name(RestartTier tier);
@@ -0,0 +1,257 @@
+#include "shm_ring.hpp"
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <ctime>
+#include <iostream>
+
+static constexpr uint32_t kMagic = 0x52494e47;          // "RING"
+static constexpr uint32_t kWrapMarker = 0xFFFFFFFFu;    // rest of the ring is padding
+static constexpr size_t kCapsBytes = 1024;
+
+struct ShmRing::Header {
+    uint32_t magic;
+    uint32_t header_bytes;
+    uint64_t capacity;
+    std::atomic<uint64_t> reserved;    // writer: bytes about to be written up to here
+    std::atomic<uint64_t> head;        // writer: bytes published up to here
+    std::atomic<uint32_t> frames;      // futex word, bumped per published AU
+    std::atomic<uint32_t> caps_seq;    // odd while caps are being rewritten
+    std::atomic<uint64_t> idr_requests;
+    std::atomic<int64_t> heartbeat_ns;
+    char caps[kCapsBytes];
+};
+
+/// In front of each record's payload; records are 8-byte aligned.
+struct RecordHeader {
+    uint32_t size;       // payload bytes, or kWrapMarker
+    uint32_t flags;      // bit 0 keyframe, bit 1 discont
+    uint64_t pts;
+    uint64_t dts;
+    uint64_t duration;
+    int64_t written_ns;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring needs address-free 64-bit atomics");
+
+static uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+static void futex_wake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t seen, int timeout_ms) {
+    timespec ts{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, seen, &ts, nullptr, 0);
+}
+
+int64_t ShmRing::now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+ShmRing::ShmRing(std::string name, void* base, size_t mapped, bool owner)
+    : name_(std::move(name)), base_(base), mapped_(mapped), owner_(owner),
+      hdr_(static_cast<Header*>(base)),
+      data_(static_cast<uint8_t*>(base) + align8(sizeof(Header))),
+      capacity_(hdr_->capacity) {}
+
+ShmRing::~ShmRing() {
+    munmap(base_, mapped_);
+    if (owner_) shm_unlink(name_.c_str());
+}
+
+std::unique_ptr<ShmRing> ShmRing::create(const std::string& name, size_t bytes) {
+    bytes = align8(bytes);
+    size_t mapped = align8(sizeof(Header)) + bytes;
+    shm_unlink(name.c_str());   // stale ring from a crashed server with the same pid
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "[RING] shm_open " << name << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)mapped) == 0) {
+        base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "[RING] Cannot map " << mapped / 1024 << " KB: " << strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+
+    Header* hdr = new (base) Header();
+    hdr->magic = kMagic;
+    hdr->header_bytes = sizeof(Header);
+    hdr->capacity = bytes;
+    hdr->heartbeat_ns.store(now_ns());
+    return std::unique_ptr<ShmRing>(new ShmRing(name, base, mapped, true));
+}
+
+std::unique_ptr<ShmRing> ShmRing::open(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        std::cerr << "[RING] shm_open " << name << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size > sizeof(Header)) {
+        base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) return nullptr;
+
+    Header* hdr = static_cast<Header*>(base);
+    if (hdr->magic != kMagic || hdr->header_bytes != sizeof(Header) ||
+        align8(sizeof(Header)) + hdr->capacity > (size_t)st.st_size) {
+        std::cerr << "[RING] " << name << " is not a compatible ring" << std::endl;
+        munmap(base, st.st_size);
+        return nullptr;
+    }
+    auto ring = std::unique_ptr<ShmRing>(new ShmRing(name, base, st.st_size, false));
+    ring->idr_seen_ = hdr->idr_requests.load();   // requests made for the previous worker
+    return ring;
+}
+
+// ============================================================================
+//  Writer
+// ============================================================================
+
+bool ShmRing::write(const uint8_t* data, size_t size, const RingFrame& frame) {
+    uint64_t need = align8(sizeof(RecordHeader) + size);
+    if (need > capacity_ / 2) return false;
+
+    uint64_t head = hdr_->head.load(std::memory_order_relaxed);
+    uint64_t off = head % capacity_;
+    uint64_t start = off + need > capacity_ ? head + (capacity_ - off) : head;
+
+    // Announce the overwrite before doing it; a reader checks this after copying
+    hdr_->reserved.store(start + need, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (start != head) {
+        uint32_t marker = kWrapMarker;
+        memcpy(data_ + off, &marker, sizeof(marker));
+    }
+    RecordHeader rec{static_cast<uint32_t>(size),
+                     (frame.keyframe ? 1u : 0u) | (frame.discont ? 2u : 0u),
+                     frame.pts, frame.dts, frame.duration, now_ns()};
+    uint8_t* dst = data_ + start % capacity_;
+    memcpy(dst, &rec, sizeof(rec));
+    memcpy(dst + sizeof(rec), data, size);
+
+    hdr_->head.store(start + need, std::memory_order_release);
+    hdr_->frames.fetch_add(1, std::memory_order_release);
+    futex_wake(&hdr_->frames);
+    return true;
+}
+
+void ShmRing::set_caps(const std::string& caps) {
+    uint32_t seq = hdr_->caps_seq.load(std::memory_order_relaxed);
+    if (seq & 1u) seq++;   // a previous worker died mid-update
+    hdr_->caps_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    size_t n = std::min(caps.size(), kCapsBytes - 1);
+    memcpy(hdr_->caps, caps.data(), n);
+    hdr_->caps[n] = '\0';
+    hdr_->caps_seq.store(seq + 2, std::memory_order_release);
+}
+
+uint64_t ShmRing::take_idr_requests() {
+    uint64_t now = hdr_->idr_requests.load(std::memory_order_relaxed);
+    uint64_t n = now - idr_seen_;
+    idr_seen_ = now;
+    return n;
+}
+
+void ShmRing::heartbeat() {
+    hdr_->heartbeat_ns.store(now_ns(), std::memory_order_relaxed);
+}
+
+// ============================================================================
+//  Reader
+// ============================================================================
+
+ShmRing::Read ShmRing::read(std::vector<uint8_t>& data, RingFrame& frame, int timeout_ms) {
+    for (;;) {
+        uint32_t seen = hdr_->frames.load(std::memory_order_acquire);
+        uint64_t head = hdr_->head.load(std::memory_order_acquire);
+        if (tail_ == head) {
+            futex_wait(&hdr_->frames, seen, timeout_ms);
+            head = hdr_->head.load(std::memory_order_acquire);
+            if (tail_ == head) return Read::Timeout;
+        }
+        if (head - tail_ > capacity_) {
+            tail_ = head;
+            return Read::Overrun;
+        }
+
+        uint64_t off = tail_ % capacity_;
+        uint32_t size;
+        memcpy(&size, data_ + off, sizeof(size));
+        if (size == kWrapMarker || off + sizeof(RecordHeader) > capacity_) {
+            tail_ += capacity_ - off;
+            continue;
+        }
+        RecordHeader rec;
+        memcpy(&rec, data_ + off, sizeof(rec));
+        if (off + sizeof(rec) + rec.size > capacity_) {   // torn header: lapped mid-read
+            tail_ = head;
+            return Read::Overrun;
+        }
+        data.assign(data_ + off + sizeof(rec), data_ + off + sizeof(rec) + rec.size);
+
+        // Was any of it overwritten while we copied?
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (hdr_->reserved.load(std::memory_order_relaxed) - tail_ > capacity_) {
+            tail_ = hdr_->head.load(std::memory_order_acquire);
+            return Read::Overrun;
+        }
+        tail_ += align8(sizeof(rec) + rec.size);
+
+        frame.pts = rec.pts;
+        frame.dts = rec.dts;
+        frame.duration = rec.duration;
+        frame.keyframe = rec.flags & 1u;
+        frame.discont = rec.flags & 2u;
+        frame.written_ns = rec.written_ns;
+        return Read::Frame;
+    }
+}
+
+std::string ShmRing::caps(uint32_t& seq) const {
+    char buf[kCapsBytes];
+    for (int attempt = 0; attempt < 100; attempt++) {
+        uint32_t before = hdr_->caps_seq.load(std::memory_order_acquire);
+        if (before & 1u) continue;
+        memcpy(buf, hdr_->caps, kCapsBytes);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (hdr_->caps_seq.load(std::memory_order_relaxed) == before) {
+            seq = before;
+            buf[kCapsBytes - 1] = '\0';
+            return buf;
+        }
+    }
+    return std::string();   // mid-update; the caller retries on the next frame
+}
+
+uint32_t ShmRing::caps_version() const {
+    return hdr_->caps_seq.load(std::memory_order_acquire);
+}
+
+void ShmRing::request_idr() {
+    hdr_->idr_requests.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t ShmRing::heartbeat_age_ms() const {
+    return (now_ns() - hdr_->heartbeat_ns.load(std::memory_order_relaxed)) / 1000000;
+}
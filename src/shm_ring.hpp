@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Encoded access units in a POSIX shared-memory ring, from the encoder
+/// worker process (single writer) to the serving process (single reader).
+///
+/// Records are written in place and published by advancing `head`; the
+/// reader never blocks the writer. A reader that falls a whole ring behind
+/// skips to the head and reports an overrun. The writer announces how far
+/// it is about to write before touching the bytes, so a record that was
+/// overwritten while being copied is detected and dropped (seqlock style).
+/// The header also carries the reverse control path: IDR requests and the
+/// worker's main-loop heartbeat. The mapping outlives any one worker, so a
+/// respawned worker continues the same ring.
+
+/// Per-AU metadata carried with the bytes.
+struct RingFrame {
+    uint64_t pts = UINT64_MAX;      // GstClockTime, UINT64_MAX = none
+    uint64_t dts = UINT64_MAX;
+    uint64_t duration = UINT64_MAX;
+    bool keyframe = false;
+    bool discont = false;
+    int64_t written_ns = 0;         // CLOCK_MONOTONIC at publish (hand-off latency)
+};
+
+class ShmRing {
+public:
+    /// Serving process: create and initialise `name` (e.g. "/rtsp_encoder.1234").
+    static std::unique_ptr<ShmRing> create(const std::string& name, size_t bytes);
+
+    /// Worker process: map an existing ring.
+    static std::unique_ptr<ShmRing> open(const std::string& name);
+
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    const std::string& name() const { return name_; }
+
+    // ---- Writer (worker) ----
+
+    /// Publish one access unit. False if it can never fit (> half the ring).
+    bool write(const uint8_t* data, size_t size, const RingFrame& frame);
+
+    /// Caps of the stream that follows (rarely changes).
+    void set_caps(const std::string& caps);
+
+    /// IDR requests made by the reader since the last call.
+    uint64_t take_idr_requests();
+
+    /// Main loop alive.
+    void heartbeat();
+
+    // ---- Reader (server) ----
+
+    enum class Read { Frame, Timeout, Overrun };
+
+    /// Wait up to `timeout_ms` for the next access unit and copy it out.
+    Read read(std::vector<uint8_t>& data, RingFrame& frame, int timeout_ms);
+
+    /// Current caps string; `seq` changes whenever it does.
+    std::string caps(uint32_t& seq) const;
+    uint32_t caps_version() const;
+
+    void request_idr();
+
+    /// Milliseconds since the last heartbeat().
+    int64_t heartbeat_age_ms() const;
+
+    static int64_t now_ns();
+
+private:
+    struct Header;
+
+    ShmRing(std::string name, void* base, size_t mapped, bool owner);
+
+    std::string name_;
+    void* base_;
+    size_t mapped_;
+    bool owner_;
+    Header* hdr_;
+    uint8_t* data_;
+    uint64_t capacity_;
+    uint64_t tail_ = 0;          // reader position (reader process only)
+    uint64_t idr_seen_ = 0;      // writer: requests already taken
+};
@@ -0,0 +1,109 @@
+#include "stall_detector.hpp"
+#include <glib-unix.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+
+StallDetector::StallDetector(const ConfigStore& config, Stats& stats)
+    : config_(config), stats_(stats) {}
+
+StallDetector::~StallDetector() { stop(); }
+
+int64_t StallDetector::now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+bool StallDetector::start(Handler handler) {
+    handler_ = std::move(handler);
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "[STALL] timerfd_create failed, relying on the watchdog" << std::endl;
+        return false;
+    }
+    watch_id_ = g_unix_fd_add(fd_, G_IO_IN, StallDetector::on_timer, this);
+    return true;
+}
+
+void StallDetector::stop() {
+    if (watch_id_) { g_source_remove(watch_id_); watch_id_ = 0; }
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    if (fd_ >= 0) { close(fd_); fd_ = -1; }
+}
+
+void StallDetector::reset() {
+    last_frame_ns_.store(0);
+    ewma_gap_ns_.store(0);
+    arm_at(0);   // disarm until frames flow again
+}
+
+/// Streaming thread (on_frame) and main loop (on_timer, reset).
+void StallDetector::arm_at(int64_t deadline_ns) {
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    if (fd_ < 0) return;
+    deadline_ns_.store(deadline_ns);
+    itimerspec its{};
+    its.it_value.tv_sec = deadline_ns / 1000000000LL;
+    its.it_value.tv_nsec = deadline_ns % 1000000000LL;
+    timerfd_settime(fd_, deadline_ns ? TFD_TIMER_ABSTIME : 0, &its, nullptr);
+}
+
+void StallDetector::on_frame() {
+    int64_t now = now_ns();
+    int64_t last = last_frame_ns_.exchange(now);
+
+    if (stalled_.exchange(false) && last > 0) {
+        cleared_ms_.store((now - last) / 1000000);
+    }
+    if (last == 0) return;   // first frame: no gap yet, arm on the next one
+
+    int64_t gap = now - last;
+    int64_t ewma = ewma_gap_ns_.load();
+    ewma = ewma ? (ewma * 7 + gap) / 8 : gap;
+    ewma_gap_ns_.store(ewma);
+
+    const ResilienceConfig& rc = config_->resilience;
+    int64_t deadline = std::max<int64_t>(static_cast<int64_t>(ewma * rc.stall_gap_multiplier),
+                                static_cast<int64_t>(rc.stall_min_ms) * 1000000LL);
+    arm_at(now + deadline);
+}
+
+gboolean StallDetector::on_timer(gint fd, GIOCondition, gpointer data) {
+    StallDetector* self = static_cast<StallDetector*>(data);
+    uint64_t expirations = 0;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return G_SOURCE_CONTINUE;
+
+    int64_t now = now_ns();
+    int64_t last = self->last_frame_ns_.load();
+    int64_t deadline = self->deadline_ns_.load();
+    // A frame re-armed the timer after it had already fired: not a stall
+    if (last == 0 || deadline == 0 || now < deadline) return G_SOURCE_CONTINUE;
+
+    if (!self->stalled_.exchange(true)) self->level_ = 0;
+    int64_t stalled_ms = (now - last) / 1000000;
+    const ResilienceConfig& rc = self->config_->resilience;
+
+    Level level;
+    if (self->level_ == 0) {
+        level = Soft;
+        self->level_ = 1;
+        // Come back for the hard step if frames don't return by then
+        self->arm_at(last + static_cast<int64_t>(std::max(rc.stall_restart_ms, 1)) * (int64_t)1000000);
+    } else if (self->level_ == 1) {
+        level = Hard;
+        self->level_ = 2;
+    } else {
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (self->handler_) self->handler_(level, stalled_ms);
+
+    int64_t action_us = (now_ns() - deadline) / 1000;
+    std::cout << "[STALL] " << (level == Soft ? "soft" : "hard") << " action "
+              << action_us << " us after detection" << std::endl;
+    self->stats_.on_stall(level == Hard, stalled_ms, action_us);
+    return G_SOURCE_CONTINUE;
+}
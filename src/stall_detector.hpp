@@ -0,0 +1,71 @@
+#pragma once
+
+#include "config.hpp"
+#include "stats.hpp"
+
+#include <glib.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+/// Frame-cadence stall detection.
+///
+/// Every encoded frame re-arms a timerfd to fire `resilience.stall_gap_multiplier`
+/// × the EWMA inter-frame gap from now (at least `stall_min_ms`). If it
+/// fires, the output has stalled: the handler runs on the main loop with
+/// level 1 (soft), and again with level 2 (hard) once the stall reaches
+/// `stall_restart_ms`. Detection-to-action latency (deadline → handler done)
+/// is reported per stall. A 30 fps stream is declared stalled after ~130 ms
+/// instead of after the watchdog's whole seconds.
+
+class StallDetector {
+public:
+    enum Level { Soft = 1, Hard = 2 };
+
+    /// Main-loop reaction to a stall at `level`, `stalled_ms` after the last frame.
+    using Handler = std::function<void(Level level, int64_t stalled_ms)>;
+
+    StallDetector(const ConfigStore& config, Stats& stats);
+    ~StallDetector();
+
+    StallDetector(const StallDetector&) = delete;
+    StallDetector& operator=(const StallDetector&) = delete;
+
+    /// Main loop: create the timer and watch it on the default context.
+    bool start(Handler handler);
+    void stop();
+
+    /// Streaming thread: a frame left the encoder. Re-arms the timer.
+    void on_frame();
+
+    /// Forget cadence history (new encoder; first frames come slower).
+    void reset();
+
+    bool stalled() const { return stalled_.load(); }
+
+    /// Duration of the last stall that ended (ms), or -1 if none since last call.
+    int64_t take_cleared_ms() { return cleared_ms_.exchange(-1); }
+
+    /// Expected inter-frame gap (ms) as currently tracked.
+    double gap_ms() const { return ewma_gap_ns_.load() / 1e6; }
+
+private:
+    const ConfigStore& config_;
+    Stats& stats_;
+    Handler handler_;
+    std::mutex fd_mutex_;   // fd_ lifetime vs arm_at from the streaming thread
+    int fd_ = -1;
+    guint watch_id_ = 0;
+
+    std::atomic<int64_t> last_frame_ns_{0};
+    std::atomic<int64_t> ewma_gap_ns_{0};
+    std::atomic<int64_t> deadline_ns_{0};
+    std::atomic<bool> stalled_{false};
+    std::atomic<int64_t> cleared_ms_{-1};
+    int level_ = 0;   // main loop: escalation reached in the current stall
+
+    void arm_at(int64_t deadline_ns);
+    static int64_t now_ns();
+    static gboolean on_timer(gint fd, GIOCondition cond, gpointer data);
+};
@@ -0,0 +1,278 @@
+#include "startup.hpp"
+#include <gst/gst.h>
+#include <gst/rtsp/gstrtspconnection.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+static int64_t clock_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/// Process start in CLOCK_BOOTTIME ns (field 22 of /proc/self/stat), or -1.
+static int64_t process_start_boot_ns() {
+    std::ifstream f("/proc/self/stat");
+    std::string line;
+    if (!std::getline(f, line)) return -1;
+    size_t paren = line.rfind(')');   // comm may contain spaces
+    if (paren == std::string::npos) return -1;
+    std::istringstream rest(line.substr(paren + 2));
+    std::string field;
+    for (int i = 3; i <= 22 && rest >> field; i++) {
+        if (i == 22) return std::stoll(field) * (1000000000LL / sysconf(_SC_CLK_TCK));
+    }
+    return -1;
+}
+
+static std::string read_line(const std::string& path) {
+    std::ifstream f(path);
+    std::string line;
+    std::getline(f, line);
+    return line;
+}
+
+static std::string cache_dir() {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    std::string base = xdg && *xdg ? xdg : home && *home ? std::string(home) + "/.cache" : "/var/tmp";
+    std::string dir = base + "/rtsp_encoder";
+    g_mkdir_with_parents(dir.c_str(), 0755);
+    return dir;
+}
+
+/// Every directory GStreamer scans for plugins, per its own env rules.
+static std::vector<std::string> plugin_dirs(const std::string& machine) {
+    std::vector<std::string> dirs;
+    auto split = [&dirs](const char* list) {
+        std::istringstream ss(list);
+        std::string d;
+        while (std::getline(ss, d, ':')) if (!d.empty()) dirs.push_back(d);
+    };
+    const char* user = getenv("GST_PLUGIN_PATH_1_0");
+    if (!user) user = getenv("GST_PLUGIN_PATH");
+    if (user) split(user);
+
+    const char* system = getenv("GST_PLUGIN_SYSTEM_PATH_1_0");
+    if (!system) system = getenv("GST_PLUGIN_SYSTEM_PATH");
+    if (system) {
+        split(system);
+    } else {
+        if (const char* home = getenv("HOME")) dirs.push_back(std::string(home) + "/.local/share/gstreamer-1.0/plugins");
+        dirs.push_back("/usr/lib/" + machine + "-linux-gnu/gstreamer-1.0");
+        dirs.push_back("/usr/lib/gstreamer-1.0");
+        dirs.push_back("/usr/local/lib/gstreamer-1.0");
+    }
+    return dirs;
+}
+
+// ============================================================================
+//  StartupTrace
+// ============================================================================
+
+StartupTrace::StartupTrace() {
+    int64_t mono = clock_ns(CLOCK_MONOTONIC);
+    int64_t started = process_start_boot_ns();
+    int64_t age = started >= 0 ? clock_ns(CLOCK_BOOTTIME) - started : 0;
+    start_mono_ns_ = mono - std::max<int64_t>(age, 0);
+    cache_dir_ = cache_dir();
+    boot_id_ = read_line("/proc/sys/kernel/random/boot_id");
+}
+
+int64_t StartupTrace::now_ns() const {
+    return clock_ns(CLOCK_MONOTONIC) - start_mono_ns_;
+}
+
+void StartupTrace::phase(const char* name, int64_t begin_ns) const {
+    int64_t end = now_ns();
+    std::ostringstream line;   // one write: phases finish on several threads
+    line << std::fixed << std::setprecision(1) << "[STARTUP] " << std::left << std::setw(16)
+         << name << std::right << std::setw(8) << (end - begin_ns) / 1e6 << " ms  (+"
+         << begin_ns / 1e6 << " → +" << end / 1e6 << " ms)\n";
+    std::cout << line.str() << std::flush;
+}
+
+void StartupTrace::prepare_registry() {
+    int64_t t = now_ns();
+    utsname u{};
+    uname(&u);
+
+    const char* env = getenv("GST_REGISTRY_1_0");
+    if (!env) env = getenv("GST_REGISTRY");
+    std::string path = env ? env : cache_dir_ + "/registry." + u.machine + ".bin";
+    if (!env) setenv("GST_REGISTRY", path.c_str(), 1);
+
+    struct stat reg;
+    bool current = stat(path.c_str(), &reg) == 0 && reg.st_size > 0;
+    for (const std::string& dir : plugin_dirs(u.machine)) {
+        struct stat st;
+        if (current && stat(dir.c_str(), &st) == 0 && st.st_mtime >= reg.st_mtime) current = false;
+    }
+    // A plugin added or removed changes its directory's mtime, so a cache newer
+    // than all of them can be trusted without stat-ing every plugin file
+    if (current && !getenv("GST_REGISTRY_UPDATE")) setenv("GST_REGISTRY_UPDATE", "no", 1);
+
+    load_state();
+    warm_ = current && !boot_id_.empty() && read_line(cache_dir_ + "/boot_id") == boot_id_;
+
+    std::cout << "[STARTUP] Registry " << path << (current ? " (cached)" : " (rescan)")
+              << ", " << (warm_ ? "warm" : "cold") << " start" << std::endl;
+    phase("registry check", t);
+}
+
+void StartupTrace::load_state() {
+    std::ifstream f(cache_dir_ + "/startup.state");
+    std::string key;
+    int64_t value;
+    while (f >> key >> value) {
+        if (key == "cold_ms") last_cold_ms_ = value;
+        else if (key == "warm_ms") last_warm_ms_ = value;
+    }
+}
+
+void StartupTrace::save_state(int64_t ttff_ms) const {
+    std::string path = cache_dir_ + "/startup.state";
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp);
+        f << "cold_ms " << (warm_ ? last_cold_ms_ : ttff_ms) << "\n"
+          << "warm_ms " << (warm_ ? ttff_ms : last_warm_ms_) << "\n";
+    }
+    std::rename(tmp.c_str(), path.c_str());
+    std::ofstream(cache_dir_ + "/boot_id") << boot_id_ << "\n";
+}
+
+void StartupTrace::on_first_frame() {
+    if (first_frame_.load() || first_frame_.exchange(true)) return;
+    int64_t ttff_ms = now_ns() / 1000000;
+
+    auto shown = [](int64_t ms) { return ms >= 0 ? std::to_string(ms) + " ms" : std::string("n/a"); };
+    int64_t cold = warm_ ? last_cold_ms_ : ttff_ms;
+    int64_t warm = warm_ ? ttff_ms : last_warm_ms_;
+    std::cout << "[STARTUP] time-to-first-frame " << ttff_ms << " ms (" << (warm_ ? "warm" : "cold")
+              << ") | cold: " << shown(cold) << " | warm: " << shown(warm) << std::endl;
+    save_state(ttff_ms);
+}
+
+void StartupTrace::on_first_served() {
+    if (first_served_.load() || first_served_.exchange(true)) return;
+    std::cout << "[STARTUP] First frame served at +" << now_ns() / 1000000 << " ms" << std::endl;
+}
+
+// ============================================================================
+//  Concurrent startup work
+// ============================================================================
+
+std::vector<std::string> required_elements(const AppConfig& config, bool encoder, bool serving) {
+    std::vector<std::string> names;
+    if (encoder) {
+        names = {"rtspsrc", "rtph264depay", "h264parse", "nvv4l2decoder", "nvvidconv",
+                 "nvv4l2h264enc", "appsink"};
+        if (config.mosaic.enabled) names.push_back("nvcompositor");
+        if (config.denoise.enabled) names.push_back("capsfilter");
+        const QueuesConfig& q = config.queues;
+        if (q.decode.enabled || q.convert.enabled || q.encode.enabled || q.output.enabled) {
+            names.push_back("queue");
+        }
+    }
+    if (serving) {
+        for (const char* name : {"appsrc", "rtph264pay"}) {
+            if (std::find(names.begin(), names.end(), name) == names.end()) names.push_back(name);
+        }
+    }
+    return names;
+}
+
+std::vector<std::string> preload_elements(const std::vector<std::string>& factories) {
+    std::vector<std::string> missing(factories.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < factories.size(); i++) {
+        threads.emplace_back([&factories, &missing, i]() {
+            GstElementFactory* f = gst_element_factory_find(factories[i].c_str());
+            if (!f) { missing[i] = factories[i]; return; }
+            GstPluginFeature* loaded = gst_plugin_feature_load(GST_PLUGIN_FEATURE(f));
+            if (!loaded) missing[i] = factories[i];
+            else gst_object_unref(loaded);
+            gst_object_unref(f);
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    std::vector<std::string> result;
+    for (auto& name : missing) if (!name.empty()) result.push_back(name);
+    return result;
+}
+
+bool probe_source(const std::string& url, int timeout_ms, const std::string& name) {
+    auto t0 = std::chrono::steady_clock::now();
+    GstRTSPUrl* rtsp_url = nullptr;
+    if (gst_rtsp_url_parse(url.c_str(), &rtsp_url) != GST_RTSP_OK) {
+        std::cerr << "[STARTUP] DESCRIBE " << name << ": bad URL" << std::endl;
+        return false;
+    }
+    GstRTSPConnection* conn = nullptr;
+    if (gst_rtsp_connection_create(rtsp_url, &conn) != GST_RTSP_OK) {
+        gst_rtsp_url_free(rtsp_url);
+        return false;
+    }
+
+#if GST_CHECK_VERSION(1, 18, 0)
+    gint64 timeout_us = (gint64)timeout_ms * 1000;
+    auto connect = [&]() { return gst_rtsp_connection_connect_usec(conn, timeout_us); };
+    auto send    = [&](GstRTSPMessage* m) { return gst_rtsp_connection_send_usec(conn, m, timeout_us); };
+    auto receive = [&](GstRTSPMessage* m) { return gst_rtsp_connection_receive_usec(conn, m, timeout_us); };
+#else
+    GTimeVal timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    auto connect = [&]() { return gst_rtsp_connection_connect(conn, &timeout); };
+    auto send    = [&](GstRTSPMessage* m) { return gst_rtsp_connection_send(conn, m, &timeout); };
+    auto receive = [&](GstRTSPMessage* m) { return gst_rtsp_connection_receive(conn, m, &timeout); };
+#endif
+
+    int code = 0;
+    guint sdp_bytes = 0;
+    GstRTSPResult res = connect();
+    if (res == GST_RTSP_OK) {
+        GstRTSPMessage request = {};
+        gst_rtsp_message_init_request(&request, GST_RTSP_DESCRIBE, url.c_str());
+        gst_rtsp_message_add_header(&request, GST_RTSP_HDR_ACCEPT, "application/sdp");
+        gst_rtsp_message_add_header(&request, GST_RTSP_HDR_CSEQ, "1");
+        res = send(&request);
+        gst_rtsp_message_unset(&request);
+    }
+    if (res == GST_RTSP_OK) {
+        GstRTSPMessage response = {};
+        res = receive(&response);
+        if (res == GST_RTSP_OK && response.type == GST_RTSP_MESSAGE_RESPONSE) {
+            code = response.type_data.response.code;
+            guint8* body = nullptr;
+            gst_rtsp_message_get_body(&response, &body, &sdp_bytes);
+        }
+        gst_rtsp_message_unset(&response);
+    }
+    gst_rtsp_connection_close(conn);
+    gst_rtsp_connection_free(conn);
+    gst_rtsp_url_free(rtsp_url);
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    if (code == 0) {
+        std::cerr << "[STARTUP] DESCRIBE " << name << ": unreachable after " << ms << " ms" << std::endl;
+        return false;
+    }
+    // 401 still means the camera is up; rtspsrc does the authentication
+    std::cout << "[STARTUP] DESCRIBE " << name << ": " << code << " in " << ms << " ms"
+              << (sdp_bytes ? " (SDP " + std::to_string(sdp_bytes) + " bytes)" : std::string())
+              << std::endl;
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Startup phase timing and time-to-first-frame (TTFF).
+///
+/// Times count from process exec (kernel start time in /proc/self/stat),
+/// so dynamic loading is included. A start is cold when it is the first
+/// since boot or the plugin registry had to be rebuilt, warm otherwise.
+/// The last TTFF of each kind is kept beside the registry cache, so every
+/// start reports both.
+
+class StartupTrace {
+public:
+    StartupTrace();
+
+    StartupTrace(const StartupTrace&) = delete;
+    StartupTrace& operator=(const StartupTrace&) = delete;
+
+    /// Nanoseconds since process start.
+    int64_t now_ns() const;
+
+    /// Log a phase that began at `begin_ns` (from now_ns()) and ends now. Any thread.
+    void phase(const char* name, int64_t begin_ns) const;
+
+    /// Before gst_init: point GST_REGISTRY at our cache and skip the plugin
+    /// rescan when the cache is newer than every plugin directory.
+    void prepare_registry();
+
+    bool warm() const { return warm_; }
+
+    /// Appsink thread: a frame reached the fan-out. Reports TTFF the first time.
+    void on_first_frame();
+
+    /// Feeder thread: a frame was pushed to a client. Logged the first time.
+    void on_first_served();
+
+private:
+    int64_t start_mono_ns_ = 0;     // CLOCK_MONOTONIC at process exec
+    std::string cache_dir_;
+    std::string boot_id_;
+    bool warm_ = false;
+    int64_t last_cold_ms_ = -1;     // from the previous runs' state file
+    int64_t last_warm_ms_ = -1;
+    std::atomic<bool> first_frame_{false};
+    std::atomic<bool> first_served_{false};
+
+    void load_state();
+    void save_state(int64_t ttff_ms) const;
+};
+
+/// Element factories this process will create: the encoder side, the
+/// serving side, or both (split mode runs them in separate processes).
+std::vector<std::string> required_elements(const AppConfig& config, bool encoder, bool serving);
+
+/// Load the plugins behind `factories` in parallel (plugin dlopen and init
+/// dominate first element creation on Jetson). Returns the ones not found.
+std::vector<std::string> preload_elements(const std::vector<std::string>& factories);
+
+/// One DESCRIBE to the camera, bounded by `timeout_ms`. rtspsrc cannot take
+/// an SDP from outside, so this only wakes the camera's session, checks
+/// reachability early and times the round trip. `name` labels the log
+/// lines ("camera", "input 2"). Returns false if unreachable.
+bool probe_source(const std::string& url, int timeout_ms, const std::string& name);
@@ -1,7 +1,11 @@
 #include "stats.hpp"
+#include "h264.hpp"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 void Stats::reset() {
     frame_count_.store(0);
@@ -11,12 +15,33 @@ void Stats::reset() {
     last_fps_time_ns_.store(0);
 }
 
-void Stats::on_frame_encoded() {
+void Stats::on_frame_encoded(uint64_t bytes, bool keyframe) {
     frame_count_.fetch_add(1);
+    bytes_.fetch_add(bytes);
+    if (keyframe) {
+        key_bytes_.fetch_add(bytes);
+        key_frames_.fetch_add(1);
+    }
     auto now = Clock::now().time_since_epoch().count();
     last_frame_time_ns_.store(now);
 }
 
+void Stats::on_admitted(EgressClass cls) {
+    admitted_[(int)cls].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::on_rejected() {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::on_egress_reserved(const int sessions[3], const int64_t kbps[3], int64_t budget_kbps) {
+    for (int i = 0; i < 3; i++) {
+        egress_sessions_[i].store(sessions[i]);
+        egress_kbps_[i].store(kbps[i]);
+    }
+    egress_budget_kbps_.store(budget_kbps);
+}
+
 void Stats::on_reconnect() {
     reconnect_count_.fetch_add(1);
 }
@@ -25,6 +50,186 @@ void Stats::on_pipeline_restart() {
     restart_count_.fetch_add(1);
 }
 
+static void atomic_max(std::atomic<int64_t>& target, int64_t value) {
+    int64_t cur = target.load();
+    while (value > cur && !target.compare_exchange_weak(cur, value)) {}
+}
+
+void Stats::on_idle_sample(bool idle, double wall_s, double cpu_s, double power_mw) {
+    int i = idle ? 1 : 0;
+    idle_wall_ms_[i].fetch_add((int64_t)(wall_s * 1000.0), std::memory_order_relaxed);
+    idle_cpu_us_[i].fetch_add((int64_t)(cpu_s * 1e6), std::memory_order_relaxed);
+    if (power_mw >= 0.0) {
+        idle_energy_mj_[i].fetch_add((int64_t)(power_mw * wall_s), std::memory_order_relaxed);
+        idle_power_ms_[i].fetch_add((int64_t)(wall_s * 1000.0), std::memory_order_relaxed);
+    }
+}
+
+void Stats::on_idle_resume(int64_t ms, bool from_teardown) {
+    int i = from_teardown ? 1 : 0;
+    resumes_[i].fetch_add(1, std::memory_order_relaxed);
+    resume_last_ms_[i].store(ms);
+    atomic_max(resume_max_ms_[i], ms);
+}
+
+void Stats::on_thermal_reading(double temp_c, double headroom_c, double cpu_clock, double gpu_clock,
+                               int level, int levels) {
+    thermal_temp_milli_.store((int64_t)(temp_c * 1000.0));
+    thermal_headroom_milli_.store((int64_t)(headroom_c * 1000.0));
+    thermal_cpu_permille_.store(cpu_clock < 0 ? -1 : (int64_t)(cpu_clock * 1000.0));
+    thermal_gpu_permille_.store(gpu_clock < 0 ? -1 : (int64_t)(gpu_clock * 1000.0));
+    thermal_level_.store(level);
+    thermal_levels_.store(levels);
+    thermal_read_.store(true);
+}
+
+void Stats::on_thermal_step(bool down) {
+    thermal_steps_[down ? 0 : 1].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::on_gop_update(int gop_frames, double loss_fraction, double pli_rate, int clients) {
+    gop_frames_.store(gop_frames);
+    gop_loss_ppm_.store(static_cast<int64_t>(loss_fraction * 1e6));
+    gop_pli_rate_milli_.store(static_cast<int64_t>(pli_rate * 1000.0));
+    gop_clients_.store(clients);
+}
+
+void Stats::on_pli_answered(int64_t ms) {
+    pli_answered_.fetch_add(1);
+    pli_to_idr_ms_.fetch_add(ms);
+}
+
+void Stats::on_recovery(const char* mode, int64_t ms, int64_t excess_bytes, double peak_ratio) {
+    recovery_mode_.store(mode);
+    recoveries_.fetch_add(1);
+    recovery_ms_.fetch_add(ms);
+    recovery_excess_bytes_.fetch_add(excess_bytes);
+    atomic_max(recovery_peak_milli_, static_cast<int64_t>(peak_ratio * 1000.0));
+}
+
+void Stats::on_splice(int64_t outage_ms) {
+    splices_.fetch_add(1);
+    splice_last_ms_.store(outage_ms);
+    atomic_max(splice_max_ms_, outage_ms);
+}
+
+void Stats::on_restart_tier(RestartTier tier, int64_t rebuild_ms, int64_t total_ms) {
+    int i = static_cast<int>(tier);
+    tier_count_[i].fetch_add(1);
+    tier_rebuild_ms_[i].fetch_add(rebuild_ms);
+    tier_total_ms_[i].fetch_add(total_ms);
+}
+
+void Stats::on_stall(bool hard, int64_t stalled_ms, int64_t action_us) {
+    if (hard) {
+        stalls_hard_.fetch_add(1);
+    } else {
+        stalls_soft_.fetch_add(1);
+        stall_detect_ms_.fetch_add(stalled_ms);
+    }
+    stall_action_us_.fetch_add(action_us);
+    atomic_max(stall_action_max_us_, action_us);
+}
+
+void Stats::on_ipc_frame(int64_t handoff_us) {
+    ipc_frames_.fetch_add(1);
+    ipc_handoff_us_.fetch_add(handoff_us);
+    atomic_max(ipc_handoff_max_us_, handoff_us);
+}
+
+void Stats::on_alloc(int64_t ns, bool pooled) {
+    (pooled ? allocs_pooled_ : allocs_unpooled_).fetch_add(1, std::memory_order_relaxed);
+    alloc_ns_.fetch_add(ns, std::memory_order_relaxed);
+    atomic_max(alloc_max_ns_, ns);
+}
+
+void Stats::on_arena_reserved(uint64_t reserved_bytes, uint64_t cap_bytes) {
+    arena_reserved_.store(reserved_bytes);
+    arena_cap_.store(cap_bytes);
+}
+
+void Stats::on_au_scan(int64_t ns, size_t nals) {
+    scans_.fetch_add(1, std::memory_order_relaxed);
+    scan_ns_.fetch_add(ns, std::memory_order_relaxed);
+    scan_nals_.fetch_add(nals, std::memory_order_relaxed);
+    atomic_max(scan_max_ns_, ns);
+}
+
+void Stats::on_param_sets_stripped(uint64_t bytes, int clients) {
+    ps_stripped_.fetch_add(1, std::memory_order_relaxed);
+    ps_saved_bytes_.fetch_add(bytes * (uint64_t)std::max(clients, 0), std::memory_order_relaxed);
+}
+
+void Stats::on_param_sets_changed() {
+    ps_changes_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::on_param_sets_injected(uint64_t bytes) {
+    ps_injected_.fetch_add(1, std::memory_order_relaxed);
+    ps_injected_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Stats::on_nal_stripped(uint8_t nal_type, uint64_t bytes) {
+    strip_bytes_[nal_type & 0x1F].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Stats::on_filler_headroom(int64_t boost_kbps) {
+    filler_boost_kbps_.store(boost_kbps);
+}
+
+void Stats::on_transit(int64_t transit_us) {
+    transit_frames_.fetch_add(1, std::memory_order_relaxed);
+    transit_us_.fetch_add(transit_us, std::memory_order_relaxed);
+    atomic_max(transit_max_us_, transit_us);
+}
+
+void Stats::on_frames_lost(uint64_t frames) { frames_lost_.fetch_add(frames); }
+
+void Stats::on_queue_level(QueueBoundary queue, uint32_t level, uint32_t capacity) {
+    int i = static_cast<int>(queue);
+    queue_samples_[i].fetch_add(1, std::memory_order_relaxed);
+    queue_level_sum_[i].fetch_add(level, std::memory_order_relaxed);
+    queue_capacity_[i].store(capacity, std::memory_order_relaxed);
+    atomic_max(queue_level_max_[i], level);
+}
+
+void Stats::on_queue_full(QueueBoundary queue) { queue_full_[static_cast<int>(queue)].fetch_add(1); }
+
+void Stats::on_ipc_overrun() { ipc_overruns_.fetch_add(1); }
+
+void Stats::on_worker_restart() { worker_restarts_.fetch_add(1); }
+
+void Stats::on_denoise_frame(int64_t cost_us, bool over_budget, double delta_psnr_db) {
+    denoise_frames_.fetch_add(1);
+    denoise_cost_us_.fetch_add(cost_us);
+    atomic_max(denoise_cost_max_us_, cost_us);
+    if (over_budget) denoise_overruns_.fetch_add(1);
+    denoise_psnr_milli_db_.fetch_add(static_cast<int64_t>(delta_psnr_db * 1000.0));
+}
+
+void Stats::on_frame_qp(int qp, bool denoised) {
+    qp_frames_[denoised ? 1 : 0].fetch_add(1);
+    qp_sum_[denoised ? 1 : 0].fetch_add(static_cast<uint64_t>(qp));
+}
+
+/// Rough luma PSNR implied by an H.264 QP: uniform quantiser error
+/// Qstep²/12 with Qstep = 0.625·2^(QP/6). Only meaningful as a relative
+/// on/off comparison at the same bitrate, not as an absolute quality figure.
+static double qp_to_psnr_estimate(double qp) {
+    double qstep = 0.625 * std::pow(2.0, qp / 6.0);
+    return 10.0 * std::log10(255.0 * 255.0 * 12.0 / (qstep * qstep));
+}
+
+void Stats::on_mosaic_frame(int64_t cost_us, int64_t latency_us,
+                            uint32_t inputs, uint32_t reused_inputs) {
+    mosaic_frames_.fetch_add(1);
+    mosaic_cost_us_.fetch_add(cost_us);
+    mosaic_latency_us_.fetch_add(latency_us);
+    atomic_max(mosaic_latency_max_us_, latency_us);
+    mosaic_slots_.fetch_add(inputs);
+    mosaic_reused_.fetch_add(reused_inputs);
+}
+
 double Stats::seconds_since_last_frame() const {
     int64_t last = last_frame_time_ns_.load();
     if (last == 0) {
@@ -61,12 +266,17 @@ void Stats::print() const {
     int64_t prev_time = last_fps_time_ns_.load();
 
     double fps = 0.0;
+    double dt = 0.0;
     if (prev_time > 0) {
-        double dt = static_cast<double>(now_ns - prev_time) / 1e9;
+        dt = static_cast<double>(now_ns - prev_time) / 1e9;
         if (dt > 0.0) {
             fps = static_cast<double>(current_frames - prev_frames) / dt;
         }
     }
+    uint64_t bytes = bytes_.exchange(0);
+    uint64_t key_bytes = key_bytes_.exchange(0);
+    uint64_t key_frames = key_frames_.exchange(0);
+    double kbps = dt > 0.0 ? static_cast<double>(bytes) * 8.0 / dt / 1000.0 : 0.0;
 
     // Update for next interval
     last_fps_frame_count_.store(current_frames);
@@ -77,8 +287,270 @@ void Stats::print() const {
     std::cout << "[STATS] uptime=" << get_uptime_string()
               << " | frames=" << current_frames
               << " | fps=" << std::fixed << std::setprecision(1) << fps
+              << " | kbps=" << std::setprecision(0) << kbps << std::setprecision(1)
               << " | last_frame=" << std::fixed << std::setprecision(1) << since_last << "s ago"
               << " | reconnects=" << reconnect_count_.load()
               << " | restarts=" << restart_count_.load()
               << std::endl;
+
+    // GOP tradeoff: bits spent on IDRs beyond what P-frames would have cost,
+    // against how long a viewer who lost a packet waits for the next IDR
+    int gop = gop_frames_.load();
+    if (gop > 0) {
+        uint64_t interval_frames = current_frames >= prev_frames ? current_frames - prev_frames : 0;
+        uint64_t delta_frames = interval_frames > key_frames ? interval_frames - key_frames : 0;
+        double delta_avg = delta_frames ? static_cast<double>(bytes - key_bytes) / delta_frames : 0.0;
+        double idr_extra = static_cast<double>(key_bytes) - key_frames * delta_avg;
+        double idr_kbps = dt > 0.0 ? std::max(0.0, idr_extra) * 8.0 / dt / 1000.0 : 0.0;
+        double gop_s = fps > 0.0 ? gop / fps : 0.0;
+        uint64_t answered = pli_answered_.exchange(0);
+        int64_t answer_ms = pli_to_idr_ms_.exchange(0);
+
+        std::cout << "[STATS] gop: frames=" << gop
+                  << " (" << std::setprecision(1) << gop_s << "s)"
+                  << " | loss=" << std::setprecision(2) << gop_loss_ppm_.load() / 1e4 << "%"
+                  << " | pli=" << gop_pli_rate_milli_.load() / 1000.0 << "/s"
+                  << " | clients=" << gop_clients_.load()
+                  << " | idrs=" << key_frames
+                  << " | idr_overhead=" << std::setprecision(0) << idr_kbps << "kbps"
+                  << " | freeze_no_pli~" << gop_s * 500.0 << "ms";
+        if (answered) {
+            std::cout << " | pli_to_idr=" << answer_ms / static_cast<int64_t>(answered) << "ms";
+        }
+        std::cout << std::endl;
+    }
+
+    uint64_t soft = stalls_soft_.exchange(0);
+    uint64_t hard = stalls_hard_.exchange(0);
+    if (soft + hard > 0) {
+        std::cout << "[STATS] stalls: soft=" << soft << " | hard=" << hard
+                  << " | detected_after=" << (soft ? stall_detect_ms_.exchange(0) / (int64_t)soft : 0) << "ms"
+                  << " | action_latency=" << stall_action_us_.exchange(0) / (int64_t)(soft + hard) << "us"
+                  << " (max " << stall_action_max_us_.exchange(0) << "us)"
+                  << std::endl;
+    }
+
+    uint64_t splices = splices_.load();
+    if (splices > 0) {
+        std::cout << "[STATS] splice: restarts_spliced=" << splices
+                  << " | last_outage=" << splice_last_ms_.load() << "ms"
+                  << " | max_outage=" << splice_max_ms_.load() << "ms"
+                  << std::endl;
+    }
+
+    uint64_t ipc = ipc_frames_.exchange(0);
+    if (ipc > 0 || worker_restarts_.load() > 0) {
+        int64_t handoff = ipc ? ipc_handoff_us_.exchange(0) / (int64_t)ipc : 0;
+        std::cout << "[STATS] ipc: frames=" << ipc
+                  << " | handoff=" << handoff << "us (max " << ipc_handoff_max_us_.exchange(0) << "us)"
+                  << " | overruns=" << ipc_overruns_.load()
+                  << " | worker_restarts=" << worker_restarts_.load()
+                  << std::endl;
+    }
+
+    // GstMemory only (GstBuffer/GstSample structs still come from g_slice). Steady
+    // state should show unpooled 0.0: every block from a warmed-up size class
+    uint64_t pooled = allocs_pooled_.exchange(0);
+    uint64_t mallocs = allocs_unpooled_.exchange(0);
+    uint64_t interval_frames = current_frames >= prev_frames ? current_frames - prev_frames : 0;
+    if (pooled + mallocs > 0 && interval_frames > 0) {
+        std::cout << "[STATS] alloc: mem_allocs/frame=" << std::fixed << std::setprecision(1)
+                  << static_cast<double>(pooled + mallocs) / interval_frames
+                  << " (unpooled " << static_cast<double>(mallocs) / interval_frames << ")"
+                  << " | latency=" << alloc_ns_.exchange(0) / (int64_t)(pooled + mallocs) << "ns"
+                  << " (max " << alloc_max_ns_.exchange(0) << "ns)"
+                  << " | arena=" << arena_reserved_.load() / (1024 * 1024) << "/"
+                  << arena_cap_.load() / (1024 * 1024) << "MB"
+                  << std::endl;
+    }
+
+    // Stripped per type against the encoder's output over the same interval
+    std::ostringstream trim;
+    uint64_t trimmed = 0;
+    for (uint8_t t = 0; t < 32; t++) {
+        uint64_t b = strip_bytes_[t].exchange(0);
+        if (!b) continue;
+        const char* name = h264_nal_type_name(t);
+        trim << (trimmed ? " " : "") << (name ? name : "nal" + std::to_string(t)) << "="
+             << std::fixed << std::setprecision(1) << (dt > 0.0 ? b * 8.0 / dt / 1000.0 : 0.0) << "kbps";
+        trimmed += b;
+    }
+    int64_t boost = filler_boost_kbps_.load();
+    if (trimmed > 0 || boost >= 0) {
+        std::cout << "[STATS] trim: " << (trimmed ? trim.str() : "none")
+                  << " (" << std::fixed << std::setprecision(1)
+                  << (bytes ? 100.0 * trimmed / bytes : 0.0) << "% of output)";
+        if (boost >= 0) std::cout << " | filler_headroom=+" << boost << "kbps";
+        std::cout << std::endl;
+    }
+
+    uint64_t decisions = admitted_[0].load() + admitted_[1].load() + admitted_[2].load() + rejected_.load();
+    if (decisions > 0) {
+        static const char* kClassNames[3] = {"priority", "full", "reduced"};
+        int64_t reserved = egress_kbps_[0].load() + egress_kbps_[1].load() + egress_kbps_[2].load();
+        int64_t budget = egress_budget_kbps_.load();
+        std::cout << "[STATS] admission: egress=" << reserved;
+        if (budget > 0) std::cout << "/" << budget;
+        std::cout << "kbps reserved |";
+        for (int i = 0; i < 3; i++) {
+            std::cout << " " << kClassNames[i] << "=" << egress_sessions_[i].load()
+                      << " (" << egress_kbps_[i].load() << "kbps)";
+        }
+        std::cout << " | admitted=" << admitted_[0].load() + admitted_[1].load()
+                  << " downgraded=" << admitted_[2].load()
+                  << " rejected=" << rejected_.load() << std::endl;
+    }
+
+    int64_t active_ms = idle_wall_ms_[0].load(), idle_ms = idle_wall_ms_[1].load();
+    if (active_ms + idle_ms > 0) {
+        // CPU as a share of one core; power averaged over the ticks that had a reading
+        auto cpu_pct = [&](int i, int64_t ms) { return ms > 0 ? idle_cpu_us_[i].load() / (ms * 10.0) : 0.0; };
+        std::cout << std::fixed << std::setprecision(1)
+                  << "[STATS] idle: paused " << 100.0 * idle_ms / (active_ms + idle_ms) << "% of the time"
+                  << " | cpu active=" << cpu_pct(0, active_ms) << "% idle=" << cpu_pct(1, idle_ms) << "%";
+        int64_t pa = idle_power_ms_[0].load(), pi = idle_power_ms_[1].load();
+        if (pa > 0 || pi > 0) {
+            std::cout << " | power active=" << (pa ? idle_energy_mj_[0].load() / (double)pa : 0.0)
+                      << "W idle=" << (pi ? idle_energy_mj_[1].load() / (double)pi : 0.0) << "W";
+        }
+        static const char* kResumeNames[2] = {"paused", "torn_down"};
+        for (int i = 0; i < 2; i++) {
+            uint64_t n = resumes_[i].load();
+            if (!n) continue;
+            std::cout << " | resume " << kResumeNames[i] << ": n=" << n << " last=" << resume_last_ms_[i].load()
+                      << "ms max=" << resume_max_ms_[i].load() << "ms";
+        }
+        std::cout << std::endl;
+    }
+
+    if (thermal_read_.load()) {
+        std::cout << std::fixed << std::setprecision(1) << "[STATS] thermal:";
+        int64_t temp = thermal_temp_milli_.load();
+        if (temp > -273000) {
+            std::cout << " " << temp / 1000.0 << "C, headroom " << thermal_headroom_milli_.load() / 1000.0 << "C";
+        }
+        int64_t cpu = thermal_cpu_permille_.load(), gpu = thermal_gpu_permille_.load();
+        if (cpu >= 0) std::cout << " | cpu clock " << cpu / 10.0 << "%";
+        if (gpu >= 0) std::cout << " | gpu clock " << gpu / 10.0 << "%";
+        std::cout << " | level " << thermal_level_.load() << "/" << thermal_levels_.load()
+                  << " | down=" << thermal_steps_[0].load() << " up=" << thermal_steps_[1].load() << std::endl;
+    }
+
+    uint64_t stripped = ps_stripped_.load();
+    if (stripped > 0 || ps_injected_.load() > 0) {
+        // Net of what joining clients were sent instead
+        double hours = std::chrono::duration<double>(Clock::now() - created_).count() / 3600.0;
+        uint64_t saved = ps_saved_bytes_.load();
+        uint64_t injected = ps_injected_bytes_.load();
+        double net = saved > injected ? (double)(saved - injected) : 0.0;
+        std::cout << "[STATS] param sets: saved=" << std::fixed << std::setprecision(1)
+                  << (hours > 0 ? net / 1024.0 / hours : 0.0) << "KB/h"
+                  << " (" << stripped << " IDRs stripped)"
+                  << " | joins=" << ps_injected_.load()
+                  << " | in-band=" << ps_changes_.load()
+                  << std::endl;
+    }
+
+    uint64_t scans = scans_.exchange(0);
+    if (scans > 0) {
+        std::cout << "[STATS] parse: scan=" << scan_ns_.exchange(0) / (int64_t)scans << "ns/frame"
+                  << " (max " << scan_max_ns_.exchange(0) << "ns)"
+                  << " | nals=" << std::fixed << std::setprecision(1)
+                  << (double)scan_nals_.exchange(0) / scans << "/frame"
+                  << std::endl;
+    }
+
+    // Buffer depth between converter and appsink: what memory.*_buffers trade against lost frames
+    uint64_t transits = transit_frames_.exchange(0);
+    if (transits > 0) {
+        std::cout << "[STATS] buffers: transit=" << std::fixed << std::setprecision(1)
+                  << transit_us_.exchange(0) / (double)transits / 1000.0 << "ms"
+                  << " (max " << transit_max_us_.exchange(0) / 1000.0 << "ms)"
+                  << " | lost=" << frames_lost_.load()
+                  << std::endl;
+    }
+
+    // Queue fill: a boundary sitting near capacity is where back-pressure builds
+    {
+        static const char* names[4] = {"decode", "convert", "encode", "output"};
+        std::ostringstream line;
+        for (int i = 0; i < 4; i++) {
+            uint64_t n = queue_samples_[i].exchange(0);
+            if (!n) continue;
+            line << (line.tellp() > 0 ? " | " : " ") << names[i] << "="
+                 << std::fixed << std::setprecision(1) << (double)queue_level_sum_[i].exchange(0) / n
+                 << "/" << queue_capacity_[i].load()
+                 << " (max " << queue_level_max_[i].exchange(0) << ", full " << queue_full_[i].exchange(0) << ")";
+        }
+        if (line.tellp() > 0) std::cout << "[STATS] queues:" << line.str() << std::endl;
+    }
+
+    if (tier_count_[0].load() + tier_count_[1].load() + tier_count_[2].load() > 0) {
+        static const char* names[3] = {"source", "decoder", "full"};
+        std::cout << "[STATS] restarts:";
+        for (int i = 0; i < 3; i++) {
+            uint64_t n = tier_count_[i].load();
+            if (i) std::cout << " |";
+            std::cout << " " << names[i] << "=" << n;
+            if (n) {
+                std::cout << " (rebuild " << tier_rebuild_ms_[i].load() / (int64_t)n << "ms"
+                          << ", to_frame " << tier_total_ms_[i].load() / (int64_t)n << "ms)";
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    uint64_t recoveries = recoveries_.exchange(0);
+    if (recoveries > 0) {
+        double rec_ms = static_cast<double>(recovery_ms_.exchange(0)) / recoveries;
+        double excess_kb = static_cast<double>(recovery_excess_bytes_.exchange(0)) / recoveries / 1024.0;
+        double peak = static_cast<double>(recovery_peak_milli_.exchange(0)) / 1000.0;
+        // Intra refresh ends after one sweep by definition: that is the
+        // configured sweep length, not a measured heal time
+        const char* mode = recovery_mode_.load();
+        bool sweep = mode && strcmp(mode, "intra_refresh") == 0;
+        std::cout << "[STATS] recovery: mode=" << mode
+                  << " | events=" << recoveries
+                  << (sweep ? " | sweep=" : " | time=") << std::fixed << std::setprecision(0) << rec_ms << "ms"
+                  << " | excess=" << std::setprecision(1) << excess_kb << "KB"
+                  << " | peak=" << peak << "xP"
+                  << std::endl;
+    }
+
+    uint64_t mframes = mosaic_frames_.exchange(0);
+    if (mframes > 0) {
+        double cost_ms = static_cast<double>(mosaic_cost_us_.exchange(0)) / mframes / 1000.0;
+        double lat_ms = static_cast<double>(mosaic_latency_us_.exchange(0)) / mframes / 1000.0;
+        double lat_max_ms = static_cast<double>(mosaic_latency_max_us_.exchange(0)) / 1000.0;
+        uint64_t slots = mosaic_slots_.exchange(0);
+        uint64_t reused = mosaic_reused_.exchange(0);
+        std::cout << "[STATS] mosaic: frames=" << mframes
+                  << " | cost=" << std::fixed << std::setprecision(2) << cost_ms << "ms"
+                  << " | added_latency=" << lat_ms << "ms (max " << lat_max_ms << "ms)"
+                  << " | reused_tiles=" << std::setprecision(1)
+                  << (slots ? 100.0 * reused / slots : 0.0) << "%"
+                  << std::endl;
+    }
+
+    uint64_t dframes = denoise_frames_.exchange(0);
+    uint64_t qn[2] = {qp_frames_[0].exchange(0), qp_frames_[1].exchange(0)};
+    uint64_t qs[2] = {qp_sum_[0].exchange(0), qp_sum_[1].exchange(0)};
+    // An interval all "off" (A/B phase) still prints: it is the baseline
+    if (dframes > 0 || qn[0] > 0 || qn[1] > 0) {
+        double cost_ms = dframes ? static_cast<double>(denoise_cost_us_.exchange(0)) / dframes / 1000.0 : 0.0;
+        double cost_max_ms = static_cast<double>(denoise_cost_max_us_.exchange(0)) / 1000.0;
+        double dpsnr = dframes ? static_cast<double>(denoise_psnr_milli_db_.exchange(0)) / dframes / 1000.0 : 0.0;
+        std::cout << "[STATS] denoise: frames=" << dframes
+                  << " | cost=" << std::fixed << std::setprecision(2) << cost_ms
+                  << "ms (max " << cost_max_ms << "ms)"
+                  << " | overruns=" << denoise_overruns_.exchange(0)
+                  << " | delta_psnr=" << std::setprecision(1) << dpsnr << "dB";
+        for (int on = 1; on >= 0; on--) {
+            if (qn[on] == 0) continue;
+            double qp = static_cast<double>(qs[on]) / qn[on];
+            std::cout << " | " << (on ? "on" : "off") << ": qp=" << qp
+                      << " psnr_est=" << qp_to_psnr_estimate(qp) << "dB";
+        }
+        std::cout << std::endl;
+    }
 }
@@ -1,10 +1,17 @@
 #pragma once
 
+#include "restart_tier.hpp"
 #include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <string>
 
+/// Optional queues between encoder stages (see QueuesConfig).
+enum class QueueBoundary { Decode = 0, Convert = 1, Encode = 2, Output = 3 };
+
+/// Egress admission classes (see AdmissionControl).
+enum class EgressClass { Priority = 0, Full = 1, Reduced = 2 };
+
 /// Real-time statistics tracking for the encoder pipeline.
 /// Thread-safe — counters can be updated from GStreamer callback threads.
 
@@ -15,8 +22,107 @@ public:
     /// Call when pipeline starts/restarts to reset frame counters.
     void reset();
 
-    /// Call on each encoded frame.
-    void on_frame_encoded();
+    /// Call on each encoded frame (access unit size, IDR or not).
+    void on_frame_encoded(uint64_t bytes, bool keyframe);
+
+    /// Adaptive GOP state, pushed once per controller tick.
+    void on_gop_update(int gop_frames, double loss_fraction, double pli_rate, int clients);
+
+    /// A PLI was answered by an IDR this many ms after it arrived.
+    void on_pli_answered(int64_t ms);
+
+    /// A loss recovery completed: loss event → picture healed, bytes spent
+    /// beyond the average P-frame rate, and the largest frame / average P-frame.
+    void on_recovery(const char* mode, int64_t ms, int64_t excess_bytes, double peak_ratio);
+
+    /// Output resumed after an encoder restart; `outage_ms` is the gap
+    /// clients saw between the last old and first new frame.
+    void on_splice(int64_t outage_ms);
+
+    /// A tiered restart completed: time spent rebuilding, and from the
+    /// start of the restart to the first encoded frame.
+    void on_restart_tier(RestartTier tier, int64_t rebuild_ms, int64_t total_ms);
+
+    /// A stall reaction ran: soft or hard, how long output had been stalled
+    /// when it was detected, and deadline → action-completed latency.
+    void on_stall(bool hard, int64_t stalled_ms, int64_t action_us);
+
+    /// Split mode: an access unit crossed from the encoder worker process,
+    /// `handoff_us` after the worker wrote it into the shared-memory ring.
+    void on_ipc_frame(int64_t handoff_us);
+
+    /// Split mode: the reader fell a whole ring behind and skipped ahead.
+    void on_ipc_overrun();
+
+    /// Split mode: the encoder worker exited or was killed and is respawned.
+    void on_worker_restart();
+
+    /// Buffer memory allocated (arena_allocator.hpp): from a size class
+    /// (`pooled`) or from the system allocator, and how long it took.
+    void on_alloc(int64_t ns, bool pooled);
+
+    /// The arena reserved another chunk.
+    void on_arena_reserved(uint64_t reserved_bytes, uint64_t cap_bytes);
+
+    /// An encoded access unit was scanned for its NAL units (once per frame).
+    void on_au_scan(int64_t ns, size_t nals);
+
+    /// An IDR went out without its unchanged SPS/PPS (`bytes`), which each
+    /// of `clients` would otherwise have received.
+    void on_param_sets_stripped(uint64_t bytes, int clients);
+
+    /// The encoder's SPS/PPS changed (or were first seen): sent in-band.
+    void on_param_sets_changed();
+
+    /// A joining client was sent the cached SPS/PPS.
+    void on_param_sets_injected(uint64_t bytes);
+
+    /// NAL units of H.264 type `nal_type` were dropped from an access unit
+    /// on its way out (`output.strip_nals`).
+    void on_nal_stripped(uint8_t nal_type, uint64_t bytes);
+
+    /// The encoder target now includes `boost_kbps` of reclaimed filler.
+    void on_filler_headroom(int64_t boost_kbps);
+
+    /// A frame left the encoder chain `transit_us` after entering the
+    /// converter (the buffer depth between them sets this floor).
+    void on_transit(int64_t transit_us);
+
+    /// Frames that entered the converter and never came out (dropped for
+    /// want of a free buffer downstream, or by the encoder).
+    void on_frames_lost(uint64_t frames);
+
+    /// A buffer left a stage queue with `level` buffers still queued behind
+    /// it (of `capacity`).
+    void on_queue_level(QueueBoundary queue, uint32_t level, uint32_t capacity);
+
+    /// A stage queue filled up (upstream blocks, or it drops if leaky).
+    void on_queue_full(QueueBoundary queue);
+
+    /// An RTSP session was admitted in `cls`, or refused for want of budget.
+    void on_admitted(EgressClass cls);
+    void on_rejected();
+
+    /// Sessions and reserved egress per class (indexed by EgressClass)
+    /// after an admission or release, against `budget_kbps` (0 = none).
+    void on_egress_reserved(const int sessions[3], const int64_t kbps[3], int64_t budget_kbps);
+
+    /// One control tick of `wall_s` spent active or idle (`idle.*`), with the
+    /// process CPU time used in it and the board power (mW, < 0 if unknown).
+    void on_idle_sample(bool idle, double wall_s, double cpu_s, double power_mw);
+
+    /// First encoded frame `ms` after a client woke a paused (or torn
+    /// down) encoder.
+    void on_idle_resume(int64_t ms, bool from_teardown);
+
+    /// Thermal governor reading: hottest zone and its headroom to the
+    /// throttle point (°C; temp_c -273 if unread), CPU/GPU clock cap as a fraction
+    /// of the maximum (< 0 if unread), and the level it holds of `levels`.
+    void on_thermal_reading(double temp_c, double headroom_c, double cpu_clock, double gpu_clock,
+                            int level, int levels);
+
+    /// The governor stepped quality down (hotter) or back up.
+    void on_thermal_step(bool down);
 
     /// Increment reconnect counter.
     void on_reconnect();
@@ -24,6 +130,20 @@ public:
     /// Increment pipeline restart counter.
     void on_pipeline_restart();
 
+    /// Call on each composited mosaic frame.
+    /// cost_us: newest input arrival → composite out (compositing + aggregation).
+    /// latency_us: oldest fresh input arrival → composite out (added latency).
+    void on_mosaic_frame(int64_t cost_us, int64_t latency_us,
+                         uint32_t inputs, uint32_t reused_inputs);
+
+    /// Call per denoised frame: kernel cost, whether it broke the budget,
+    /// and the PSNR between the filter's input and output (how much it changed).
+    void on_denoise_frame(int64_t cost_us, bool over_budget, double delta_psnr_db);
+
+    /// Call per encoded frame with its slice QP, tagged by whether the
+    /// denoiser was filtering when the frame was produced.
+    void on_frame_qp(int qp, bool denoised);
+
     /// Print current stats to stdout.
     void print() const;
 
@@ -49,7 +169,135 @@ private:
     TimePoint start_time_ = Clock::now();
     mutable std::atomic<int64_t> last_frame_time_ns_{0};
 
+    // Encoded bytes, split by frame type, accumulated over one stats interval
+    mutable std::atomic<uint64_t> bytes_{0};
+    mutable std::atomic<uint64_t> key_bytes_{0};
+    mutable std::atomic<uint64_t> key_frames_{0};
+
+    // Adaptive GOP (latest controller state + PLI→IDR latency per interval)
+    std::atomic<int> gop_frames_{0};
+    std::atomic<int> gop_clients_{0};
+    std::atomic<int64_t> gop_loss_ppm_{0};
+    std::atomic<int64_t> gop_pli_rate_milli_{0};
+    mutable std::atomic<uint64_t> pli_answered_{0};
+    mutable std::atomic<int64_t> pli_to_idr_ms_{0};
+
+    // Loss recovery, accumulated over one stats interval
+    std::atomic<const char*> recovery_mode_{nullptr};
+    mutable std::atomic<uint64_t> recoveries_{0};
+    mutable std::atomic<int64_t> recovery_ms_{0};
+    mutable std::atomic<int64_t> recovery_excess_bytes_{0};
+    mutable std::atomic<int64_t> recovery_peak_milli_{0};
+
+    // Encoder restarts spliced under connected clients (lifetime)
+    std::atomic<uint64_t> splices_{0};
+    std::atomic<int64_t> splice_last_ms_{0};
+    std::atomic<int64_t> splice_max_ms_{0};
+
+    // Tiered restarts (lifetime), indexed by RestartTier
+    std::atomic<uint64_t> tier_count_[3] = {};
+    std::atomic<int64_t> tier_rebuild_ms_[3] = {};
+    std::atomic<int64_t> tier_total_ms_[3] = {};
+
+    // Stall detection, accumulated over one stats interval
+    mutable std::atomic<uint64_t> stalls_soft_{0};
+    mutable std::atomic<uint64_t> stalls_hard_{0};
+    mutable std::atomic<int64_t> stall_detect_ms_{0};
+    mutable std::atomic<int64_t> stall_action_us_{0};
+    mutable std::atomic<int64_t> stall_action_max_us_{0};
+
+    // Split mode: worker → server hand-off (interval), overruns and respawns (lifetime)
+    mutable std::atomic<uint64_t> ipc_frames_{0};
+    mutable std::atomic<int64_t> ipc_handoff_us_{0};
+    mutable std::atomic<int64_t> ipc_handoff_max_us_{0};
+    std::atomic<uint64_t> ipc_overruns_{0};
+    std::atomic<uint64_t> worker_restarts_{0};
+
+    // GstMemory allocator: calls per interval, arena size (lifetime)
+    mutable std::atomic<uint64_t> allocs_pooled_{0};
+    mutable std::atomic<uint64_t> allocs_unpooled_{0};
+    mutable std::atomic<int64_t> alloc_ns_{0};
+    mutable std::atomic<int64_t> alloc_max_ns_{0};
+    std::atomic<uint64_t> arena_reserved_{0};
+    std::atomic<uint64_t> arena_cap_{0};
+
+    // Access unit scan, accumulated over one stats interval
+    mutable std::atomic<uint64_t> scans_{0};
+    mutable std::atomic<int64_t> scan_ns_{0};
+    mutable std::atomic<int64_t> scan_max_ns_{0};
+    mutable std::atomic<uint64_t> scan_nals_{0};
+
+    // Out-of-band parameter sets (lifetime; the rate spans the process, not restarts)
+    const TimePoint created_ = Clock::now();
+    std::atomic<uint64_t> ps_saved_bytes_{0};
+    std::atomic<uint64_t> ps_stripped_{0};
+    std::atomic<uint64_t> ps_changes_{0};
+    std::atomic<uint64_t> ps_injected_{0};
+    std::atomic<uint64_t> ps_injected_bytes_{0};
+
+    // Stripped NAL units by type, accumulated over one stats interval; filler headroom (latest)
+    mutable std::atomic<uint64_t> strip_bytes_[32] = {};
+    std::atomic<int64_t> filler_boost_kbps_{-1};
+
+    // Converter → appsink transit, accumulated over one stats interval; lost frames (lifetime)
+    mutable std::atomic<uint64_t> transit_frames_{0};
+    mutable std::atomic<int64_t> transit_us_{0};
+    mutable std::atomic<int64_t> transit_max_us_{0};
+    std::atomic<uint64_t> frames_lost_{0};
+
+    // Stage queues, indexed by QueueBoundary, accumulated over one stats interval
+    mutable std::atomic<uint64_t> queue_samples_[4] = {};
+    mutable std::atomic<uint64_t> queue_level_sum_[4] = {};
+    mutable std::atomic<int64_t> queue_level_max_[4] = {};
+    mutable std::atomic<uint64_t> queue_full_[4] = {};
+    std::atomic<uint32_t> queue_capacity_[4] = {};
+
+    // Egress admission: decisions (lifetime), reservations (latest), indexed by EgressClass
+    std::atomic<uint64_t> admitted_[3] = {};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<int> egress_sessions_[3] = {};
+    std::atomic<int64_t> egress_kbps_[3] = {};
+    std::atomic<int64_t> egress_budget_kbps_{0};
+
+    // On-demand encoding, indexed [active, idle]: wall ms, CPU µs, energy mJ over ticks with a power reading
+    std::atomic<int64_t> idle_wall_ms_[2] = {};
+    std::atomic<int64_t> idle_cpu_us_[2] = {};
+    std::atomic<int64_t> idle_energy_mj_[2] = {};
+    std::atomic<int64_t> idle_power_ms_[2] = {};
+    std::atomic<uint64_t> resumes_[2] = {};          // [paused, torn down]
+    std::atomic<int64_t> resume_last_ms_[2] = {};
+    std::atomic<int64_t> resume_max_ms_[2] = {};
+
+    // Thermal governor (latest reading in m°C / per mille; steps since start)
+    std::atomic<int64_t> thermal_temp_milli_{0};
+    std::atomic<int64_t> thermal_headroom_milli_{0};
+    std::atomic<int64_t> thermal_cpu_permille_{-1};
+    std::atomic<int64_t> thermal_gpu_permille_{-1};
+    std::atomic<bool> thermal_read_{false};
+    std::atomic<int> thermal_level_{0};
+    std::atomic<int> thermal_levels_{0};
+    std::atomic<uint64_t> thermal_steps_[2] = {};   // [down, up]
+
     // For FPS calculation
     mutable std::atomic<uint64_t> last_fps_frame_count_{0};
     mutable std::atomic<int64_t> last_fps_time_ns_{0};
+
+    // Mosaic compositor, accumulated over one stats interval
+    mutable std::atomic<uint64_t> mosaic_frames_{0};
+    mutable std::atomic<int64_t> mosaic_cost_us_{0};
+    mutable std::atomic<int64_t> mosaic_latency_us_{0};
+    mutable std::atomic<int64_t> mosaic_latency_max_us_{0};
+    mutable std::atomic<uint64_t> mosaic_slots_{0};
+    mutable std::atomic<uint64_t> mosaic_reused_{0};
+
+    // Denoise stage, accumulated over one stats interval
+    mutable std::atomic<uint64_t> denoise_frames_{0};
+    mutable std::atomic<int64_t> denoise_cost_us_{0};
+    mutable std::atomic<int64_t> denoise_cost_max_us_{0};
+    mutable std::atomic<uint64_t> denoise_overruns_{0};
+    mutable std::atomic<int64_t> denoise_psnr_milli_db_{0};
+
+    // Encoded slice QP split by denoise phase (index 0 = off, 1 = on)
+    mutable std::atomic<uint64_t> qp_frames_[2] = {{0}, {0}};
+    mutable std::atomic<uint64_t> qp_sum_[2] = {{0}, {0}};
 };
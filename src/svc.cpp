@@ -0,0 +1,63 @@
+#include "svc.hpp"
+#include "h264.hpp"
+#include <algorithm>
+
+/// Minimum spacing of layer drops (one per step, so the drop is gradual).
+static constexpr int kShedIntervalMs = 500;
+
+int svc_b_frames(int temporal_layers) {
+    return temporal_layers >= 2 ? (1 << (temporal_layers - 1)) - 1 : 0;
+}
+
+int TemporalLayerTagger::tag(const uint8_t* data, size_t size) {
+    if (layers_ < 2) return 0;
+    return tag(h264_split_nals(data, size));
+}
+
+int TemporalLayerTagger::tag(const std::vector<NalUnit>& nals) {
+    if (layers_ < 2) return 0;
+    for (const NalUnit& nal : nals) {
+        if (nal.type != NAL_SLICE && nal.type != NAL_IDR) continue;
+        if (nal.ref_idc != 0) {
+            run_ = 0;
+            return 0;
+        }
+        int pos = run_++;
+        if (layers_ == 2) return 1;
+        return pos == 1 ? 1 : 2;   // B0 B1 B2: the middle one halves the gap
+    }
+    return 0;
+}
+
+LayerSelector::LayerSelector(const ConfigStore& config)
+    : config_(config), layer_(config->svc.temporal_layers - 1) {}
+
+void LayerSelector::on_backlog(uint64_t bytes) {
+    const SvcConfig& sc = config_->svc;
+    auto now = Clock::now();
+    double backlog_ms = static_cast<double>(bytes) * 8.0 /
+                        std::max<uint32_t>(config_->encoder.target_bitrate_kbps, 1);
+    bool pressure = backlog_ms > sc.backlog_high_ms ||
+                    loss_ewma_ * 100.0 > sc.loss_high_pct;
+
+    auto since = [now](Clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now - t).count();
+    };
+
+    if (pressure) {
+        last_pressure_ = now;
+        if (layer_ > 0 && since(last_change_) >= kShedIntervalMs) {
+            layer_--;
+            last_change_ = now;
+        }
+    } else if (layer_ < sc.temporal_layers - 1 &&
+               since(last_pressure_) >= sc.raise_after_s * 1000 &&
+               since(last_change_) >= sc.raise_after_s * 1000) {
+        layer_++;
+        last_change_ = now;
+    }
+}
+
+void LayerSelector::on_loss_report(double fraction_lost) {
+    loss_ewma_ = 0.7 * loss_ewma_ + 0.3 * fraction_lost;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "config.hpp"
+#include "h264.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/// Temporal scalability without an SVC encoder.
+///
+/// nvv4l2h264enc has no hierarchical-P mode, but its B-frames are never
+/// used as references, so any subset of them can be dropped without
+/// breaking decode. With `svc.temporal_layers`:
+///   2 → 1 B per P:  T0 = P/IDR (fps/2), T1 = B
+///   3 → 3 B per P:  T0 = P/IDR (fps/4), T1 = middle B (→ fps/2), T2 = other Bs
+/// The cost is B-frame reordering delay: 1 (2 layers) or 3 (3 layers)
+/// frame periods at the encoder.
+
+/// B-frames per P-frame for a layer count (0 when layering is off).
+int svc_b_frames(int temporal_layers);
+
+/// Assigns each encoded access unit its temporal layer from nal_ref_idc
+/// and its position in the run of non-reference frames.
+/// Touched only by the appsink streaming thread.
+class TemporalLayerTagger {
+public:
+    explicit TemporalLayerTagger(int temporal_layers) : layers_(temporal_layers) {}
+
+    void reset() { run_ = 0; }
+
+    /// Temporal id of the access unit (0 = base layer).
+    int tag(const uint8_t* data, size_t size);
+
+    /// Same, from NAL units already scanned.
+    int tag(const std::vector<NalUnit>& nals);
+
+private:
+    int layers_;
+    int run_ = 0;   // non-reference frames since the last reference frame
+};
+
+/// Per-client choice of the highest temporal layer to forward.
+/// Sheds a layer when the client's send backlog or reported loss is high,
+/// adds one back after `svc.raise_after_s` clean seconds.
+class LayerSelector {
+public:
+    explicit LayerSelector(const ConfigStore& config);
+
+    /// Bytes queued towards the client (appsrc level). Re-evaluates the layer.
+    void on_backlog(uint64_t bytes);
+
+    /// Receiver-report fraction lost (0.0-1.0) from this client.
+    void on_loss_report(double fraction_lost);
+
+    int max_layer() const { return layer_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const ConfigStore& config_;
+    int layer_;
+    double loss_ewma_ = 0.0;
+    Clock::time_point last_change_{};
+    Clock::time_point last_pressure_{};
+};
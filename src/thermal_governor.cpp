@@ -0,0 +1,160 @@
+#include "thermal_governor.hpp"
+#include <glob.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+/// Faster first; encoder.cpp accepts both spellings.
+static const char* kPresets[] = {"ultrafast", "fast", "medium", "slow"};
+
+int preset_speed_rank(const std::string& preset) {
+    if (preset == "UltraLowLatency" || preset == "ultrafast") return 0;
+    if (preset == "LowLatency" || preset == "fast")           return 1;
+    if (preset == "HP" || preset == "medium")                  return 2;
+    if (preset == "HQ" || preset == "slow")                    return 3;
+    return 2;
+}
+
+std::string faster_preset(const std::string& preset, int steps) {
+    int rank = preset_speed_rank(preset);
+    int faster = std::max(0, rank - std::max(0, steps));
+    return faster == rank ? preset : kPresets[faster];
+}
+
+static std::vector<std::string> expand(const std::string& pattern) {
+    std::vector<std::string> paths;
+    glob_t g{};
+    if (!pattern.empty() && glob(pattern.c_str(), 0, nullptr, &g) == 0) {
+        for (size_t i = 0; i < g.gl_pathc; i++) paths.emplace_back(g.gl_pathv[i]);
+    }
+    globfree(&g);
+    return paths;
+}
+
+static std::string first_match(const std::string& pattern) {
+    std::vector<std::string> paths = expand(pattern);
+    return paths.empty() ? std::string() : paths.front();
+}
+
+/// Largest number in a sysfs file (one value, or a list such as
+/// available_frequencies); false if there is none.
+static bool read_max_number(const std::string& path, double& value) {
+    std::ifstream f(path);
+    double v;
+    bool any = false;
+    while (f >> v) {
+        value = any ? std::max(value, v) : v;
+        any = true;
+    }
+    return any;
+}
+
+void ThermalGovernor::open() {
+    const ThermalConfig& tc = config_->thermal;
+    zones_.clear();
+    for (const auto& z : tc.zones) {
+        for (auto& p : expand(z)) zones_.push_back(std::move(p));
+    }
+    cpu_cap_ = first_match(tc.cpu_freq_cap);
+    gpu_cap_ = first_match(tc.gpu_freq_cap);
+    // Baseline: the power mode's caps as they are now
+    cpu_base_ = gpu_base_ = 0.0;
+    clock_ratio(cpu_cap_, cpu_base_);
+    clock_ratio(gpu_cap_, gpu_base_);
+    level_ = std::min(level_, (int)tc.steps.size());
+    warned_ = false;
+    if (!tc.enabled) return;
+    std::cout << "[THERMAL] " << zones_.size() << " zone(s), cpu clock " << (cpu_cap_.empty() ? "not read" : cpu_cap_)
+              << ", gpu clock " << (gpu_cap_.empty() ? "not read" : gpu_cap_) << std::endl;
+}
+
+bool ThermalGovernor::read_temp(double& celsius) const {
+    bool any = false;
+    for (const auto& z : zones_) {
+        double m;
+        std::ifstream f(z);
+        if (!(f >> m)) continue;
+        // Unpopulated sensors read as large negatives
+        if (m < -40000.0) continue;
+        celsius = any ? std::max(celsius, m / 1000.0) : m / 1000.0;
+        any = true;
+    }
+    return any;
+}
+
+/// Allowed clock over `baseline`, which rises to any higher cap read; < 0
+/// if not read.
+double ThermalGovernor::clock_ratio(const std::string& cap, double& baseline) {
+    double c;
+    if (cap.empty() || !read_max_number(cap, c) || c <= 0) return -1.0;
+    baseline = std::max(baseline, c);
+    return c / baseline;
+}
+
+QualityLevel ThermalGovernor::quality() const {
+    const ThermalConfig& tc = config_->thermal;
+    QualityLevel q;
+    for (int i = 0; i < level_ && i < (int)tc.steps.size(); i++) {
+        const std::string& s = tc.steps[i];
+        if (s == "resolution")  q.scale *= tc.resolution_scale;
+        else if (s == "fps")    q.fps_divisor *= 2;
+        else if (s == "preset") q.preset_steps++;
+    }
+    return q;
+}
+
+bool ThermalGovernor::tick() {
+    const ThermalConfig& tc = config_->thermal;
+    if (!tc.enabled) {
+        if (level_ == 0) return false;
+        level_ = 0;   // switched off by a reload: back to full quality
+        return true;
+    }
+
+    double temp = 0.0;
+    bool have_temp = read_temp(temp);
+    double cpu = clock_ratio(cpu_cap_, cpu_base_);
+    double gpu = clock_ratio(gpu_cap_, gpu_base_);
+    if (!have_temp && cpu < 0 && gpu < 0) {
+        if (!warned_) std::cerr << "[THERMAL] No readable zone or clock: governor idle" << std::endl;
+        warned_ = true;
+        return false;
+    }
+    double headroom = tc.throttle_c - temp;
+
+    // A cap under 98% of the power mode's is a cooling device at work
+    bool capped = (cpu >= 0 && cpu < 0.98) || (gpu >= 0 && gpu < 0.98);
+    bool hot = capped || (have_temp && headroom <= tc.down_headroom_c);
+    bool cool = !capped && (!have_temp || headroom >= tc.up_headroom_c);
+    auto now = Clock::now();
+    int levels = (int)tc.steps.size();
+    int prev = level_;
+
+    if (hot) {
+        cool_ = false;
+        if (level_ < levels && now - last_step_ >= std::chrono::seconds(tc.step_down_s)) level_++;
+    } else if (cool) {
+        if (!cool_) { cool_ = true; cool_since_ = now; }
+        if (level_ > 0 && now - cool_since_ >= std::chrono::seconds(tc.step_up_s)) {
+            level_--;
+            cool_since_ = now;   // each step up waits out its own interval
+        }
+    } else {
+        cool_ = false;           // inside the hysteresis band: hold
+    }
+    stats_.on_thermal_reading(have_temp ? temp : -273.0, headroom, cpu, gpu, level_, levels);
+    if (level_ == prev) return false;
+
+    last_step_ = now;
+    bool down = level_ > prev;
+    const std::string& step = tc.steps[down ? level_ - 1 : level_];
+    stats_.on_thermal_step(down);
+    std::cout << "[THERMAL] " << std::fixed << std::setprecision(1);
+    if (have_temp) std::cout << temp << " C (headroom " << headroom << " C)";
+    if (cpu >= 0) std::cout << " cpu clock " << 100.0 * cpu << "%";
+    if (gpu >= 0) std::cout << " gpu clock " << 100.0 * gpu << "%";
+    std::cout << ": " << (down ? "down" : "up") << " to level " << level_ << "/" << levels
+              << (down ? " (+" : " (-") << step << ")" << std::endl;
+    return true;
+}
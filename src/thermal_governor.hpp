@@ -0,0 +1,78 @@
+#pragma once
+
+#include "config.hpp"
+#include "stats.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/// Thermal- and power-aware quality governor.
+///
+/// In the sun the Orin NX heats until its clocks are capped; frames then
+/// come late, the stall detector and watchdog restart the pipeline, and
+/// the restart costs more than it saves. The governor acts first. Once per
+/// control tick it reads the hottest of `thermal.zones` and the CPU/GPU
+/// clock caps (cooling devices lower scaling_max_freq / devfreq max_freq;
+/// the current clock also drops when idle, so the cap is what tells
+/// throttling apart). The caps are compared with the highest seen since
+/// open(), not the hardware maximum: every nvpmodel mode below MAXN caps
+/// the clocks for good, and that is not throttling. Within `down_headroom_c` of `throttle_c`, or with a
+/// capped clock, it moves one level down `thermal.steps`, at most once per
+/// `step_down_s`. After `step_up_s` at `up_headroom_c` or more it moves one
+/// level back up; in between it holds. Steps are cumulative:
+///   resolution — encoder input scaled by `resolution_scale` (renegotiated
+///                in place, as on reload)
+///   fps        — every other converted frame dropped (halves VIC and NVENC work)
+///   preset     — one NVENC preset faster (the encoder is rebuilt)
+
+/// Encoder settings at a governor level, relative to the config.
+struct QualityLevel {
+    double scale = 1.0;     // encoder input size factor
+    int fps_divisor = 1;    // encode one in this many frames
+    int preset_steps = 0;   // presets faster than `encoder.preset`
+
+    bool operator==(const QualityLevel& o) const {
+        return scale == o.scale && fps_divisor == o.fps_divisor && preset_steps == o.preset_steps;
+    }
+    bool operator!=(const QualityLevel& o) const { return !(*this == o); }
+};
+
+/// Speed order of an `encoder.preset` (0 = ultrafast, either spelling):
+/// also the number of faster presets there are.
+int preset_speed_rank(const std::string& preset);
+
+/// `preset` made `steps` presets faster (ultrafast at most); `preset`
+/// itself when that is no faster.
+std::string faster_preset(const std::string& preset, int steps);
+
+class ThermalGovernor {
+public:
+    ThermalGovernor(const ConfigStore& config, Stats& stats) : config_(config), stats_(stats) {}
+
+    /// Resolve the sysfs paths (start, reload); the level is kept but
+    /// clamped to the configured steps.
+    void open();
+
+    /// Main loop, once per control tick. True if the level changed.
+    bool tick();
+
+    int level() const { return level_; }
+    QualityLevel quality() const;
+
+private:
+    const ConfigStore& config_;
+    Stats& stats_;
+    std::vector<std::string> zones_;     // resolved temperature files
+    std::string cpu_cap_, gpu_cap_;
+    double cpu_base_ = 0.0, gpu_base_ = 0.0;   // highest cap seen since open()
+    int level_ = 0;
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point last_step_{};
+    Clock::time_point cool_since_{};
+    bool cool_ = false;
+    bool warned_ = false;
+
+    bool read_temp(double& celsius) const;
+    static double clock_ratio(const std::string& cap, double& baseline);
+};
@@ -0,0 +1,65 @@
+#include "thread_pool.hpp"
+#include "thread_roles.hpp"
+
+ThreadPool::ThreadPool(int threads) {
+    for (int i = 1; i < threads; i++) {
+        workers_.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+void ThreadPool::run_items() {
+    for (int i = next_.fetch_add(1); i < job_size_; i = next_.fetch_add(1)) {
+        (*job_)(i);
+    }
+}
+
+// Workers split the caller's per-frame work (denoise): placed as streaming
+void ThreadPool::worker_loop() {
+    thread_role_enter(ThreadRole::Streaming);
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [&]() { return quit_ || generation_ != seen; });
+            if (quit_) break;
+            seen = generation_;
+            busy_++;
+        }
+        run_items();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_ == 0) done_cv_.notify_one();
+        }
+    }
+    thread_role_leave();
+}
+
+void ThreadPool::parallel_for(int n, const std::function<void(int)>& fn) {
+    if (workers_.empty() || n <= 1) {
+        for (int i = 0; i < n; i++) fn(i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        job_size_ = n;
+        next_.store(0);
+        generation_++;
+    }
+    work_cv_.notify_all();
+    run_items();
+
+    // Wait for stragglers still inside fn(); late wakers find no items left
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&]() { return busy_ == 0; });
+    job_ = nullptr;
+}
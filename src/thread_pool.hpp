@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed-size worker pool for data-parallel per-frame kernels.
+/// One job at a time; the calling thread participates, so a pool of
+/// size 1 runs everything inline with no hand-off.
+
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+    /// Run fn(i) for every i in [0, n). Blocks until all calls have returned.
+    void parallel_for(int n, const std::function<void(int)>& fn);
+
+private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+
+    const std::function<void(int)>* job_ = nullptr;
+    int job_size_ = 0;
+    uint64_t generation_ = 0;
+    int busy_ = 0;
+    bool quit_ = false;
+    std::atomic<int> next_{0};
+
+    void worker_loop();
+    void run_items();
+};
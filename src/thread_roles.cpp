@@ -0,0 +1,248 @@
+#include "thread_roles.hpp"
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+static constexpr int kRoles = 4;
+
+namespace {
+
+/// schedstat: ns on CPU, ns runnable waiting for a CPU, timeslices run.
+struct SchedSample {
+    uint64_t cpu_ns = 0;
+    uint64_t wait_ns = 0;
+    uint64_t slices = 0;
+};
+
+struct ThreadEntry {
+    ThreadRole role;
+    SchedSample last;
+};
+
+/// What the process started with, for roles reset to inherit.
+struct Inherited {
+    cpu_set_t cpus;
+    int policy = SCHED_OTHER;
+    sched_param param{};
+    int nice = 0;
+
+    Inherited() {
+        CPU_ZERO(&cpus);
+        if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) {
+            for (int c = 0; c < CPU_SETSIZE; c++) CPU_SET(c, &cpus);
+        }
+        policy = sched_getscheduler(0);
+        if (policy < 0 || sched_getparam(0, &param) != 0) {
+            policy = SCHED_OTHER;
+            param = sched_param{};
+        }
+        errno = 0;
+        int n = getpriority(PRIO_PROCESS, 0);
+        if (errno == 0) nice = n;
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    const Inherited inherited;   // captured before any thread is placed
+    ThreadsConfig config;
+    std::map<pid_t, ThreadEntry> threads;
+    std::chrono::steady_clock::time_point last_print = std::chrono::steady_clock::now();
+    std::atomic<bool> warned[kRoles] = {};
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+pid_t current_tid() { return static_cast<pid_t>(syscall(SYS_gettid)); }
+
+const ThreadRoleConfig& role_config(const ThreadsConfig& config, ThreadRole role) {
+    switch (role) {
+    case ThreadRole::Source:    return config.source;
+    case ThreadRole::Streaming: return config.streaming;
+    case ThreadRole::Serving:   return config.serving;
+    case ThreadRole::Monitor:   return config.monitor;
+    }
+    return config.streaming;
+}
+
+bool read_schedstat(pid_t tid, SchedSample& s) {
+    std::ifstream f("/proc/self/task/" + std::to_string(tid) + "/schedstat");
+    return static_cast<bool>(f >> s.cpu_ns >> s.wait_ns >> s.slices);
+}
+
+/// First failure per role only: without CAP_SYS_NICE (or an rtprio limit)
+/// every thread of the role would fail the same way.
+void warn_once(ThreadRole role, const std::string& what) {
+    if (registry().warned[(int)role].exchange(true)) return;
+    std::cerr << "[THREADS] " << thread_role_name(role) << ": " << what << std::endl;
+}
+
+/// Apply `rc` to `tid`. Settings left empty or "inherit" go back to what
+/// the process started with, so a reload that clears them undoes them.
+void place(pid_t tid, ThreadRole role, const ThreadRoleConfig& rc) {
+    const Inherited& in = registry().inherited;
+    if (rc.cpus.empty()) {
+        if (sched_setaffinity(tid, sizeof(in.cpus), &in.cpus) != 0) {
+            warn_once(role, std::string("cannot restore the process's cpus: ") + strerror(errno));
+        }
+    } else {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (parse_cpu_list(rc.cpus, cpus)) {
+            for (int c : cpus) CPU_SET(c, &set);
+        }
+        if (sched_setaffinity(tid, sizeof(set), &set) != 0) {
+            warn_once(role, "cannot pin to cpus " + rc.cpus + ": " + strerror(errno));
+        }
+    }
+    if (rc.policy == "fifo") {
+        sched_param sp{};
+        sp.sched_priority = rc.priority;
+        if (sched_setscheduler(tid, SCHED_FIFO, &sp) != 0) {
+            warn_once(role, std::string("cannot set SCHED_FIFO (needs CAP_SYS_NICE or an rtprio limit): ") +
+                            strerror(errno));
+        }
+    } else if (rc.policy == "other") {
+        sched_param sp{};
+        sched_setscheduler(tid, SCHED_OTHER, &sp);
+        // Per thread on Linux: the nice value belongs to the task, not the process
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), rc.priority) != 0) {
+            warn_once(role, std::string("cannot set nice ") + std::to_string(rc.priority) + ": " + strerror(errno));
+        }
+    } else {
+        if (sched_setscheduler(tid, in.policy, &in.param) != 0 ||
+            setpriority(PRIO_PROCESS, static_cast<id_t>(tid), in.nice) != 0) {
+            warn_once(role, std::string("cannot restore the inherited scheduling: ") + strerror(errno));
+        }
+    }
+}
+
+void enter(pid_t tid, ThreadRole role) {
+    Registry& r = registry();
+    ThreadRoleConfig rc;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        ThreadEntry& e = r.threads[tid];
+        e.role = role;
+        read_schedstat(tid, e.last);
+        rc = role_config(r.config, role);
+    }
+    place(tid, role, rc);
+}
+
+bool inside_rtspsrc(GstObject* obj) {
+    for (GstObject* o = obj; o; o = GST_OBJECT_PARENT(o)) {
+        if (!GST_IS_ELEMENT(o)) continue;
+        GstElementFactory* f = gst_element_get_factory(GST_ELEMENT(o));
+        if (f && strcmp(GST_OBJECT_NAME(f), "rtspsrc") == 0) return true;
+    }
+    return false;
+}
+
+// Runs in the posting thread: for ENTER/LEAVE that is the task thread itself
+GstBusSyncReply on_sync_message(GstBus*, GstMessage* msg, gpointer data) {
+    if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_STREAM_STATUS) return GST_BUS_PASS;
+    GstStreamStatusType type;
+    GstElement* owner = nullptr;
+    gst_message_parse_stream_status(msg, &type, &owner);
+    if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+        ThreadRole role = inside_rtspsrc(GST_OBJECT(owner))
+            ? ThreadRole::Source : static_cast<ThreadRole>(GPOINTER_TO_INT(data));
+        enter(current_tid(), role);
+    } else if (type == GST_STREAM_STATUS_TYPE_LEAVE) {
+        thread_role_leave();
+    }
+    return GST_BUS_PASS;
+}
+
+}  // namespace
+
+const char* thread_role_name(ThreadRole role) {
+    switch (role) {
+    case ThreadRole::Source:    return "source";
+    case ThreadRole::Streaming: return "streaming";
+    case ThreadRole::Serving:   return "serving";
+    case ThreadRole::Monitor:   return "monitor";
+    }
+    return "?";
+}
+
+void thread_roles_configure(const ThreadsConfig& config) {
+    Registry& r = registry();
+    std::vector<std::pair<pid_t, ThreadRole>> live;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.config = config;
+        for (auto& w : r.warned) w.store(false);
+        for (const auto& kv : r.threads) live.emplace_back(kv.first, kv.second.role);
+    }
+    for (const auto& t : live) place(t.first, t.second, role_config(config, t.second));
+}
+
+void thread_role_enter(ThreadRole role) { enter(current_tid(), role); }
+
+void thread_role_leave() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.erase(current_tid());
+}
+
+void thread_roles_watch_bus(GstBus* bus, ThreadRole role) {
+    gst_bus_set_sync_handler(bus, on_sync_message, GINT_TO_POINTER((int)role), NULL);
+}
+
+void thread_roles_print() {
+    Registry& r = registry();
+    SchedSample delta[kRoles];
+    int count[kRoles] = {};
+    double wall_ns;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto now = std::chrono::steady_clock::now();
+        wall_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(now - r.last_print).count();
+        r.last_print = now;
+        for (auto it = r.threads.begin(); it != r.threads.end();) {
+            SchedSample s;
+            if (!read_schedstat(it->first, s)) {   // exited without leaving
+                it = r.threads.erase(it);
+                continue;
+            }
+            int i = (int)it->second.role;
+            count[i]++;
+            delta[i].cpu_ns += s.cpu_ns - it->second.last.cpu_ns;
+            delta[i].wait_ns += s.wait_ns - it->second.last.wait_ns;
+            delta[i].slices += s.slices - it->second.last.slices;
+            it->second.last = s;
+            ++it;
+        }
+    }
+    if (wall_ns <= 0) return;
+
+    // cpu: share of one core; wait: mean run-queue delay per timeslice
+    std::ostringstream line;
+    bool any = false;
+    for (int i = 0; i < kRoles; i++) {
+        if (!count[i]) continue;
+        line << (any ? " | " : " ") << thread_role_name((ThreadRole)i) << "=" << count[i]
+             << " cpu=" << std::fixed << std::setprecision(1) << 100.0 * delta[i].cpu_ns / wall_ns << "%"
+             << " wait=" << (delta[i].slices ? delta[i].wait_ns / delta[i].slices / 1000 : 0) << "us";
+        any = true;
+    }
+    if (any) std::cout << "[STATS] threads:" << line.str() << std::endl;
+}
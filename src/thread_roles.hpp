@@ -0,0 +1,41 @@
+#pragma once
+
+#include "config.hpp"
+#include <gst/gst.h>
+
+/// Thread placement by role.
+///
+/// Every thread this process runs media work on belongs to a role, and each
+/// role has its own CPU set and scheduling (`threads.*`): SCHED_FIFO at a
+/// priority, SCHED_OTHER at a nice level, or left as inherited. On a robot
+/// the control stack keeps the remaining cores, and the encoder cannot
+/// preempt it beyond what its FIFO priorities allow.
+///
+/// Our own threads (feeders, ring reader, monitor) take their role when they
+/// start. GStreamer task threads are placed from the `stream-status` ENTER
+/// message, which the new thread posts itself, through a bus sync handler:
+/// anything inside rtspsrc is `source`, the rest takes the role the bus
+/// was registered with. A task thread is a pooled GThread, so it takes the
+/// role of whichever task it currently runs.
+///
+/// Registered threads are sampled from /proc/self/task/<tid>/schedstat for
+/// per-role CPU time and run-queue wait (time runnable but not running,
+/// i.e. scheduling latency) on the `[STATS] threads` line.
+
+enum class ThreadRole { Source = 0, Streaming = 1, Serving = 2, Monitor = 3 };
+
+const char* thread_role_name(ThreadRole role);
+
+/// Set (or, on reload, change) the placement of every role; threads already
+/// registered are moved at once. Any thread.
+void thread_roles_configure(const ThreadsConfig& config);
+
+/// The calling thread takes `role` until thread_role_leave() or exit.
+void thread_role_enter(ThreadRole role);
+void thread_role_leave();
+
+/// Install on a pipeline bus; task threads take `role` (Source inside rtspsrc).
+void thread_roles_watch_bus(GstBus* bus, ThreadRole role);
+
+/// Per-role CPU and run-queue wait since the previous call.
+void thread_roles_print();
@@ -0,0 +1,222 @@
+#include "upgrade.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+static constexpr uint32_t kHandoffMagic = 0x55504752;   // "UPGR"
+static constexpr char kRequest[] = "TAKEOVER 1\n";
+static constexpr int kIoTimeoutS = 5;
+
+/// Bounds on what the wire may claim; past them the GOP is dropped and
+/// only the socket is taken. Far above any real AU, GOP or caps string.
+static constexpr uint32_t kMaxCapsBytes = 64 * 1024;
+static constexpr uint32_t kMaxFrameBytes = 8 * 1024 * 1024;
+static constexpr uint32_t kMaxFrames = 4096;
+
+struct HandoffHeader {
+    uint32_t magic;
+    uint32_t frames;
+    uint32_t caps_bytes;
+    uint32_t reserved;
+};
+
+struct HandoffFrame {
+    uint32_t size;
+    uint32_t flags;      // GstBufferFlags of the access unit
+    uint64_t pts;
+    uint64_t dts;
+    uint64_t duration;
+};
+
+static bool write_all(int fd, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n; size -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void* data, size_t size) {
+    uint8_t* p = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n; size -= n;
+    }
+    return true;
+}
+
+static void set_timeouts(int fd) {
+    timeval tv{kIoTimeoutS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static bool unix_address(const std::string& path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+int open_rtsp_listen_socket(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        std::cerr << "[SERVER] Cannot listen on port " << port << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int upgrade_listen(const std::string& path) {
+    sockaddr_un addr;
+    if (!unix_address(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        std::cerr << "[UPGRADE] Cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool upgrade_send(int conn, int listen_fd, const std::vector<GstSample*>& gop) {
+    set_timeouts(conn);
+    char request[sizeof(kRequest) - 1];
+    if (!read_all(conn, request, sizeof(request)) || memcmp(request, kRequest, sizeof(request)) != 0) {
+        std::cerr << "[UPGRADE] Malformed takeover request" << std::endl;
+        return false;
+    }
+
+    std::string caps;
+    if (!gop.empty() && gst_sample_get_caps(gop.front())) {
+        gchar* s = gst_caps_to_string(gst_sample_get_caps(gop.front()));
+        caps = s;
+        g_free(s);
+    }
+    HandoffHeader hdr{kHandoffMagic, static_cast<uint32_t>(gop.size()),
+                      static_cast<uint32_t>(caps.size()), 0};
+
+    // The header travels with the descriptor; the GOP follows as plain stream data
+    iovec iov{&hdr, sizeof(hdr)};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &listen_fd, sizeof(int));
+    if (sendmsg(conn, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(hdr)) return false;
+    if (!write_all(conn, caps.data(), caps.size())) return false;
+
+    for (GstSample* sample : gop) {
+        GstBuffer* buf = gst_sample_get_buffer(sample);
+        GstMapInfo map;
+        if (!gst_buffer_map(buf, &map, GST_MAP_READ)) return false;
+        HandoffFrame f{static_cast<uint32_t>(map.size), GST_BUFFER_FLAGS(buf),
+                       GST_BUFFER_PTS(buf), GST_BUFFER_DTS(buf), GST_BUFFER_DURATION(buf)};
+        bool ok = write_all(conn, &f, sizeof(f)) && write_all(conn, map.data, map.size);
+        gst_buffer_unmap(buf, &map);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+bool upgrade_request(const std::string& path, int& listen_fd, std::vector<GstSample*>& gop) {
+    listen_fd = -1;
+    sockaddr_un addr;
+    if (!unix_address(path, addr)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return false;
+    }
+    set_timeouts(fd);
+
+    HandoffHeader hdr{};
+    bool ok = write_all(fd, kRequest, sizeof(kRequest) - 1);
+    if (ok) {
+        iovec iov{&hdr, sizeof(hdr)};
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ok = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL) == (ssize_t)sizeof(hdr) &&
+             hdr.magic == kHandoffMagic;
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (ok && cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(&listen_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+        ok = ok && listen_fd >= 0;
+    }
+
+    if (ok && (hdr.caps_bytes > kMaxCapsBytes || hdr.frames > kMaxFrames)) {
+        std::cerr << "[UPGRADE] Hand-off header out of bounds (" << hdr.frames << " frames, "
+                  << hdr.caps_bytes << " bytes of caps), taking the socket only" << std::endl;
+        ok = false;
+    }
+    GstCaps* caps = nullptr;
+    if (ok && hdr.caps_bytes > 0) {
+        std::string str(hdr.caps_bytes, '\0');
+        ok = read_all(fd, &str[0], str.size());
+        if (ok) caps = gst_caps_from_string(str.c_str());
+    }
+    for (uint32_t i = 0; ok && i < hdr.frames; i++) {
+        HandoffFrame f;
+        ok = read_all(fd, &f, sizeof(f)) && f.size > 0 && f.size <= kMaxFrameBytes;
+        if (!ok) break;
+        GstBuffer* buf = gst_buffer_new_allocate(nullptr, f.size, nullptr);
+        if (!buf) {
+            ok = false;
+            break;
+        }
+        GstMapInfo map;
+        ok = gst_buffer_map(buf, &map, GST_MAP_WRITE);
+        if (ok) {
+            ok = read_all(fd, map.data, f.size);
+            gst_buffer_unmap(buf, &map);
+        }
+        GST_BUFFER_FLAGS(buf) = f.flags;
+        GST_BUFFER_PTS(buf) = f.pts;
+        GST_BUFFER_DTS(buf) = f.dts;
+        GST_BUFFER_DURATION(buf) = f.duration;
+        if (ok) gop.push_back(gst_sample_new(buf, caps, nullptr, nullptr));
+        gst_buffer_unref(buf);
+    }
+    if (caps) gst_caps_unref(caps);
+    close(fd);
+
+    if (!ok) {
+        // The socket alone is enough to take over; a torn GOP is not
+        for (GstSample* s : gop) gst_sample_unref(s);
+        gop.clear();
+    }
+    return listen_fd >= 0;
+}
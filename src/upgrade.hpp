@@ -0,0 +1,31 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <string>
+#include <vector>
+
+/// Zero-downtime binary upgrade.
+///
+/// The running instance listens on a Unix socket (`upgrade.socket`). A new
+/// binary started with `--upgrade` connects there as it starts its RTSP
+/// server, before building its own encoder, and asks to take over. The old
+/// instance replies with its RTSP listening socket (SCM_RIGHTS) and the
+/// current GOP, stops accepting, and drains. Pending connections wait in
+/// the shared kernel backlog, so no client is refused. A viewer that
+/// connects to the new instance gets the handed-over GOP at once; its live
+/// picture starts with the new encoder's first IDR.
+
+/// Bound, listening TCP socket for the RTSP server (close-on-exec), or -1.
+int open_rtsp_listen_socket(int port);
+
+/// Old side: listening Unix socket at `path` (replaces a stale one), or -1.
+int upgrade_listen(const std::string& path);
+
+/// Old side: answer a successor on `conn` (accepted from upgrade_listen)
+/// with `listen_fd` and the access units in `gop`. Blocks until sent or a
+/// socket timeout expires; call it off the main loop.
+bool upgrade_send(int conn, int listen_fd, const std::vector<GstSample*>& gop);
+
+/// New side: take over from the instance at `path`. On success `listen_fd`
+/// is the inherited RTSP socket and `gop` holds samples the caller owns.
+bool upgrade_request(const std::string& path, int& listen_fd, std::vector<GstSample*>& gop);
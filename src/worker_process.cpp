@@ -0,0 +1,177 @@
+#include "worker_process.hpp"
+#include "thread_roles.hpp"
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <climits>
+#include <csignal>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+/// How long a stopping worker gets to exit on SIGTERM before SIGKILL.
+static constexpr int kStopGraceMs = 2000;
+
+WorkerProcess::WorkerProcess(const ConfigStore& config, Stats& stats, std::string config_path)
+    : config_(config), stats_(stats), config_path_(std::move(config_path)) {}
+
+WorkerProcess::~WorkerProcess() { stop(); }
+
+bool WorkerProcess::start(FrameHandler on_frame, ExitHandler on_exit) {
+    on_frame_ = std::move(on_frame);
+    on_exit_ = std::move(on_exit);
+
+    std::string name = "/rtsp_encoder." + std::to_string(getpid());
+    ring_ = ShmRing::create(name, (size_t)config_->isolation.ring_kb * 1024);
+    if (!ring_) return false;
+    if (!spawn()) { ring_.reset(); return false; }
+
+    reading_.store(true);
+    reader_ = std::thread(&WorkerProcess::read_loop, this);
+    return true;
+}
+
+void WorkerProcess::stop() {
+    if (respawn_source_id_) { g_source_remove(respawn_source_id_); respawn_source_id_ = 0; }
+    if (pid_ > 0) {
+        if (child_watch_id_) { g_source_remove(child_watch_id_); child_watch_id_ = 0; }
+        kill(pid_, SIGTERM);
+        int status = 0;
+        bool exited = false;
+        for (int waited = 0; waited < kStopGraceMs && !exited; waited += 20) {
+            exited = waitpid(pid_, &status, WNOHANG) == pid_;
+            if (!exited) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        if (!exited) {
+            std::cerr << "[WORKER] pid " << pid_ << " ignored SIGTERM, killing" << std::endl;
+            kill(pid_, SIGKILL);
+            waitpid(pid_, &status, 0);
+        }
+        g_spawn_close_pid(pid_);
+        pid_ = 0;
+    }
+    reading_.store(false);
+    if (reader_.joinable()) reader_.join();
+    ring_.reset();
+}
+
+bool WorkerProcess::spawn() {
+    char exe[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n <= 0) return false;
+    exe[n] = '\0';
+
+    std::string ring = ring_->name();
+    gchar* argv[] = {exe, (gchar*)"--config", (gchar*)config_path_.c_str(),
+                     (gchar*)"--worker", (gchar*)ring.c_str(), nullptr};
+    // Own process group: a terminal Ctrl+C reaches only the server, which
+    // stops the worker itself. The worker dies with the server.
+    auto child_setup = [](gpointer) {
+        setpgid(0, 0);
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+    };
+    GError* err = nullptr;
+    if (!g_spawn_async(nullptr, argv, nullptr, G_SPAWN_DO_NOT_REAP_CHILD,
+                       child_setup, nullptr, &pid_, &err)) {
+        std::cerr << "[WORKER] spawn failed: " << (err ? err->message : "?") << std::endl;
+        if (err) g_error_free(err);
+        pid_ = 0;
+        return false;
+    }
+    ring_->heartbeat();   // startup grace: the worker beats once its main loop runs
+    child_watch_id_ = g_child_watch_add(pid_, WorkerProcess::on_child_exit, this);
+    std::cout << "[WORKER] Encoder worker pid " << pid_ << " on " << ring << std::endl;
+    return true;
+}
+
+void WorkerProcess::on_child_exit(GPid pid, gint status, gpointer data) {
+    WorkerProcess* self = static_cast<WorkerProcess*>(data);
+    g_spawn_close_pid(pid);
+    self->pid_ = 0;
+    self->child_watch_id_ = 0;
+
+    if (WIFSIGNALED(status)) {
+        std::cerr << "[WORKER] pid " << pid << " killed by signal " << WTERMSIG(status) << std::endl;
+    } else {
+        std::cerr << "[WORKER] pid " << pid << " exited with status " << WEXITSTATUS(status) << std::endl;
+    }
+    self->stats_.on_worker_restart();
+    if (self->on_exit_) self->on_exit_();
+
+    int delay_ms = self->config_->isolation.respawn_delay_ms;
+    std::cout << "[WORKER] Respawning in " << delay_ms << " ms, clients stay connected" << std::endl;
+    self->respawn_source_id_ = g_timeout_add(delay_ms, WorkerProcess::on_respawn, self);
+}
+
+gboolean WorkerProcess::on_respawn(gpointer data) {
+    WorkerProcess* self = static_cast<WorkerProcess*>(data);
+    self->respawn_source_id_ = 0;
+    if (!self->spawn()) {
+        self->respawn_source_id_ = g_timeout_add(self->config_->isolation.respawn_delay_ms,
+                                                 WorkerProcess::on_respawn, self);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+void WorkerProcess::reload() {
+    if (pid_ > 0) kill(pid_, SIGHUP);
+}
+
+void WorkerProcess::check() {
+    if (pid_ <= 0 || !ring_) return;
+    int64_t age_ms = ring_->heartbeat_age_ms();
+    if (age_ms > (int64_t)config_->resilience.watchdog_timeout_s * 1000) {
+        std::cerr << "[WORKER] pid " << pid_ << " hung (no heartbeat for " << age_ms
+                  << " ms), killing" << std::endl;
+        kill(pid_, SIGKILL);   // the child watch respawns it
+        ring_->heartbeat();    // don't re-kill before the exit is reaped
+    }
+}
+
+void WorkerProcess::read_loop() {
+    uint32_t caps_seq = UINT32_MAX;
+    GstCaps* caps = nullptr;
+    bool need_keyframe = true;
+    std::vector<uint8_t> bytes;   // reused: grows to the largest AU once
+    thread_role_enter(ThreadRole::Serving);
+
+    while (reading_.load()) {
+        RingFrame frame;
+        ShmRing::Read r = ring_->read(bytes, frame, 100);
+        if (r == ShmRing::Read::Timeout) continue;
+        if (r == ShmRing::Read::Overrun) {
+            stats_.on_ipc_overrun();
+            std::cerr << "[WORKER] Reader overrun, skipping to the next IDR" << std::endl;
+            need_keyframe = true;
+            continue;
+        }
+        if (need_keyframe && !frame.keyframe) continue;
+        need_keyframe = false;
+        stats_.on_ipc_frame((ShmRing::now_ns() - frame.written_ns) / 1000);
+
+        if (ring_->caps_version() != caps_seq) {
+            std::string str = ring_->caps(caps_seq);
+            if (!str.empty()) {
+                if (caps) gst_caps_unref(caps);
+                caps = gst_caps_from_string(str.c_str());
+            }
+        }
+
+        // From the default (arena) allocator: no heap allocation per frame
+        GstBuffer* buf = gst_buffer_new_allocate(nullptr, bytes.size(), nullptr);
+        if (!buf) continue;
+        gst_buffer_fill(buf, 0, bytes.data(), bytes.size());
+        GST_BUFFER_PTS(buf) = frame.pts;
+        GST_BUFFER_DTS(buf) = frame.dts;
+        GST_BUFFER_DURATION(buf) = frame.duration;
+        if (!frame.keyframe) GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+        if (frame.discont) GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DISCONT);
+
+        GstSample* sample = gst_sample_new(buf, caps, nullptr, nullptr);
+        gst_buffer_unref(buf);
+        on_frame_(sample, frame.keyframe);
+        gst_sample_unref(sample);
+    }
+    if (caps) gst_caps_unref(caps);
+    thread_role_leave();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "config.hpp"
+#include "shm_ring.hpp"
+#include "stats.hpp"
+
+#include <gst/gst.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+/// Split mode, serving side: runs the encoder as a child process
+/// (`rtsp_encoder --config <file> --worker <ring>`) and turns the access
+/// units it publishes into GstSamples for the fan-out.
+///
+/// The worker is respawned `isolation.respawn_delay_ms` after it exits,
+/// and killed first if its main loop stops heartbeating for
+/// `resilience.watchdog_timeout_s` (an NvMMLite deadlock hangs the process
+/// rather than crashing it). RTSP sessions live in this process and never
+/// notice; output resumes on the new worker's first IDR.
+
+class WorkerProcess {
+public:
+    /// Reader thread: one access unit from the worker (caller takes no ref).
+    using FrameHandler = std::function<void(GstSample* sample, bool keyframe)>;
+    /// Main loop: the worker is gone; output must wait for a new IDR.
+    using ExitHandler = std::function<void()>;
+
+    WorkerProcess(const ConfigStore& config, Stats& stats, std::string config_path);
+    ~WorkerProcess();
+
+    WorkerProcess(const WorkerProcess&) = delete;
+    WorkerProcess& operator=(const WorkerProcess&) = delete;
+
+    /// Main loop: create the ring, spawn the worker, start reading.
+    bool start(FrameHandler on_frame, ExitHandler on_exit);
+    void stop();
+
+    /// Any thread: ask the worker's encoder for an IDR.
+    void request_idr() { if (ring_) ring_->request_idr(); }
+
+    /// Main loop: have the worker re-read the config file (SIGHUP).
+    void reload();
+
+    /// Main loop, once per control tick: kill a worker that stopped heartbeating.
+    void check();
+
+    bool alive() const { return pid_ > 0; }
+
+private:
+    const ConfigStore& config_;
+    Stats& stats_;
+    std::string config_path_;
+    std::unique_ptr<ShmRing> ring_;
+    FrameHandler on_frame_;
+    ExitHandler on_exit_;
+
+    GPid pid_ = 0;
+    guint child_watch_id_ = 0;
+    guint respawn_source_id_ = 0;
+    std::atomic<bool> reading_{false};
+    std::thread reader_;
+
+    bool spawn();
+    void read_loop();
+    static void on_child_exit(GPid pid, gint status, gpointer data);
+    static gboolean on_respawn(gpointer data);
+};